@@ -0,0 +1,578 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : async_engine.cc
+ * @Description  : event loop client engine.
+ */
+
+#include "async_engine.h"
+#include "async_log.h"
+#include "cpu_affinity.h"
+#include "pacer.h"
+#include "result_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mysql/errmsg.h>
+#include <mysql/mysql.h>
+#include <queue>
+#include <unistd.h>
+
+extern char *user;
+extern char *password;
+
+#ifdef MYSQL_WAIT_READ
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+// wake up at least this often to notice stop.
+static const int kMaxWaitMs = 100;
+
+AsyncChannel::~AsyncChannel() {
+  free_result();
+  if (m_conn_ != nullptr) {
+    mysql_close(m_conn_);
+  }
+}
+
+void AsyncChannel::free_result() {
+  if (m_result_ != nullptr) {
+    mysql_free_result(m_result_);
+    m_result_ = nullptr;
+  }
+}
+
+void AsyncChannel::connect(const char *host, unsigned int port,
+                           const char *db) {
+  free_result();
+  memset(&m_timing_, 0, sizeof(m_timing_));
+  m_op_ = OP_CONNECT;
+  m_host_ = host;
+  m_port_ = port;
+  m_start_ns_ = m_phase_ns_ = monotonic_ns();
+  m_conn_ = mysql_init(0);
+  if (m_conn_ == nullptr) {
+    AsyncLog(LOG_ERROR, LOG_SITE_CONNECT) << "Failed to init async connection";
+    done(CR_OUT_OF_MEMORY);
+    return;
+  }
+
+  mysql_options(m_conn_, MYSQL_OPT_NONBLOCK, 0);
+  m_connect_ret_ = nullptr;
+  step(mysql_real_connect_start(&m_connect_ret_, m_conn_, host, user,
+                                password, db, port, nullptr, 0));
+}
+
+void AsyncChannel::query(const char *sql, size_t len) {
+  free_result();
+  m_op_ = OP_QUERY;
+  m_start_ns_ = monotonic_ns();
+  step(mysql_real_query_start(&m_query_ret_, m_conn_, sql, len));
+}
+
+void AsyncChannel::close() {
+  free_result();
+  m_op_ = OP_CLOSE;
+  m_start_ns_ = monotonic_ns();
+  step(mysql_close_start(m_conn_));
+}
+
+// status is what the last _start/_cont returned, 0 once its call finished.
+void AsyncChannel::step(int status) {
+  if (status != 0) {
+    m_loop_.watch(*this, status);
+    // the client waits for write while the tcp connect is in progress, the
+    // first wait for read is the server greeting.
+    if (m_op_ == OP_CONNECT && m_timing_.done_phases == 0 &&
+        !(status & MYSQL_WAIT_WRITE)) {
+      uint64_t now = monotonic_ns();
+      m_timing_.phase_us[0] = (now - m_phase_ns_) / 1000;
+      m_timing_.done_phases = 1;
+      m_phase_ns_ = now;
+    }
+    return;
+  }
+
+  switch (m_op_) {
+  case OP_CONNECT:
+    if (m_connect_ret_ == nullptr) {
+      unsigned int err = mysql_errno(m_conn_);
+      AsyncLog(LOG_ERROR, LOG_SITE_CONNECT, err)
+          << "Failed to connect to MySql " << m_host_ << ":" << m_port_
+          << ". errno: " << err << ",errmsg: " << mysql_error(m_conn_);
+      mysql_close(m_conn_);
+      m_conn_ = nullptr;
+      done(err);
+      return;
+    }
+    m_timing_.phase_us[2] = (monotonic_ns() - m_phase_ns_) / 1000;
+    m_timing_.done_phases = 3;
+    done(0);
+    return;
+
+  case OP_QUERY:
+    if (m_query_ret_ != 0) {
+      done(mysql_errno(m_conn_));
+      return;
+    }
+    m_op_ = OP_STORE;
+    m_result_ = nullptr;
+    step(mysql_store_result_start(&m_result_, m_conn_));
+    return;
+
+  case OP_STORE:
+    done(m_result_ == nullptr ? mysql_errno(m_conn_) : 0);
+    return;
+
+  case OP_CLOSE:
+    m_conn_ = nullptr;
+    done(0);
+    return;
+
+  default:
+    return;
+  }
+}
+
+void AsyncChannel::resume(int ready) {
+  m_loop_.set_timer(*this, 0);
+  int status = 0;
+  switch (m_op_) {
+  case OP_CONNECT:
+    status = mysql_real_connect_cont(&m_connect_ret_, m_conn_, ready);
+    if (m_timing_.done_phases == 1) {
+      uint64_t now = monotonic_ns();
+      m_timing_.phase_us[1] = (now - m_phase_ns_) / 1000;
+      m_timing_.done_phases = 2;
+      m_phase_ns_ = now;
+    }
+    break;
+  case OP_QUERY:
+    status = mysql_real_query_cont(&m_query_ret_, m_conn_, ready);
+    break;
+  case OP_STORE:
+    status = mysql_store_result_cont(&m_result_, m_conn_, ready);
+    break;
+  case OP_CLOSE:
+    status = mysql_close_cont(m_conn_, ready);
+    break;
+  default:
+    return;
+  }
+  step(status);
+}
+
+void AsyncChannel::on_timer() {
+  m_loop_.unwatch(*this);
+  resume(MYSQL_WAIT_TIMEOUT);
+}
+
+void AsyncChannel::done(unsigned int err) {
+  m_err_ = err;
+  m_op_ = OP_NONE;
+  m_loop_.completed(*this);
+}
+
+AsyncLoop::~AsyncLoop() {
+  for (auto task : m_tasks_) {
+    delete task;
+  }
+  if (m_timer_fd_ >= 0) {
+    close(m_timer_fd_);
+  }
+  if (m_epoll_fd_ >= 0) {
+    close(m_epoll_fd_);
+  }
+}
+
+void AsyncLoop::set_timer(AsyncTimed &timed, uint64_t deadline_ns) {
+  timed.m_timer_ns_ = deadline_ns;
+  if (deadline_ns != 0) {
+    m_timers_.push(Timer(deadline_ns, &timed));
+  }
+}
+
+// arm the socket for what the client waits for, the oneshot registration
+// is re-armed by every wait.
+void AsyncLoop::watch(AsyncChannel &channel, int status) {
+  struct epoll_event ev;
+  ev.events = EPOLLONESHOT;
+  if (status & MYSQL_WAIT_READ) {
+    ev.events |= EPOLLIN;
+  }
+  if (status & MYSQL_WAIT_WRITE) {
+    ev.events |= EPOLLOUT;
+  }
+  if (status & MYSQL_WAIT_EXCEPT) {
+    ev.events |= EPOLLPRI;
+  }
+  ev.data.ptr = &channel;
+
+  // a new connection may reuse the fd number of a closed one, which the
+  // kernel already dropped from the set.
+  int fd = mysql_get_socket(channel.m_conn_);
+  if (epoll_ctl(m_epoll_fd_, EPOLL_CTL_MOD, fd, &ev) != 0 && errno == ENOENT) {
+    epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  set_timer(channel,
+            status & MYSQL_WAIT_TIMEOUT
+                ? monotonic_ns() +
+                      mysql_get_timeout_value_ms(channel.m_conn_) * 1000000ULL
+                : 0);
+}
+
+// the client timed out waiting, disarm the socket before resuming.
+void AsyncLoop::unwatch(AsyncChannel &channel) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.data.ptr = &channel;
+  epoll_ctl(m_epoll_fd_, EPOLL_CTL_MOD, mysql_get_socket(channel.m_conn_),
+            &ev);
+}
+
+// tell the tasks about the finished operations, those their callbacks start
+// and finish right away are told in the next round.
+void AsyncLoop::deliver() {
+  while (!m_completed_.empty()) {
+    m_delivering_.swap(m_completed_);
+    for (auto channel : m_delivering_) {
+      channel->m_task_.on_done(*channel);
+    }
+    m_delivering_.clear();
+  }
+}
+
+void AsyncLoop::run() {
+  m_epoll_fd_ = epoll_create1(0);
+  m_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (m_epoll_fd_ < 0 || m_timer_fd_ < 0) {
+    std::cerr << "Failed to create epoll, errno: " << errno
+              << ", errmsg: " << strerror(errno) << std::endl;
+    return;
+  }
+  struct epoll_event timer_ev;
+  memset(&timer_ev, 0, sizeof(timer_ev));
+  timer_ev.events = EPOLLIN;
+  timer_ev.data.ptr = nullptr;
+  epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, m_timer_fd_, &timer_ev);
+
+  m_live_ = m_tasks_.size();
+  for (auto task : m_tasks_) {
+    task->start();
+  }
+  deliver();
+
+  std::vector<struct epoll_event> events(
+      std::max<size_t>(1, std::min<size_t>(m_tasks_.size(), 1024)));
+  bool stopping = false;
+  while (m_live_ > 0) {
+    while (!m_timers_.empty() &&
+           m_timers_.top().first != m_timers_.top().second->m_timer_ns_) {
+      m_timers_.pop();
+    }
+    int timeout_ms = kMaxWaitMs;
+    if (!m_timers_.empty()) {
+      uint64_t deadline = m_timers_.top().first;
+      if (deadline <= monotonic_ns()) {
+        timeout_ms = 0;
+      } else if (deadline != m_timer_fd_ns_) {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = deadline / 1000000000ULL;
+        spec.it_value.tv_nsec = deadline % 1000000000ULL;
+        timerfd_settime(m_timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+        m_timer_fd_ns_ = deadline;
+      }
+    }
+
+    int n = epoll_wait(m_epoll_fd_, events.data(), events.size(), timeout_ms);
+    if (n < 0 && errno != EINTR) {
+      std::cerr << "Failed to wait on epoll, errno: " << errno
+                << ", errmsg: " << strerror(errno) << std::endl;
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.ptr == nullptr) {
+        uint64_t expirations;
+        if (read(m_timer_fd_, &expirations, sizeof(expirations)) > 0) {
+          m_timer_fd_ns_ = 0;
+        }
+        continue;
+      }
+      int ready = 0;
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        ready |= MYSQL_WAIT_READ;
+      }
+      if (events[i].events & EPOLLOUT) {
+        ready |= MYSQL_WAIT_WRITE;
+      }
+      if (events[i].events & EPOLLPRI) {
+        ready |= MYSQL_WAIT_EXCEPT;
+      }
+      ((AsyncChannel *)events[i].data.ptr)->resume(ready);
+    }
+    deliver();
+
+    uint64_t now = monotonic_ns();
+    while (!m_timers_.empty() && m_timers_.top().first <= now) {
+      Timer timer = m_timers_.top();
+      m_timers_.pop();
+      if (timer.first != timer.second->m_timer_ns_) {
+        continue;
+      }
+      timer.second->m_timer_ns_ = 0;
+      timer.second->on_timer();
+      deliver();
+    }
+
+    // tasks waiting on their timer may sleep long, finish them right away.
+    if (m_stop_ && !stopping) {
+      stopping = true;
+      for (auto task : m_tasks_) {
+        task->on_stop();
+      }
+      deliver();
+    }
+  }
+}
+
+enum SessionState {
+  SESSION_PACE,    // waiting for the timer to start the next operation
+  SESSION_CONNECT, // connect in progress
+  SESSION_QUERY,   // query in progress
+  SESSION_CLOSE,   // close in progress
+  SESSION_DONE,
+};
+
+// a session running the passes of an AsyncWorkload.
+class WorkloadSession : public AsyncTask {
+public:
+  WorkloadSession(AsyncLoop &loop, const AsyncWorkload &workload,
+                  uint64_t index, uint64_t count)
+      : m_loop_(loop), m_workload_(workload), m_channel_(loop, *this),
+        m_pacer_(workload.rate, index, count, workload.arrival),
+        m_cursor_(*workload.querys, index, count),
+        m_claim_(workload.budget ? new WorkClaim(*workload.budget)
+                                 : nullptr) {}
+
+  void start() override { next_op(); }
+  void on_timer() override;
+  void on_done(AsyncChannel &channel) override;
+  void on_stop() override;
+
+private:
+  void next_op();
+  void start_query();
+  void start_close();
+  void query_done(unsigned int err);
+  void end_pass(bool ok);
+
+  AsyncLoop &m_loop_;
+  const AsyncWorkload &m_workload_;
+  AsyncChannel m_channel_;
+  SessionState m_state_{SESSION_PACE};
+  Pacer m_pacer_;
+  // renders the queries, the one in flight stays in its buffer.
+  WorkloadCursor m_cursor_;
+  std::unique_ptr<WorkClaim> m_claim_;
+  size_t m_query_index_{0};
+  // the pass ends once the connection in SESSION_CLOSE is closed.
+  bool m_pass_pending_{false};
+  bool m_pass_ok_{true};
+  uint64_t m_intended_ns_{0};
+};
+
+// pace the next operation, every operation starts from the timer. A pass
+// is claimed from the budget before its first query.
+void WorkloadSession::next_op() {
+  bool finished =
+      m_loop_.stopping() ||
+      (m_workload_.deadline_ns && monotonic_ns() >= m_workload_.deadline_ns) ||
+      (m_query_index_ == 0 && m_claim_ && !m_claim_->next());
+  if (finished) {
+    if (m_channel_.connected()) {
+      start_close();
+      return;
+    }
+    m_state_ = SESSION_DONE;
+    m_loop_.set_timer(*this, 0);
+    m_loop_.finish(*this);
+    return;
+  }
+
+  m_state_ = SESSION_PACE;
+  m_intended_ns_ = m_pacer_.next_slot();
+  m_loop_.set_timer(*this, m_intended_ns_);
+}
+
+void WorkloadSession::on_timer() {
+  if (m_state_ != SESSION_PACE) {
+    return;
+  }
+  if (m_channel_.connected()) {
+    start_query();
+  } else {
+    m_state_ = SESSION_CONNECT;
+    m_channel_.connect(m_workload_.host, m_workload_.port, m_workload_.db);
+  }
+}
+
+// sessions waiting to be paced may sleep long.
+void WorkloadSession::on_stop() {
+  if (m_state_ == SESSION_PACE) {
+    next_op();
+  }
+}
+
+void WorkloadSession::start_query() {
+  const std::string &query = m_cursor_.next(m_query_index_);
+  m_state_ = SESSION_QUERY;
+  m_channel_.query(query.data(), query.size());
+}
+
+void WorkloadSession::start_close() {
+  m_state_ = SESSION_CLOSE;
+  m_channel_.close();
+}
+
+void WorkloadSession::on_done(AsyncChannel &channel) {
+  switch (m_state_) {
+  case SESSION_CONNECT:
+    m_workload_.on_connect(m_loop_.index(), channel.timing(), channel.err());
+    if (channel.err() != 0) {
+      end_pass(false);
+      next_op();
+      return;
+    }
+    start_query();
+    return;
+
+  case SESSION_QUERY:
+    if (channel.err() == 0) {
+      count_result(channel.result());
+      channel.free_result();
+    }
+    query_done(channel.err());
+    return;
+
+  case SESSION_CLOSE:
+    m_workload_.on_close(m_loop_.index(),
+                         (monotonic_ns() - channel.start_ns()) / 1000);
+    if (m_pass_pending_) {
+      m_pass_pending_ = false;
+      end_pass(m_pass_ok_);
+    }
+    next_op();
+    return;
+
+  default:
+    return;
+  }
+}
+
+void WorkloadSession::query_done(unsigned int err) {
+  const std::string &query = m_cursor_.last_query();
+  m_workload_.on_query(m_loop_.index(), m_query_index_,
+                       m_cursor_.last_class(), m_intended_ns_,
+                       m_channel_.start_ns(), monotonic_ns(), err);
+
+  bool pass_end;
+  bool close_conn;
+  if (err != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_QUERY, err)
+        << "Failed to run workload query, sql: " << query << ", errno: " << err
+        << ", errmsg: " << mysql_error(m_channel_.conn());
+    // a failed query ends the pass, the connection is kept only if it is
+    // persistent and still usable.
+    pass_end = true;
+    close_conn = m_workload_.lifecycle != CONN_PERSISTENT ||
+                 err >= CR_MIN_ERROR;
+  } else {
+    m_query_index_++;
+    pass_end = m_query_index_ == m_cursor_.pass_size();
+    close_conn = m_workload_.lifecycle == CONN_PER_QUERY ||
+                 (pass_end && m_workload_.lifecycle == CONN_PER_BATCH);
+  }
+
+  if (close_conn) {
+    m_pass_pending_ = pass_end;
+    m_pass_ok_ = err == 0;
+    start_close();
+    return;
+  }
+  if (pass_end) {
+    end_pass(err == 0);
+  }
+  next_op();
+}
+
+void WorkloadSession::end_pass(bool ok) {
+  m_workload_.on_pass(m_loop_.index(), ok);
+  m_query_index_ = 0;
+}
+
+int AsyncEngine::start(const TaskFactory &make_task,
+                       const std::atomic_bool &stop,
+                       const std::function<void(size_t loop)> &on_loop_exit) {
+  size_t loops = m_loops_;
+  for (size_t i = 0; i < loops; i++) {
+    // sessions are dealt round robin, so every loop gets an even share.
+    m_threads_.push_back(
+        new std::thread([this, i, loops, make_task, on_loop_exit, &stop]() {
+          pin_worker(i);
+          {
+            WorkerCpuTime cpu_time(i);
+            AsyncLoop loop(i, stop);
+            for (uint64_t index = i; index < m_sessions_; index += loops) {
+              loop.add(make_task(loop, index, m_sessions_));
+            }
+            loop.run();
+          }
+          mysql_thread_end();
+          if (on_loop_exit) {
+            on_loop_exit(i);
+          }
+        }));
+  }
+  return 0;
+}
+
+int AsyncEngine::start(const AsyncWorkload &workload,
+                       const std::atomic_bool &stop) {
+  // Workload::load() refuses a file without queries.
+  const AsyncWorkload *w = &workload;
+  return start(
+      [w](AsyncLoop &loop, uint64_t index, uint64_t count) -> AsyncTask * {
+        return new WorkloadSession(loop, *w, index, count);
+      },
+      stop, workload.on_loop_exit);
+}
+
+#else
+
+int AsyncEngine::start(const TaskFactory &, const std::atomic_bool &,
+                       const std::function<void(size_t loop)> &) {
+  std::cerr << "async engine needs a client library with the nonblocking "
+               "API (mysql_*_start/_cont), use --engine=thread"
+            << std::endl;
+  return -1;
+}
+
+int AsyncEngine::start(const AsyncWorkload &, const std::atomic_bool &stop) {
+  return start(TaskFactory(), stop, nullptr);
+}
+
+#endif // MYSQL_WAIT_READ
+
+void AsyncEngine::join() {
+  for (auto t : m_threads_) {
+    t->join();
+    delete t;
+  }
+  m_threads_.clear();
+}
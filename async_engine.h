@@ -0,0 +1,237 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : async_engine.h
+ * @Description  : event loop client engine. A few threads each run an epoll
+ *                 loop that drives many sessions through the nonblocking
+ *                 client API (mysql_*_start/_cont), so thousands of
+ *                 sessions do not need thousands of threads.
+ */
+
+#ifndef ASYNC_ENGINE_H
+#define ASYNC_ENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mysql/mysql.h>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "options.h"
+#include "work_budget.h"
+#include "workload.h"
+
+// handshake of one connect in us: tcp, greeting and auth. done_phases is how
+// many of them completed, a failed connect failed in the next one.
+struct ConnectTiming {
+  uint64_t phase_us[3];
+  int done_phases;
+};
+
+/*
+  What every session runs, and the hooks that account for it. Hooks are
+  called from the loop threads, loop is the index of the calling loop so
+  per thread statistics can be indexed by it. err is 0 on success.
+*/
+struct AsyncWorkload {
+  const char *host{nullptr};
+  unsigned int port{0};
+  const char *db{nullptr};
+  const Workload *querys{nullptr};
+  // passes over querys, claimed by all sessions from one budget like the
+  // threads of the thread engine do. nullptr runs until stop is set.
+  WorkBudget *budget{nullptr};
+  // monotonic_ns() after which no pass starts, 0 never.
+  uint64_t deadline_ns{0};
+  // CONN_PER_QUERY, CONN_PER_BATCH or CONN_PERSISTENT.
+  ConnLifecycle lifecycle{CONN_PER_BATCH};
+  // send rate of each session, 0 is unlimited.
+  double rate{0};
+  ArrivalProcess arrival{ARRIVAL_CLOSED};
+
+  std::function<void(size_t loop, const ConnectTiming &timing,
+                     unsigned int err)>
+      on_connect;
+  // index is the position in the pass, cls the workload class, times are
+  // monotonic_ns, intended is the paced send slot.
+  std::function<void(size_t loop, size_t index, size_t cls,
+                     uint64_t intended_ns, uint64_t start_ns,
+                     uint64_t done_ns, unsigned int err)>
+      on_query;
+  std::function<void(size_t loop, uint64_t us)> on_close;
+  std::function<void(size_t loop, bool ok)> on_pass;
+  std::function<void(size_t loop)> on_loop_exit;
+};
+
+class AsyncLoop;
+class AsyncChannel;
+
+// what an AsyncLoop wakes up at a deadline.
+class AsyncTimed {
+public:
+  virtual ~AsyncTimed() {}
+  virtual void on_timer() = 0;
+
+private:
+  friend class AsyncLoop;
+  // deadline of the armed timer, 0 is none. heap entries that do not match
+  // it are stale.
+  uint64_t m_timer_ns_{0};
+};
+
+/*
+  A session driven by an AsyncLoop. start() is called once from the loop,
+  then the task is woken by its timer and by the operations of its channels
+  finishing, and calls AsyncLoop::finish() once it is done. Callbacks never
+  nest: an operation started from one completes in a later one.
+*/
+class AsyncTask : public AsyncTimed {
+public:
+  virtual void start() = 0;
+  // the operation started on channel finished, channel.err() tells how.
+  virtual void on_done(AsyncChannel &channel) = 0;
+  // stop was set, a task waiting on a long timer should finish now.
+  virtual void on_stop() {}
+};
+
+/*
+  One connection of a task on the nonblocking client API, running one
+  operation at a time. A task with several channels can run an operation on
+  each of them at once.
+*/
+class AsyncChannel : public AsyncTimed {
+public:
+  AsyncChannel(AsyncLoop &loop, AsyncTask &task)
+      : m_loop_(loop), m_task_(task) {}
+  // a connection still open is closed blocking.
+  ~AsyncChannel() override;
+
+  void connect(const char *host, unsigned int port, const char *db);
+  // runs sql and stores its result, sql must stay valid until on_done.
+  void query(const char *sql, size_t len);
+  void close();
+
+  MYSQL *conn() const { return m_conn_; }
+  bool connected() const { return m_conn_ != nullptr; }
+  // 0, or the errno the last operation failed with. A failed connect is
+  // logged here and leaves the channel closed.
+  unsigned int err() const { return m_err_; }
+  // result of the last query, nullptr if it had none. It is freed by the
+  // next operation, or by free_result.
+  MYSQL_RES *result() const { return m_result_; }
+  void free_result();
+  const ConnectTiming &timing() const { return m_timing_; }
+  // monotonic_ns() the last operation started at.
+  uint64_t start_ns() const { return m_start_ns_; }
+
+  // the client timed out waiting.
+  void on_timer() override;
+
+private:
+  friend class AsyncLoop;
+  enum Op { OP_NONE, OP_CONNECT, OP_QUERY, OP_STORE, OP_CLOSE };
+
+  void resume(int ready);
+  void step(int status);
+  void done(unsigned int err);
+
+  AsyncLoop &m_loop_;
+  AsyncTask &m_task_;
+  MYSQL *m_conn_{nullptr};
+  Op m_op_{OP_NONE};
+  unsigned int m_err_{0};
+  const char *m_host_{nullptr};
+  unsigned int m_port_{0};
+  MYSQL *m_connect_ret_{nullptr};
+  int m_query_ret_{0};
+  MYSQL_RES *m_result_{nullptr};
+  ConnectTiming m_timing_;
+  uint64_t m_start_ns_{0};
+  // start of the connect phase in progress.
+  uint64_t m_phase_ns_{0};
+};
+
+// one epoll loop and the tasks it drives, run by one thread.
+class AsyncLoop {
+public:
+  AsyncLoop(size_t index, const std::atomic_bool &stop)
+      : m_index_(index), m_stop_(stop) {}
+  ~AsyncLoop();
+
+  size_t index() const { return m_index_; }
+  bool stopping() const { return m_stop_; }
+  // the loop owns task and starts it from run().
+  void add(AsyncTask *task) { m_tasks_.push_back(task); }
+  // until every task finished.
+  void run();
+  // wake timed at deadline_ns, replacing the timer it had, 0 disarms.
+  void set_timer(AsyncTimed &timed, uint64_t deadline_ns);
+  void finish(AsyncTask &) { m_live_--; }
+
+private:
+  AsyncLoop(const AsyncLoop &) = delete;
+  void operator=(const AsyncLoop &) = delete;
+
+  friend class AsyncChannel;
+  typedef std::pair<uint64_t, AsyncTimed *> Timer;
+
+  void watch(AsyncChannel &channel, int status);
+  void unwatch(AsyncChannel &channel);
+  void completed(AsyncChannel &channel) { m_completed_.push_back(&channel); }
+  void deliver();
+
+  size_t m_index_;
+  const std::atomic_bool &m_stop_;
+  int m_epoll_fd_{-1};
+  // a timerfd in the epoll set, armed to the earliest timer so timers are
+  // not rounded to the milliseconds of the epoll_wait timeout.
+  int m_timer_fd_{-1};
+  uint64_t m_timer_fd_ns_{0};
+  size_t m_live_{0};
+  std::vector<AsyncTask *> m_tasks_;
+  // channels whose operation finished, their tasks are told from run().
+  std::vector<AsyncChannel *> m_completed_;
+  std::vector<AsyncChannel *> m_delivering_;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>>
+      m_timers_;
+};
+
+class AsyncEngine {
+public:
+  // the task of session index out of count, run by loop.
+  typedef std::function<AsyncTask *(AsyncLoop &loop, uint64_t index,
+                                    uint64_t count)>
+      TaskFactory;
+
+  // at most loops threads, never more than sessions.
+  AsyncEngine(uint64_t sessions, size_t loops)
+      : m_sessions_(sessions),
+        m_loops_(std::max<size_t>(
+            1, std::min<uint64_t>(loops, std::max<uint64_t>(sessions, 1)))) {}
+  ~AsyncEngine() { join(); }
+
+  size_t loops() const { return m_loops_; }
+
+  // start the loop threads, the sessions run the passes of workload or
+  // stop once stop is set.
+  int start(const AsyncWorkload &workload, const std::atomic_bool &stop);
+  // start the loop threads running the sessions make_task builds,
+  // on_loop_exit is called by each loop thread once its sessions finished.
+  int start(const TaskFactory &make_task, const std::atomic_bool &stop,
+            const std::function<void(size_t loop)> &on_loop_exit);
+  void join();
+
+private:
+  AsyncEngine(const AsyncEngine &) = delete;
+  void operator=(const AsyncEngine &) = delete;
+
+  uint64_t m_sessions_;
+  size_t m_loops_;
+  std::vector<std::thread *> m_threads_;
+};
+
+#endif // ASYNC_ENGINE_H
@@ -0,0 +1,168 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : async_log.cc
+ * @Description  : non-blocking logging for the worker threads.
+ */
+
+#include "async_log.h"
+#include "histogram.h"
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// messages of one key a thread writes per second.
+static const uint64_t kLogBurst = 10;
+// messages a thread queues before the logger gets to them.
+static const size_t kLogRingSize = 1024;
+
+struct LogEntry {
+  LogLevel level;
+  std::string text;
+};
+
+// rate limit state of one site and errno.
+struct KeyState {
+  uint64_t second;
+  uint64_t count;
+  uint64_t suppressed;
+};
+
+struct ThreadLog {
+  ThreadLog() : ring(kLogRingSize) {}
+
+  SpscQueue<LogEntry> ring;
+  LogEntry entry;
+  std::ostringstream stream;
+  std::unordered_map<uint64_t, KeyState> keys;
+};
+
+static std::atomic_bool logger_running{false};
+static std::thread *logger_thread = nullptr;
+static std::mutex logs_mutex;
+static std::vector<ThreadLog *> thread_logs;
+static std::atomic<uint64_t> dropped_logs{0};
+static std::atomic<uint64_t> suppressed_logs{0};
+static thread_local ThreadLog *this_thread_log = nullptr;
+
+static ThreadLog *thread_log() {
+  if (this_thread_log == nullptr) {
+    this_thread_log = new ThreadLog();
+    std::lock_guard<std::mutex> lock(logs_mutex);
+    thread_logs.push_back(this_thread_log);
+  }
+  return this_thread_log;
+}
+
+static void write_entry(const LogEntry &entry) {
+  std::ostream &out = entry.level == LOG_ERROR ? std::cerr : std::cout;
+  out << entry.text << '\n';
+}
+
+AsyncLog::AsyncLog(LogLevel level, LogSite site, unsigned int err)
+    : m_level_(level), m_log_(nullptr), m_stream_(nullptr) {
+  if (!logger_running.load(std::memory_order_relaxed)) {
+    m_stream_ = new std::ostringstream();
+    return;
+  }
+
+  m_log_ = thread_log();
+  KeyState &state = m_log_->keys[(uint64_t)site << 32 | err];
+  uint64_t second = now_us() / 1000000;
+  if (state.second != second) {
+    state.second = second;
+    state.count = 0;
+  }
+  if (state.count >= kLogBurst) {
+    state.suppressed++;
+    suppressed_logs++;
+    return;
+  }
+  state.count++;
+  m_suppressed_ = state.suppressed;
+  state.suppressed = 0;
+  m_log_->stream.str("");
+  m_stream_ = &m_log_->stream;
+}
+
+AsyncLog::~AsyncLog() {
+  if (m_stream_ == nullptr) {
+    return;
+  }
+  if (m_suppressed_ != 0) {
+    // same site and errno, but the sql or values may differ.
+    *m_stream_ << " (" << m_suppressed_
+               << " more from this site and errno suppressed)";
+  }
+
+  if (m_log_ == nullptr) {
+    write_entry(LogEntry{m_level_, m_stream_->str()});
+    delete m_stream_;
+    return;
+  }
+  LogEntry &entry = m_log_->entry;
+  entry.level = m_level_;
+  entry.text = m_stream_->str();
+  if (!m_log_->ring.push(entry)) {
+    dropped_logs++;
+  }
+}
+
+static void drain_logs() {
+  LogEntry entry;
+  while (true) {
+    // read the flag first, so nothing queued before stop is left behind.
+    bool running = logger_running.load();
+    std::vector<ThreadLog *> logs;
+    {
+      std::lock_guard<std::mutex> lock(logs_mutex);
+      logs = thread_logs;
+    }
+    bool wrote = false;
+    for (auto log : logs) {
+      while (log->ring.pop(entry)) {
+        write_entry(entry);
+        wrote = true;
+      }
+    }
+    if (wrote) {
+      std::cout.flush();
+      std::cerr.flush();
+    }
+    if (!running) {
+      break;
+    }
+    usleep(10000);
+  }
+}
+
+void async_log_start() {
+  logger_running = true;
+  logger_thread = new std::thread(drain_logs);
+}
+
+void async_log_stop() {
+  if (logger_thread == nullptr) {
+    return;
+  }
+  logger_running = false;
+  logger_thread->join();
+  delete logger_thread;
+  logger_thread = nullptr;
+
+  std::lock_guard<std::mutex> lock(logs_mutex);
+  for (auto log : thread_logs) {
+    delete log;
+  }
+  thread_logs.clear();
+  if (dropped_logs.load() != 0 || suppressed_logs.load() != 0) {
+    std::cerr << "log messages suppressed: " << suppressed_logs.load()
+              << ", dropped: " << dropped_logs.load() << std::endl;
+  }
+}
@@ -0,0 +1,86 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : async_log.h
+ * @Description  : non-blocking logging for the worker threads. Every thread
+ *                 formats its messages into its own lock-free ring, a
+ *                 logger thread drains the rings to stdout/stderr, so a
+ *                 burst of failures never serializes the workers on the
+ *                 iostream lock. Each thread writes at most kLogBurst
+ *                 messages of one site and errno per second, the rest are
+ *                 counted and the next message of that site and errno that
+ *                 gets through says how many were suppressed. Messages that
+ *                 do not fit into a full ring are dropped and counted.
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <cstdint>
+#include <sstream>
+
+enum LogLevel {
+  LOG_INFO,  // stdout
+  LOG_ERROR, // stderr
+};
+
+// where a message is logged, the rate limit counts every site on its own.
+enum LogSite {
+  LOG_SITE_NONE,
+  LOG_SITE_THREAD,         // start and stop of the worker threads
+  LOG_SITE_CONNECT,        // connection init and connect
+  LOG_SITE_PIN,            // cpu pinning of the workers
+  LOG_SITE_STMT_PREPARE,   // prepared statement init and prepare
+  LOG_SITE_STMT_EXECUTE,   // prepared statement execute
+  LOG_SITE_STMT_REPREPARE, // reconnect to prepare the statements again
+  LOG_SITE_COMMIT,
+  LOG_SITE_INSERT,
+  LOG_SITE_RW_SELECT,      // sct select of the row on RW
+  LOG_SITE_RW_ROW,         // sct row missing on RW
+  LOG_SITE_UPDATE,         // sct update on RW
+  LOG_SITE_TRACK_GTID,
+  LOG_SITE_RO_SESSION,     // --ro-barrier-sql on a new RO connection
+  LOG_SITE_RO_BARRIER,     // failed RO barrier
+  LOG_SITE_RO_BARRIER_TIMEOUT,
+  LOG_SITE_RO_READ,        // failed RO read
+  LOG_SITE_RO_ROW,         // sct row missing on RO
+  LOG_SITE_RO_STALE,       // RO returned an old value
+  LOG_SITE_RO_LAG_TIMEOUT,
+  LOG_SITE_QUERY,          // query of the shortct and rqps workload
+  LOG_SITE_REPLAY,         // replayed query
+};
+
+struct ThreadLog;
+
+// queues one message when it goes out of scope, no newline needed:
+//   AsyncLog(LOG_ERROR, LOG_SITE_INSERT, err) << "Failed to ..., errno: "
+//                                             << err;
+// before async_log_start() and after async_log_stop() it writes directly.
+class AsyncLog {
+public:
+  explicit AsyncLog(LogLevel level, LogSite site = LOG_SITE_NONE,
+                    unsigned int err = 0);
+  ~AsyncLog();
+
+  template <typename T> AsyncLog &operator<<(const T &value) {
+    if (m_stream_ != nullptr) {
+      *m_stream_ << value;
+    }
+    return *this;
+  }
+
+private:
+  AsyncLog(const AsyncLog &) = delete;
+  void operator=(const AsyncLog &) = delete;
+
+  LogLevel m_level_;
+  ThreadLog *m_log_;
+  // nullptr when the message is suppressed.
+  std::ostringstream *m_stream_;
+  uint64_t m_suppressed_{0};
+};
+
+void async_log_start();
+// writes what is queued and stops the logger, workers must be done.
+void async_log_stop();
+
+#endif // ASYNC_LOG_H
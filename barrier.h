@@ -0,0 +1,49 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : barrier.h
+ * @Description  : reusable thread barrier, std::barrier is C++20.
+ */
+
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+class Barrier {
+public:
+  // on_complete runs in the last thread to arrive, before the others are
+  // released.
+  explicit Barrier(uint64_t count, std::function<void()> on_complete = nullptr)
+      : m_count_(count), m_on_complete_(on_complete) {}
+
+  // block until count threads arrived, the barrier can be used again after.
+  void wait() {
+    std::unique_lock<std::mutex> lock(m_mutex_);
+    uint64_t generation = m_generation_;
+    if (++m_arrived_ == m_count_) {
+      if (m_on_complete_) {
+        m_on_complete_();
+      }
+      m_arrived_ = 0;
+      m_generation_++;
+      m_cv_.notify_all();
+      return;
+    }
+    m_cv_.wait(lock, [this, generation] {
+      return generation != m_generation_;
+    });
+  }
+
+private:
+  std::mutex m_mutex_;
+  std::condition_variable m_cv_;
+  uint64_t m_count_;
+  std::function<void()> m_on_complete_;
+  uint64_t m_arrived_{0};
+  uint64_t m_generation_{0};
+};
+
+#endif // BARRIER_H
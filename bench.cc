@@ -0,0 +1,326 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : bench.cc
+ * @Description  : mysqlsct_bench, microbenchmarks of the per operation code
+ *                 of the client: the sct sql, the Statistics counters and
+ *                 latency histograms, the rqps pacer, the strtoull of the
+ *                 result rows and the query file workload. Every benchmark
+ *                 runs on 1, 2, 4, ... --threads threads for --bench-time-ms
+ *                 and reports ns and heap allocations per operation and the
+ *                 operations per second of all threads.
+ */
+
+#include "barrier.h"
+#include "histogram.h"
+#include "options.h"
+#include "pacer.h"
+#include "rand_gen.h"
+#include "sct_sql.h"
+#include "workload.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <getopt.h>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// heap allocations of this thread, counted by the operator new below.
+static thread_local uint64_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+// keeps the compiler from dropping a result nobody reads.
+static void keep(const void *p) { asm volatile("" : : "r"(p) : "memory"); }
+
+// what a thread runs ops times in the timed loop.
+using OpLoop = std::function<void(uint64_t ops)>;
+// builds the loop of thread out of threads, before the clock starts.
+using BenchSetup = std::function<OpLoop(uint64_t thread, uint64_t threads)>;
+
+struct Bench {
+  const char *name;
+  const char *op;
+  BenchSetup setup;
+};
+
+static uint64_t max_threads = 0;
+static uint64_t bench_time_ms = 200;
+static const char *filter = nullptr;
+static const char *bench_query_file = "short_connection_querys.txt";
+
+static const std::string table = "sct_rw_0";
+
+static Statistics shared_stats;
+// a cache line each, so the threads do not share lines.
+struct alignas(64) PaddedStatistics {
+  Statistics stats;
+};
+// new[] of c++11 ignores the alignment of PaddedStatistics, the array is
+// allocated with posix_memalign and freed with free.
+struct AlignedFree {
+  void operator()(PaddedStatistics *p) const { free(p); }
+};
+static std::unique_ptr<PaddedStatistics[], AlignedFree> private_stats;
+static std::unique_ptr<LatencyStats> latency;
+static std::unique_ptr<Workload> workload;
+
+static std::vector<Bench> benches() {
+  std::vector<Bench> list;
+  list.push_back({"select_sql", "query", [](uint64_t thread, uint64_t) {
+                    FastRand rand(thread_seed(thread));
+                    return OpLoop([rand](uint64_t ops) mutable {
+                      for (uint64_t i = 0; i < ops; i++) {
+                        std::string sql =
+                            sct_select_sql(table, rand.uniform(1000000) + 1);
+                        keep(sql.data());
+                      }
+                    });
+                  }});
+  list.push_back({"update_sql", "query", [](uint64_t thread, uint64_t) {
+                    FastRand rand(thread_seed(thread));
+                    return OpLoop([rand](uint64_t ops) mutable {
+                      for (uint64_t i = 0; i < ops; i++) {
+                        std::string sql =
+                            sct_update_sql(table, rand.uniform(1000000) + 1,
+                                           rand.uniform(1000000), true);
+                        keep(sql.data());
+                      }
+                    });
+                  }});
+  list.push_back({"statistics_shared", "increment", [](uint64_t, uint64_t) {
+                    return OpLoop([](uint64_t ops) {
+                      for (uint64_t i = 0; i < ops; i++) {
+                        shared_stats.increase_cnt_total();
+                      }
+                    });
+                  }});
+  list.push_back({"statistics_private", "increment",
+                  [](uint64_t thread, uint64_t) {
+                    Statistics *stats = &private_stats[thread].stats;
+                    return OpLoop([stats](uint64_t ops) {
+                      for (uint64_t i = 0; i < ops; i++) {
+                        stats->increase_cnt_total();
+                      }
+                    });
+                  }});
+  list.push_back({"latency_record", "record", [](uint64_t thread, uint64_t) {
+                    FastRand rand(thread_seed(thread));
+                    return OpLoop([thread, rand](uint64_t ops) mutable {
+                      for (uint64_t i = 0; i < ops; i++) {
+                        latency->record(thread, rand.uniform(100000));
+                      }
+                    });
+                  }});
+  list.push_back({"pacer_poisson", "slot",
+                  [](uint64_t thread, uint64_t threads) {
+                    std::shared_ptr<Pacer> pacer(
+                        new Pacer(1e6, thread, threads, ARRIVAL_POISSON));
+                    return OpLoop([pacer](uint64_t ops) {
+                      uint64_t slot = 0;
+                      for (uint64_t i = 0; i < ops; i++) {
+                        slot += pacer->next_slot();
+                      }
+                      keep(&slot);
+                    });
+                  }});
+  list.push_back({"row_strtoull", "row", [](uint64_t thread, uint64_t) {
+                    // the c1 values as mysql_fetch_row returns them.
+                    FastRand rand(thread_seed(thread));
+                    std::shared_ptr<std::vector<std::string>> rows(
+                        new std::vector<std::string>());
+                    for (int i = 0; i < 1024; i++) {
+                      rows->push_back(std::to_string(rand.uniform(1000000)));
+                    }
+                    return OpLoop([rows](uint64_t ops) {
+                      uint64_t sum = 0;
+                      for (uint64_t i = 0; i < ops; i++) {
+                        sum += strtoull((*rows)[i & 1023].c_str(), nullptr, 10);
+                      }
+                      keep(&sum);
+                    });
+                  }});
+  list.push_back({"workload_render", "query",
+                  [](uint64_t thread, uint64_t threads) {
+                    std::shared_ptr<WorkloadCursor> cursor(
+                        new WorkloadCursor(*workload, thread, threads));
+                    return OpLoop([cursor](uint64_t ops) {
+                      size_t pass = cursor->pass_size();
+                      for (uint64_t i = 0; i < ops; i++) {
+                        keep(cursor->next(i % pass).data());
+                      }
+                    });
+                  }});
+  list.push_back({"workload_load", "file", [](uint64_t, uint64_t) {
+                    return OpLoop([](uint64_t ops) {
+                      for (uint64_t i = 0; i < ops; i++) {
+                        Workload loaded;
+                        loaded.load(bench_query_file);
+                        keep(&loaded);
+                      }
+                    });
+                  }});
+  return list;
+}
+
+struct BenchPoint {
+  double ns_per_op;
+  double allocs_per_op;
+  double mops;
+};
+
+static BenchPoint run_bench(const Bench &bench, uint64_t threads) {
+  shared_stats.clear();
+  void *mem = nullptr;
+  if (posix_memalign(&mem, alignof(PaddedStatistics),
+                     threads * sizeof(PaddedStatistics)) != 0) {
+    throw std::bad_alloc();
+  }
+  PaddedStatistics *padded = static_cast<PaddedStatistics *>(mem);
+  for (uint64_t t = 0; t < threads; t++) {
+    new (&padded[t]) PaddedStatistics();
+  }
+  private_stats.reset(padded);
+  latency.reset(new LatencyStats());
+  latency->init(threads);
+
+  std::vector<uint64_t> ops(threads), elapsed_ns(threads), allocs(threads);
+  Barrier start(threads);
+  std::vector<std::thread> workers;
+  for (uint64_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      OpLoop loop = bench.setup(t, threads);
+      // a first pass warms the caches and takes the lazy allocations.
+      loop(64);
+      start.wait();
+      uint64_t first_allocs = allocations;
+      uint64_t begin = monotonic_ns();
+      uint64_t deadline = begin + bench_time_ms * 1000000;
+      uint64_t now = begin;
+      uint64_t batch = 1;
+      while (now < deadline) {
+        loop(batch);
+        ops[t] += batch;
+        uint64_t last = now;
+        now = monotonic_ns();
+        // batches of about 10us keep the clock out of the measurement.
+        if (now - last < 10000 && batch < (1 << 20)) {
+          batch *= 2;
+        }
+      }
+      elapsed_ns[t] = now - begin;
+      allocs[t] = allocations - first_allocs;
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  BenchPoint point{0, 0, 0};
+  uint64_t total_ops = 0, total_allocs = 0, max_ns = 0;
+  for (uint64_t t = 0; t < threads; t++) {
+    point.ns_per_op += (double)elapsed_ns[t] / ops[t] / threads;
+    total_ops += ops[t];
+    total_allocs += allocs[t];
+    max_ns = std::max(max_ns, elapsed_ns[t]);
+  }
+  point.allocs_per_op = (double)total_allocs / total_ops;
+  point.mops = total_ops * 1e3 / max_ns;
+  return point;
+}
+
+static void bench_usage() {
+  std::cout << "Usage: mysqlsct_bench [OPTIONS]" << std::endl;
+  std::cout << "--threads	most threads to scale to, the number of cpus "
+               "by default.\n";
+  std::cout << "--bench-time-ms	time of every benchmark and thread "
+               "count, 200 by default.\n";
+  std::cout << "--filter	only the benchmarks whose name contains it.\n";
+  std::cout << "--query-file	query file of the workload benchmarks, "
+               "short_connection_querys.txt by default.\n";
+}
+
+static bool parse_bench_option(int argc, char *argv[]) {
+  static const struct option long_options[] = {
+      {"help", 0, nullptr, '?'},
+      {"threads", 1, nullptr, 't'},
+      {"bench-time-ms", 1, nullptr, 'b'},
+      {"filter", 1, nullptr, 'f'},
+      {"query-file", 1, nullptr, 'q'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "?", long_options, nullptr)) != -1) {
+    switch (opt) {
+    case 't':
+      max_threads = strtoull(optarg, nullptr, 10);
+      break;
+    case 'b':
+      bench_time_ms = strtoull(optarg, nullptr, 10);
+      break;
+    case 'f':
+      filter = optarg;
+      break;
+    case 'q':
+      bench_query_file = optarg;
+      break;
+    default:
+      bench_usage();
+      return false;
+    }
+  }
+  if (max_threads == 0) {
+    max_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (bench_time_ms == 0) {
+    std::cout << "bench-time-ms must be greater than 0." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (!parse_bench_option(argc, argv)) {
+    return 1;
+  }
+  workload.reset(new Workload());
+  bool has_workload = workload->load(bench_query_file);
+
+  std::vector<uint64_t> thread_counts;
+  for (uint64_t t = 1; t < max_threads; t *= 2) {
+    thread_counts.push_back(t);
+  }
+  thread_counts.push_back(max_threads);
+
+  printf("%-20s %8s %12s %10s %12s\n", "benchmark", "threads", "ns/op",
+         "allocs/op", "Mops/s");
+  for (const Bench &bench : benches()) {
+    if (filter != nullptr && strstr(bench.name, filter) == nullptr) {
+      continue;
+    }
+    if (!has_workload && strncmp(bench.name, "workload", 8) == 0) {
+      std::cout << bench.name << ": skipped, no workload." << std::endl;
+      continue;
+    }
+    for (uint64_t threads : thread_counts) {
+      BenchPoint point = run_bench(bench, threads);
+      printf("%-20s %8llu %12.1f %10.2f %12.3f  (op: %s)\n", bench.name,
+             (unsigned long long)threads, point.ns_per_op,
+             point.allocs_per_op, point.mops, bench.op);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : conn_pool.cc
+ * @Description  : fixed size pool of connections shared by worker threads.
+ */
+
+#include "conn_pool.h"
+
+#include <chrono>
+
+MYSQL *ConnectionPool::checkout(uint64_t thread_id,
+                                const std::atomic_bool &stop) {
+  std::unique_lock<std::mutex> lock(m_mutex_);
+  while (m_idle_.empty() && m_opened_ >= m_size_) {
+    if (stop) {
+      return nullptr;
+    }
+    m_cv_.wait_for(lock, std::chrono::milliseconds(100));
+  }
+
+  if (!m_idle_.empty()) {
+    MYSQL *conn = m_idle_.back();
+    m_idle_.pop_back();
+    return conn;
+  }
+
+  // connect outside the lock, other threads keep using idle connections.
+  m_opened_++;
+  lock.unlock();
+  MYSQL *conn = m_connect_(thread_id);
+  if (conn == nullptr) {
+    lock.lock();
+    m_opened_--;
+    m_cv_.notify_one();
+  }
+  return conn;
+}
+
+void ConnectionPool::checkin(MYSQL *conn, bool broken) {
+  if (broken) {
+    m_disconnect_(conn);
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  if (broken) {
+    m_opened_--;
+  } else {
+    m_idle_.push_back(conn);
+  }
+  m_cv_.notify_one();
+}
+
+void ConnectionPool::close_all() {
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  for (auto conn : m_idle_) {
+    m_disconnect_(conn);
+  }
+  m_opened_ -= m_idle_.size();
+  m_idle_.clear();
+}
@@ -0,0 +1,48 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : conn_pool.h
+ * @Description  : fixed size pool of connections shared by worker threads,
+ *                 connections are opened lazily and re-opened after errors.
+ */
+
+#ifndef CONN_POOL_H
+#define CONN_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <mysql/mysql.h>
+#include <vector>
+
+class ConnectionPool {
+public:
+  // connect returns a connected MYSQL or nullptr, it runs on the thread
+  // that checks out and gets its thread id. disconnect closes one.
+  ConnectionPool(size_t size, std::function<MYSQL *(uint64_t)> connect,
+                 std::function<void(MYSQL *)> disconnect)
+      : m_size_(size), m_connect_(connect), m_disconnect_(disconnect) {}
+  ~ConnectionPool() { close_all(); }
+
+  // wait for an idle connection, open a new one if the pool is not full.
+  // returns nullptr if connecting failed or stop was set while waiting.
+  MYSQL *checkout(uint64_t thread_id, const std::atomic_bool &stop);
+  // broken connections are closed, the next checkout opens a new one.
+  void checkin(MYSQL *conn, bool broken);
+  void close_all();
+
+private:
+  ConnectionPool(const ConnectionPool &) = delete;
+  void operator=(const ConnectionPool &) = delete;
+
+  std::mutex m_mutex_;
+  std::condition_variable m_cv_;
+  std::vector<MYSQL *> m_idle_;
+  size_t m_size_;
+  size_t m_opened_{0};
+  std::function<MYSQL *(uint64_t)> m_connect_;
+  std::function<void(MYSQL *)> m_disconnect_;
+};
+
+#endif // CONN_POOL_H
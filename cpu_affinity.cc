@@ -0,0 +1,360 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : cpu_affinity.cc
+ * @Description  : placement of the worker threads and their cpu use.
+ */
+
+#include "cpu_affinity.h"
+
+#include "async_log.h"
+#include "pacer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <pthread.h>
+#include <sched.h>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+
+static std::vector<int> cpus;
+
+struct WorkerCpu {
+  uint64_t wall_ns;
+  uint64_t cpu_ns;
+  uint64_t user_us;
+  uint64_t sys_us;
+  uint64_t nvcsw;
+  uint64_t nivcsw;
+};
+static std::vector<WorkerCpu> worker_cpu;
+
+// parses the kernel cpu list format, 0-3,8,10-11.
+static bool parse_cpu_list(const std::string &list, std::vector<int> &out) {
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    item.erase(std::remove_if(item.begin(), item.end(), ::isspace),
+               item.end());
+    if (item.empty()) {
+      continue;
+    }
+    char *end = nullptr;
+    long first = strtol(item.c_str(), &end, 10);
+    long last = first;
+    if (*end == '-') {
+      last = strtol(end + 1, &end, 10);
+    }
+    if (end == item.c_str() || *end != '\0' || first < 0 || last < first ||
+        last >= CPU_SETSIZE) {
+      return false;
+    }
+    for (long cpu = first; cpu <= last; cpu++) {
+      out.push_back((int)cpu);
+    }
+  }
+  return true;
+}
+
+static std::string format_cpus(const std::vector<int> &list) {
+  std::string s;
+  for (size_t i = 0; i < list.size(); i++) {
+    s += (i == 0 ? "" : ",") + std::to_string(list[i]);
+  }
+  return s;
+}
+
+static bool read_line(const std::string &path, std::string &line) {
+  std::ifstream in(path);
+  return (bool)std::getline(in, line);
+}
+
+static std::vector<std::string> list_dir(const std::string &path) {
+  std::vector<std::string> names;
+  DIR *dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return names;
+  }
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  return names;
+}
+
+// cpus the interrupts of the network devices are steered to. An interrupt
+// that may go to every allowed cpu is not steered and leaves out nothing.
+static std::set<int> nic_irq_cpus(const cpu_set_t &allowed) {
+  std::set<std::string> irqs;
+  std::vector<std::string> nics;
+  for (auto &nic : list_dir("/sys/class/net")) {
+    if (nic == "lo") {
+      continue;
+    }
+    nics.push_back(nic);
+    for (auto &irq : list_dir("/sys/class/net/" + nic + "/device/msi_irqs")) {
+      irqs.insert(irq);
+    }
+  }
+  // drivers without msi name their vectors after the interface.
+  std::ifstream interrupts("/proc/interrupts");
+  std::string line;
+  while (std::getline(interrupts, line)) {
+    std::stringstream ss(line);
+    std::string irq, action, token;
+    ss >> irq;
+    while (ss >> token) {
+      action = token;
+    }
+    if (irq.empty() || irq.back() != ':') {
+      continue;
+    }
+    irq.pop_back();
+    for (auto &nic : nics) {
+      if (action == nic || action.compare(0, nic.size() + 1, nic + "-") == 0) {
+        irqs.insert(irq);
+      }
+    }
+  }
+
+  std::set<int> result;
+  for (auto &irq : irqs) {
+    std::string list;
+    if (!read_line("/proc/irq/" + irq + "/effective_affinity_list", list) &&
+        !read_line("/proc/irq/" + irq + "/smp_affinity_list", list)) {
+      continue;
+    }
+    std::vector<int> irq_cpus;
+    if (!parse_cpu_list(list, irq_cpus)) {
+      continue;
+    }
+    size_t covered = 0;
+    for (int cpu : irq_cpus) {
+      covered += CPU_ISSET(cpu, &allowed) ? 1 : 0;
+    }
+    if (covered < (size_t)CPU_COUNT(&allowed)) {
+      result.insert(irq_cpus.begin(), irq_cpus.end());
+    }
+  }
+  return result;
+}
+
+// the allowed cpus of every numa node in turn, the first hyperthread of all
+// cores before the second ones.
+static std::vector<int> spread_cpus(const std::vector<int> &allowed) {
+  std::map<int, int> node_of;
+  for (auto &name : list_dir("/sys/devices/system/node")) {
+    std::string list;
+    std::vector<int> node_cpus;
+    if (name.compare(0, 4, "node") != 0 ||
+        !read_line("/sys/devices/system/node/" + name + "/cpulist", list) ||
+        !parse_cpu_list(list, node_cpus)) {
+      continue;
+    }
+    for (int cpu : node_cpus) {
+      node_of[cpu] = atoi(name.c_str() + 4);
+    }
+  }
+
+  // node -> (hyperthread rank, cpu)
+  std::map<int, std::vector<std::pair<int, int>>> nodes;
+  for (int cpu : allowed) {
+    std::string list;
+    std::vector<int> siblings;
+    read_line("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                  "/topology/thread_siblings_list",
+              list);
+    parse_cpu_list(list, siblings);
+    std::sort(siblings.begin(), siblings.end());
+    int rank = std::find(siblings.begin(), siblings.end(), cpu) -
+               siblings.begin();
+    if (rank == (int)siblings.size()) {
+      rank = 0;
+    }
+    nodes[node_of.count(cpu) ? node_of[cpu] : 0].push_back({rank, cpu});
+  }
+  for (auto &node : nodes) {
+    std::sort(node.second.begin(), node.second.end());
+  }
+
+  std::vector<int> result;
+  for (size_t i = 0; result.size() < allowed.size(); i++) {
+    for (auto &node : nodes) {
+      if (i < node.second.size()) {
+        result.push_back(node.second[i].second);
+      }
+    }
+  }
+  return result;
+}
+
+bool parse_cpu_affinity(const char *spec) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    std::cerr << "Failed to get the cpus of the process, errno: " << errno
+              << std::endl;
+    return false;
+  }
+  cpus.clear();
+
+  if (strcmp(spec, "auto") != 0) {
+    if (!parse_cpu_list(spec, cpus) || cpus.empty()) {
+      std::cerr << "invalid cpu-affinity: " << spec << std::endl;
+      return false;
+    }
+    for (int cpu : cpus) {
+      if (!CPU_ISSET(cpu, &allowed)) {
+        std::cerr << "cpu " << cpu << " of cpu-affinity is not available."
+                  << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::set<int> irq_cpus = nic_irq_cpus(allowed);
+  std::vector<int> usable;
+  std::vector<int> left_out;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed)) {
+      continue;
+    }
+    if (irq_cpus.count(cpu)) {
+      left_out.push_back(cpu);
+    } else {
+      usable.push_back(cpu);
+    }
+  }
+  if (usable.empty()) {
+    // the nic interrupts go to every cpu, nothing to avoid.
+    usable.swap(left_out);
+  }
+  cpus = spread_cpus(usable);
+  std::cout << "cpu-affinity auto: " << format_cpus(cpus);
+  if (!left_out.empty()) {
+    std::cout << ", left out for nic interrupts: " << format_cpus(left_out);
+  }
+  std::cout << std::endl;
+  return true;
+}
+
+const std::vector<int> &affinity_cpus() { return cpus; }
+
+void pin_worker(size_t index) {
+  if (cpus.empty()) {
+    return;
+  }
+  int cpu = cpus[index % cpus.size()];
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (err != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_PIN, err)
+        << "Failed to pin worker " << index << " to cpu " << cpu << ", errno: "
+        << err;
+  }
+}
+
+static uint64_t thread_cpu_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t timeval_us(const struct timeval &tv) {
+  return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+WorkerCpuTime::WorkerCpuTime(size_t index) : m_index_(index) {
+  struct rusage ru;
+  memset(&ru, 0, sizeof(ru));
+  getrusage(RUSAGE_THREAD, &ru);
+  m_start_user_us_ = timeval_us(ru.ru_utime);
+  m_start_sys_us_ = timeval_us(ru.ru_stime);
+  m_start_nvcsw_ = ru.ru_nvcsw;
+  m_start_nivcsw_ = ru.ru_nivcsw;
+  m_start_cpu_ns_ = thread_cpu_ns();
+  m_start_ns_ = monotonic_ns();
+}
+
+WorkerCpuTime::~WorkerCpuTime() {
+  if (m_index_ >= worker_cpu.size()) {
+    return;
+  }
+  struct rusage ru;
+  memset(&ru, 0, sizeof(ru));
+  getrusage(RUSAGE_THREAD, &ru);
+  WorkerCpu &slot = worker_cpu[m_index_];
+  slot.wall_ns = monotonic_ns() - m_start_ns_;
+  slot.cpu_ns = thread_cpu_ns() - m_start_cpu_ns_;
+  slot.user_us = timeval_us(ru.ru_utime) - m_start_user_us_;
+  slot.sys_us = timeval_us(ru.ru_stime) - m_start_sys_us_;
+  slot.nvcsw = ru.ru_nvcsw - m_start_nvcsw_;
+  slot.nivcsw = ru.ru_nivcsw - m_start_nivcsw_;
+}
+
+void worker_cpu_init(size_t workers) {
+  worker_cpu.assign(workers, WorkerCpu());
+}
+
+void worker_cpu_summary(ReportRecord *record) {
+  uint64_t cpu_ns = 0, user_us = 0, sys_us = 0, nvcsw = 0, nivcsw = 0;
+  double sum_pct = 0, max_pct = 0;
+  size_t workers = 0, busiest = 0;
+  for (size_t i = 0; i < worker_cpu.size(); i++) {
+    const WorkerCpu &w = worker_cpu[i];
+    if (w.wall_ns == 0) {
+      continue;
+    }
+    double pct = w.cpu_ns * 100.0 / w.wall_ns;
+    if (pct > max_pct) {
+      max_pct = pct;
+      busiest = i;
+    }
+    sum_pct += pct;
+    cpu_ns += w.cpu_ns;
+    user_us += w.user_us;
+    sys_us += w.sys_us;
+    nvcsw += w.nvcsw;
+    nivcsw += w.nivcsw;
+    workers++;
+  }
+  if (workers == 0) {
+    return;
+  }
+  double avg_pct = sum_pct / workers;
+  std::cout << "Client cpu: " << workers << " workers used " << cpu_ns / 1e9
+            << "s (user " << user_us / 1e6 << "s, sys " << sys_us / 1e6
+            << "s), avg " << avg_pct << "% of a cpu, busiest worker "
+            << busiest << ": " << max_pct
+            << "%, context switches voluntary: " << nvcsw
+            << ", involuntary: " << nivcsw << std::endl;
+  if (max_pct >= 90) {
+    std::cout << "Client cpu: worker " << busiest
+              << " was almost always on cpu, the client may be the "
+                 "bottleneck, add threads or client hosts."
+              << std::endl;
+  }
+  if (record) {
+    record->add("client_cpu_s", cpu_ns / 1e9)
+        .add("client_user_s", user_us / 1e6)
+        .add("client_sys_s", sys_us / 1e6)
+        .add("client_cpu_avg_pct", avg_pct)
+        .add("client_cpu_max_pct", max_pct)
+        .add("client_nvcsw", nvcsw)
+        .add("client_nivcsw", nivcsw);
+  }
+}
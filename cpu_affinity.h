@@ -0,0 +1,57 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : cpu_affinity.h
+ * @Description  : placement of the worker threads and their cpu use. With
+ *                 --cpu-affinity every worker pins itself to a cpu before
+ *                 it allocates its state, so the memory is local to its
+ *                 numa node. The workers also measure the cpu time they
+ *                 use, a busy client shows up in the summary instead of
+ *                 passing for a slow server.
+ */
+
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "report_writer.h"
+
+// a cpu list like 0-7,16,18, or auto: the physical cores of all numa nodes
+// in turn, then their hyperthreads, leaving out the cpus serving the nic
+// interrupts. false on an invalid list.
+bool parse_cpu_affinity(const char *spec);
+// the cpus worker i is pinned to in turn, empty without --cpu-affinity.
+const std::vector<int> &affinity_cpus();
+
+// pins the calling thread to the cpu of worker index, nothing without
+// --cpu-affinity.
+void pin_worker(size_t index);
+
+// measures the cpu time of the calling worker from construction until it is
+// destroyed, into slot index.
+class WorkerCpuTime {
+public:
+  explicit WorkerCpuTime(size_t index);
+  ~WorkerCpuTime();
+
+private:
+  WorkerCpuTime(const WorkerCpuTime &) = delete;
+  void operator=(const WorkerCpuTime &) = delete;
+
+  size_t m_index_;
+  uint64_t m_start_ns_;
+  uint64_t m_start_cpu_ns_;
+  uint64_t m_start_user_us_;
+  uint64_t m_start_sys_us_;
+  uint64_t m_start_nvcsw_;
+  uint64_t m_start_nivcsw_;
+};
+
+// clears the slots of workers, before they start.
+void worker_cpu_init(size_t workers);
+// prints the cpu use of the workers measured so far, after they are joined.
+void worker_cpu_summary(ReportRecord *record);
+
+#endif // CPU_AFFINITY_H
@@ -0,0 +1,278 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : data_loader.cc
+ * @Description  : bulk loader for the sct tables.
+ */
+
+#include "data_loader.h"
+#include "options.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mysql/errmsg.h>
+#include <thread>
+#include <vector>
+
+extern char *user;
+extern char *password;
+extern char *host_rw;
+extern uint port_rw;
+extern std::vector<Endpoint> ro_endpoints;
+extern uint detail_log;
+extern uint select_after_insert;
+extern uint64_t prepare_batch;
+extern uint64_t prepare_threads;
+extern PrepareMethod prepare_method;
+
+static std::atomic<uint64_t> rows_loaded{0};
+
+uint64_t loaded_rows() { return rows_loaded.load(); }
+
+static MYSQL *loader_connect(const char *host, uint port, const char *db) {
+  MYSQL *conn = mysql_init(0);
+  if (conn == nullptr) {
+    std::cerr << "Failed to init loader connection" << std::endl;
+    return nullptr;
+  }
+
+  unsigned int local_infile = 1;
+  mysql_options(conn, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+  if (!mysql_real_connect(conn, host, user, password, db, port, nullptr, 0)) {
+    std::cerr << "Failed to connect for loading data, host: " << host
+              << ", port: " << port << ", errno: " << mysql_errno(conn)
+              << ", errmsg: " << mysql_error(conn) << std::endl;
+    mysql_close(conn);
+    return nullptr;
+  }
+  return conn;
+}
+
+int DataLoader::load(uint64_t first_pk, uint64_t last_pk) {
+  if (first_pk > last_pk) {
+    return 0;
+  }
+
+  uint64_t rows = last_pk - first_pk + 1;
+  uint64_t threads = std::max<uint64_t>(1, std::min(prepare_threads, rows));
+  if (threads == 1) {
+    return load_range(first_pk, last_pk);
+  }
+
+  std::vector<std::thread *> loaders;
+  std::vector<int> results(threads, 0);
+  uint64_t per_thread = rows / threads;
+  uint64_t begin = first_pk;
+  for (uint64_t i = 0; i < threads; i++) {
+    uint64_t end = i == threads - 1 ? last_pk : begin + per_thread - 1;
+    loaders.push_back(new std::thread([this, &results, i, begin, end]() {
+      results[i] = load_range(begin, end);
+      mysql_thread_end();
+    }));
+    begin = end + 1;
+  }
+
+  int res = 0;
+  for (uint64_t i = 0; i < threads; i++) {
+    loaders[i]->join();
+    delete loaders[i];
+    if (results[i] != 0) {
+      res = results[i];
+    }
+  }
+  return res;
+}
+
+int DataLoader::load_range(uint64_t first_pk, uint64_t last_pk) {
+  int res = 0;
+  MYSQL *conn_rw = loader_connect(host_rw, port_rw, m_db_name_);
+  MYSQL *conn_ro = nullptr;
+  std::string query;
+  uint64_t batch = std::max<uint64_t>(1, prepare_batch);
+
+  do {
+    if (conn_rw == nullptr) {
+      res = -1;
+      break;
+    }
+    // with several RO endpoints the loaded rows are checked on the first.
+    if (select_after_insert) {
+      conn_ro = loader_connect(ro_endpoints[0].host.c_str(),
+                               ro_endpoints[0].port, m_db_name_);
+      if (conn_ro == nullptr) {
+        res = -1;
+        break;
+      }
+    }
+
+    for (uint64_t pk = first_pk; pk <= last_pk; pk += batch) {
+      uint64_t end = std::min(last_pk, pk + batch - 1);
+      if (prepare_method == PREPARE_LOAD_DATA) {
+        res = load_data_batch(conn_rw, pk, end);
+      } else {
+        res = insert_batch(conn_rw, pk, end, query);
+      }
+      if (res != 0) {
+        break;
+      }
+      rows_loaded += end - pk + 1;
+
+      if (select_after_insert) {
+        res = verify_batch(conn_ro, pk, end);
+        if (res != 0) {
+          break;
+        }
+      }
+    }
+  } while (0);
+
+  if (conn_rw != nullptr) {
+    mysql_close(conn_rw);
+  }
+  if (conn_ro != nullptr) {
+    mysql_close(conn_ro);
+  }
+  return res;
+}
+
+int DataLoader::insert_batch(MYSQL *conn, uint64_t first_pk, uint64_t last_pk,
+                             std::string &query) {
+  query.clear();
+  query += "insert into " + m_table_name_ + " values";
+  for (uint64_t pk = first_pk; pk <= last_pk; pk++) {
+    if (pk != first_pk) {
+      query += ',';
+    }
+    query += '(';
+    query += std::to_string(pk);
+    query += ",0)";
+  }
+
+  int res = mysql_real_query(conn, query.data(), query.size());
+  if (res != 0) {
+    std::cout << "Failed to insert, table: " << m_table_name_
+              << ", pk: " << first_pk << "-" << last_pk
+              << ", errno: " << mysql_errno(conn)
+              << ", errmsg: " << mysql_error(conn) << std::endl;
+  }
+  return res;
+}
+
+/*
+  LOAD DATA LOCAL INFILE, the "file" is generated on the fly by the
+  local infile handler, so nothing is materialized on disk or in memory.
+*/
+struct InfileStream {
+  uint64_t next_pk;
+  uint64_t last_pk;
+  char line[32];
+  size_t line_len;
+  size_t line_pos;
+};
+
+static int infile_init(void **ptr, const char *, void *userdata) {
+  *ptr = userdata;
+  return 0;
+}
+
+static int infile_read(void *ptr, char *buf, unsigned int buf_len) {
+  InfileStream *stream = (InfileStream *)ptr;
+  unsigned int len = 0;
+  while (len < buf_len) {
+    if (stream->line_pos == stream->line_len) {
+      if (stream->next_pk > stream->last_pk) {
+        break;
+      }
+      stream->line_len =
+          snprintf(stream->line, sizeof(stream->line), "%llu\t0\n",
+                   (unsigned long long)stream->next_pk++);
+      stream->line_pos = 0;
+    }
+    size_t n = std::min<size_t>(buf_len - len,
+                                stream->line_len - stream->line_pos);
+    memcpy(buf + len, stream->line + stream->line_pos, n);
+    stream->line_pos += n;
+    len += n;
+  }
+  return len;
+}
+
+static void infile_end(void *) {}
+
+static int infile_error(void *, char *error_msg, unsigned int error_msg_len) {
+  snprintf(error_msg, error_msg_len, "mysqlsct data stream error");
+  return CR_UNKNOWN_ERROR;
+}
+
+int DataLoader::load_data_batch(MYSQL *conn, uint64_t first_pk,
+                                uint64_t last_pk) {
+  InfileStream stream;
+  memset(&stream, 0, sizeof(stream));
+  stream.next_pk = first_pk;
+  stream.last_pk = last_pk;
+  mysql_set_local_infile_handler(conn, infile_init, infile_read, infile_end,
+                                 infile_error, &stream);
+
+  std::string query = "load data local infile 'mysqlsct.stream' into table " +
+                      m_table_name_ + " (id, c1)";
+  int res = mysql_real_query(conn, query.data(), query.size());
+  if (res != 0) {
+    std::cout << "Failed to load data, sql: " << query
+              << ", pk: " << first_pk << "-" << last_pk
+              << ", errno: " << mysql_errno(conn)
+              << ", errmsg: " << mysql_error(conn) << std::endl;
+  }
+  return res;
+}
+
+/*
+  select_after_insert: every batch must be visible on RO right after it was
+  committed on RW, check the whole batch with one range query.
+*/
+int DataLoader::verify_batch(MYSQL *conn, uint64_t first_pk,
+                             uint64_t last_pk) {
+  int res = 0;
+  std::string query = "select count(*) from " + m_table_name_ +
+                      " where id between " + std::to_string(first_pk) +
+                      " and " + std::to_string(last_pk);
+  MYSQL_RES *mysql_res = nullptr;
+  MYSQL_ROW row;
+
+  do {
+    res = mysql_query(conn, query.data());
+    if (res != 0) {
+      std::cout << "Failed to select after insert, sql: " << query
+                << ", errno: " << mysql_errno(conn)
+                << ", errmsg: " << mysql_error(conn) << std::endl;
+      break;
+    }
+
+    mysql_res = mysql_store_result(conn);
+    if (mysql_res == nullptr) {
+      res = -1;
+      if (detail_log) {
+        std::cerr << "Failed to test consistency after insert, mysql res is "
+                     "nullptr, sql: "
+                  << query << std::endl;
+      }
+      break;
+    }
+
+    row = mysql_fetch_row(mysql_res);
+    uint64_t visible = row && row[0] ? strtoull(row[0], nullptr, 10) : 0;
+    if (visible != last_pk - first_pk + 1 && detail_log) {
+      std::cerr << "Failed to test consistency after insert, RO sees "
+                << visible << " of " << last_pk - first_pk + 1
+                << " rows, sql: " << query << std::endl;
+    }
+    mysql_free_result(mysql_res);
+  } while (0);
+
+  if (mysql_query(conn, "commit") != 0) {
+    std::cerr << "Failed to commit, errno: " << mysql_errno(conn)
+              << ", errmsg: " << mysql_error(conn);
+  }
+  return res;
+}
@@ -0,0 +1,38 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : data_loader.h
+ * @Description  : bulk loader for the sct tables, batched multi-row INSERT or
+ *                 LOAD DATA LOCAL INFILE from a generated in-memory stream,
+ *                 split over several loader connections.
+ */
+
+#ifndef DATA_LOADER_H
+#define DATA_LOADER_H
+
+#include <cstdint>
+#include <mysql/mysql.h>
+#include <string>
+
+class DataLoader {
+public:
+  DataLoader(const char *db_name, const std::string &table_name)
+      : m_db_name_(db_name), m_table_name_(table_name) {}
+
+  // load rows [first_pk, last_pk] with --prepare-threads connections.
+  int load(uint64_t first_pk, uint64_t last_pk);
+
+private:
+  int load_range(uint64_t first_pk, uint64_t last_pk);
+  int insert_batch(MYSQL *conn, uint64_t first_pk, uint64_t last_pk,
+                   std::string &query);
+  int load_data_batch(MYSQL *conn, uint64_t first_pk, uint64_t last_pk);
+  int verify_batch(MYSQL *conn, uint64_t first_pk, uint64_t last_pk);
+
+  const char *m_db_name_;
+  std::string m_table_name_;
+};
+
+// rows loaded by all loaders so far, for progress reports.
+uint64_t loaded_rows();
+
+#endif // DATA_LOADER_H
@@ -0,0 +1,827 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : dist.cc
+ * @Description  : multi-process runs of the sct mode.
+ */
+
+#include "dist.h"
+
+#include "options.h"
+#include "report_writer.h"
+#include "stop_signal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+extern uint64_t report_interval; // s
+extern char *dist_listen;
+extern char *dist_connect;
+extern uint64_t dist_workers;
+
+uint64_t dist_index = 0;
+uint64_t dist_count = 1;
+
+static const uint32_t kDistVersion = 1;
+// a frame larger than this is a broken peer, not a snapshot.
+static const uint32_t kMaxFrame = 64 << 20;
+static const int kConnectRetries = 30;
+
+enum DistMessage {
+  DIST_HELLO = 1, // worker: version
+  DIST_CONFIG,    // coordinator: index, count, command line
+  DIST_READY,     // worker: prepared
+  DIST_START,     // coordinator: start time, unix us
+  DIST_SNAPSHOT,  // worker: snapshot of one interval
+  DIST_DONE,      // worker: final snapshot
+  DIST_STOP,      // coordinator: stop early
+};
+
+static uint64_t wall_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// little endian whatever the host is, workers may run on other machines.
+class WireWriter {
+public:
+  void u32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+      m_buf_.push_back((char)(v >> (8 * i)));
+    }
+  }
+  void u64(uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+      m_buf_.push_back((char)(v >> (8 * i)));
+    }
+  }
+  void str(const std::string &s) {
+    u32(s.size());
+    m_buf_ += s;
+  }
+  const std::string &data() const { return m_buf_; }
+
+private:
+  std::string m_buf_;
+};
+
+class WireReader {
+public:
+  explicit WireReader(const std::string &buf) : m_buf_(buf) {}
+
+  bool u32(uint32_t &v) {
+    uint64_t wide = 0;
+    if (!fixed(4, wide)) {
+      return false;
+    }
+    v = (uint32_t)wide;
+    return true;
+  }
+  bool u64(uint64_t &v) { return fixed(8, v); }
+  bool str(std::string &s) {
+    uint32_t len = 0;
+    if (!u32(len) || m_buf_.size() - m_pos_ < len) {
+      return false;
+    }
+    s.assign(m_buf_, m_pos_, len);
+    m_pos_ += len;
+    return true;
+  }
+
+private:
+  bool fixed(size_t bytes, uint64_t &v) {
+    if (m_buf_.size() - m_pos_ < bytes) {
+      return false;
+    }
+    v = 0;
+    for (size_t i = 0; i < bytes; i++) {
+      v |= (uint64_t)(uint8_t)m_buf_[m_pos_ + i] << (8 * i);
+    }
+    m_pos_ += bytes;
+    return true;
+  }
+
+  const std::string &m_buf_;
+  size_t m_pos_{0};
+};
+
+// histograms travel as their non empty buckets.
+static void put_snapshot(WireWriter &out, const DistSnapshot &snap) {
+  out.u64(snap.seq);
+  out.u32(snap.counters.size());
+  for (auto &counter : snap.counters) {
+    out.str(counter.first);
+    out.u64(counter.second);
+  }
+  out.u32(snap.hists.size());
+  for (auto &named : snap.hists) {
+    const Histogram &hist = named.second;
+    uint32_t used = 0;
+    for (size_t i = 0; i < kHistBuckets; i++) {
+      used += hist.m_buckets_[i] != 0 ? 1 : 0;
+    }
+    out.str(named.first);
+    out.u64(hist.m_sum_);
+    out.u64(hist.m_max_);
+    out.u32(used);
+    for (size_t i = 0; i < kHistBuckets; i++) {
+      if (hist.m_buckets_[i] != 0) {
+        out.u32(i);
+        out.u64(hist.m_buckets_[i]);
+      }
+    }
+  }
+}
+
+static bool get_snapshot(WireReader &in, DistSnapshot &snap) {
+  uint32_t counters = 0;
+  uint32_t hists = 0;
+  if (!in.u64(snap.seq) || !in.u32(counters)) {
+    return false;
+  }
+  snap.counters.assign(counters, {});
+  for (auto &counter : snap.counters) {
+    if (!in.str(counter.first) || !in.u64(counter.second)) {
+      return false;
+    }
+  }
+  if (!in.u32(hists)) {
+    return false;
+  }
+  snap.hists.assign(hists, {});
+  for (auto &named : snap.hists) {
+    Histogram &hist = named.second;
+    uint32_t used = 0;
+    if (!in.str(named.first) || !in.u64(hist.m_sum_) ||
+        !in.u64(hist.m_max_) || !in.u32(used)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < used; i++) {
+      uint32_t index = 0;
+      uint64_t count = 0;
+      if (!in.u32(index) || !in.u64(count) || index >= kHistBuckets) {
+        return false;
+      }
+      hist.m_buckets_[index] = count;
+      hist.m_count_ += count;
+    }
+  }
+  return true;
+}
+
+// one socket carrying frames of u32 length, u32 type and the payload.
+class DistConn {
+public:
+  explicit DistConn(int fd) : m_fd_(fd) {}
+  ~DistConn() { close(m_fd_); }
+
+  int fd() const { return m_fd_; }
+  // the peer closed the connection or it broke.
+  bool closed() const { return m_closed_; }
+
+  bool send(uint32_t type, const std::string &payload) {
+    WireWriter header;
+    header.u32(payload.size() + 4);
+    header.u32(type);
+    std::string frame = header.data() + payload;
+    size_t sent = 0;
+    while (sent < frame.size()) {
+      ssize_t n = ::send(m_fd_, frame.data() + sent, frame.size() - sent,
+                         MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      sent += n;
+    }
+    return true;
+  }
+
+  // reads what the socket has, false on eof or error.
+  bool fill() {
+    char buf[65536];
+    ssize_t n = 0;
+    do {
+      n = recv(m_fd_, buf, sizeof(buf), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+      m_closed_ = true;
+      return false;
+    }
+    m_in_.append(buf, n);
+    return true;
+  }
+
+  // takes one whole frame out of what was read. A broken frame drops the
+  // rest of the stream.
+  bool next(uint32_t &type, std::string &payload) {
+    WireReader header(m_in_);
+    uint32_t len = 0;
+    if (!header.u32(len)) {
+      return false;
+    }
+    if (len < 4 || len > kMaxFrame) {
+      m_in_.clear();
+      return false;
+    }
+    if (m_in_.size() < 4 + (size_t)len) {
+      return false;
+    }
+    header.u32(type);
+    payload.assign(m_in_, 8, len - 4);
+    m_in_.erase(0, 4 + len);
+    return true;
+  }
+
+  // blocks until a frame arrives, false on eof or after timeout_ms (-1
+  // waits for ever).
+  bool recv_frame(uint32_t &type, std::string &payload, int timeout_ms) {
+    uint64_t deadline_us = wall_us() + (uint64_t)timeout_ms * 1000;
+    while (!next(type, payload)) {
+      int wait_ms = 100;
+      if (timeout_ms >= 0) {
+        uint64_t now = wall_us();
+        if (now >= deadline_us) {
+          return false;
+        }
+        wait_ms = std::min<uint64_t>(wait_ms, (deadline_us - now) / 1000 + 1);
+      }
+      struct pollfd p = {m_fd_, POLLIN, 0};
+      int res = poll(&p, 1, wait_ms);
+      if (res < 0 && errno != EINTR) {
+        m_closed_ = true;
+        return false;
+      }
+      if (res > 0 && !fill()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  DistConn(const DistConn &) = delete;
+  void operator=(const DistConn &) = delete;
+
+  int m_fd_;
+  std::string m_in_;
+  bool m_closed_{false};
+};
+
+/*
+  "host:port" is TCP, an address with a '/' a unix socket path. The
+  coordinator listens on it, a worker connects to it.
+*/
+static int dist_socket(const char *addr, bool listening) {
+  std::string address(addr);
+  if (address.find('/') != std::string::npos) {
+    struct sockaddr_un sun;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    if (address.size() >= sizeof(sun.sun_path)) {
+      std::cerr << "unix socket path too long: " << address << std::endl;
+      return -1;
+    }
+    strcpy(sun.sun_path, address.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return -1;
+    }
+    if (listening) {
+      unlink(sun.sun_path);
+    }
+    int res = listening ? bind(fd, (struct sockaddr *)&sun, sizeof(sun))
+                        : connect(fd, (struct sockaddr *)&sun, sizeof(sun));
+    if (res != 0 || (listening && listen(fd, 128) != 0)) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    std::cerr << "invalid address, expected host:port or a socket path: "
+              << address << std::endl;
+    return -1;
+  }
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = listening ? AI_PASSIVE : 0;
+  struct addrinfo *res = nullptr;
+  if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                  &hints, &res) != 0) {
+    std::cerr << "Failed to resolve " << address << std::endl;
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    int one = 1;
+    if (listening) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 128) == 0) {
+        break;
+      }
+    } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// worker side.
+static DistConn *coordinator = nullptr;
+static std::atomic<uint64_t> start_unix_us{0};
+static std::function<void(DistSnapshot &)> take_snapshot;
+static std::thread *reporter = nullptr;
+static std::atomic_bool reporter_done{false};
+static uint64_t next_seq = 1;
+
+bool dist_join() {
+  int fd = -1;
+  // the coordinator may not listen yet.
+  for (int i = 0; i < kConnectRetries && fd < 0; i++) {
+    if (i != 0) {
+      sleep(1);
+    }
+    fd = dist_socket(dist_connect, false);
+  }
+  if (fd < 0) {
+    std::cerr << "Failed to connect to the coordinator " << dist_connect
+              << ", errno: " << errno << std::endl;
+    return false;
+  }
+  coordinator = new DistConn(fd);
+
+  WireWriter hello;
+  hello.u32(kDistVersion);
+  uint32_t type = 0;
+  std::string payload;
+  if (!coordinator->send(DIST_HELLO, hello.data()) ||
+      !coordinator->recv_frame(type, payload, -1) || type != DIST_CONFIG) {
+    std::cerr << "Coordinator " << dist_connect << " did not accept this worker."
+              << std::endl;
+    return false;
+  }
+  WireReader in(payload);
+  uint32_t argc = 0;
+  if (!in.u64(dist_index) || !in.u64(dist_count) || !in.u32(argc)) {
+    std::cerr << "Bad config from the coordinator." << std::endl;
+    return false;
+  }
+  std::vector<std::string> args(argc);
+  std::vector<char *> argv;
+  for (auto &arg : args) {
+    if (!in.str(arg)) {
+      std::cerr << "Bad config from the coordinator." << std::endl;
+      return false;
+    }
+    argv.push_back(&arg[0]);
+  }
+  argv.push_back(nullptr);
+  std::cout << "Joined coordinator " << dist_connect << " as worker "
+            << dist_index << " of " << dist_count << "." << std::endl;
+
+  // the options of the coordinator are parsed on top of the local ones.
+  optind = 0;
+  return parse_option(argc, argv.data());
+}
+
+void dist_wait_start() {
+  uint32_t type = 0;
+  std::string payload;
+  if (!coordinator->send(DIST_READY, "")) {
+    stop_requested = true;
+    return;
+  }
+  while (!stop_requested) {
+    if (!coordinator->recv_frame(type, payload, 100)) {
+      if (coordinator->closed()) {
+        std::cerr << "Lost the coordinator, stopping." << std::endl;
+        stop_requested = true;
+      }
+      continue;
+    }
+    uint64_t start = 0;
+    WireReader in(payload);
+    if (type == DIST_START && in.u64(start)) {
+      uint64_t now = wall_us();
+      if (start > now) {
+        std::this_thread::sleep_for(std::chrono::microseconds(start - now));
+      }
+      start_unix_us = start;
+      return;
+    }
+    if (type == DIST_STOP) {
+      stop_requested = true;
+    }
+  }
+}
+
+static void send_snapshot(uint32_t type) {
+  DistSnapshot snap;
+  take_snapshot(snap);
+  snap.seq = next_seq++;
+  WireWriter out;
+  put_snapshot(out, snap);
+  coordinator->send(type, out.data());
+}
+
+// sends the snapshots on the interval boundaries of the shared start time,
+// and stops the workers when the coordinator says so or goes away.
+static void report_loop() {
+  while (start_unix_us == 0 && !reporter_done) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  while (!reporter_done) {
+    uint64_t due = start_unix_us + next_seq * report_interval * 1000000;
+    uint64_t now = wall_us();
+    if (now >= due) {
+      send_snapshot(DIST_SNAPSHOT);
+      continue;
+    }
+    struct pollfd p = {coordinator->fd(), POLLIN, 0};
+    int wait_ms = std::min<uint64_t>(100, (due - now) / 1000 + 1);
+    if (poll(&p, 1, wait_ms) <= 0) {
+      continue;
+    }
+    uint32_t type = 0;
+    std::string payload;
+    if (!coordinator->fill()) {
+      std::cerr << "Lost the coordinator, stopping." << std::endl;
+      stop_requested = true;
+      return;
+    }
+    while (coordinator->next(type, payload)) {
+      if (type == DIST_STOP) {
+        stop_requested = true;
+      }
+    }
+  }
+}
+
+void dist_start_reporter(std::function<void(DistSnapshot &)> take) {
+  take_snapshot = take;
+  reporter = new std::thread(report_loop);
+}
+
+void dist_finish() {
+  if (coordinator == nullptr) {
+    return;
+  }
+  reporter_done = true;
+  if (reporter != nullptr) {
+    reporter->join();
+    delete reporter;
+    reporter = nullptr;
+  }
+  if (take_snapshot) {
+    send_snapshot(DIST_DONE);
+  }
+  delete coordinator;
+  coordinator = nullptr;
+}
+
+// coordinator side.
+struct DistWorker {
+  DistConn *conn;
+  bool ready{false};
+  bool done{false};
+  // received and not printed yet, by seq.
+  std::map<uint64_t, DistSnapshot> pending;
+  // the last printed one, and the final one once done.
+  DistSnapshot last;
+  DistSnapshot final;
+};
+
+// options only the coordinator uses: the workers would all write the same
+// --output-file, the coordinator writes the merged report to it.
+static bool coordinator_option(const std::string &arg) {
+  static const char *const options[] = {"--output-file", "--output-format"};
+  if (arg.compare(0, 7, "--dist-") == 0) {
+    return true;
+  }
+  for (const char *option : options) {
+    size_t len = strlen(option);
+    if (arg.compare(0, len, option) == 0 &&
+        (arg.size() == len || arg[len] == '=')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// the command line of the workers, without the coordinator options.
+static std::vector<std::string> worker_args(int argc, char *argv[]) {
+  std::vector<std::string> args;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (coordinator_option(arg)) {
+      if (arg.find('=') == std::string::npos) {
+        i++;
+      }
+      continue;
+    }
+    args.push_back(arg);
+  }
+  return args;
+}
+
+static void merge_snapshot(DistSnapshot &sum, const DistSnapshot &one) {
+  for (auto &counter : one.counters) {
+    auto it = sum.counters.begin();
+    while (it != sum.counters.end() && it->first != counter.first) {
+      it++;
+    }
+    if (it == sum.counters.end()) {
+      sum.counters.push_back(counter);
+    } else {
+      it->second += counter.second;
+    }
+  }
+  for (auto &named : one.hists) {
+    auto it = sum.hists.begin();
+    while (it != sum.hists.end() && it->first != named.first) {
+      it++;
+    }
+    if (it == sum.hists.end()) {
+      sum.hists.push_back(named);
+    } else {
+      it->second.merge(named.second);
+    }
+  }
+}
+
+static uint64_t find_counter(const DistSnapshot &snap, const std::string &name) {
+  for (auto &counter : snap.counters) {
+    if (counter.first == name) {
+      return counter.second;
+    }
+  }
+  return 0;
+}
+
+static void print_interval(uint64_t seq, const DistSnapshot &cur,
+                           const DistSnapshot &pre, size_t workers) {
+  ReportRecord *record =
+      report_enabled() ? new ReportRecord("cluster_interval") : nullptr;
+  std::cout << "Cluster interval " << seq << ", workers: " << workers;
+  if (record) {
+    record->add("interval", seq).add("workers", (uint64_t)workers);
+  }
+  for (auto &counter : cur.counters) {
+    uint64_t rate = (counter.second - find_counter(pre, counter.first)) /
+                    report_interval;
+    std::cout << ", " << counter.first << "/s: " << rate;
+    if (record) {
+      record->add(counter.first, rate);
+    }
+  }
+  for (auto &named : cur.hists) {
+    Histogram hist = named.second;
+    for (auto &old : pre.hists) {
+      if (old.first == named.first) {
+        hist.subtract(old.second);
+      }
+    }
+    std::cout << ", " << named.first << "(us): [" << hist.percentile_summary()
+              << "]";
+    if (record) {
+      record->add_latency(named.first, hist);
+    }
+  }
+  std::cout << std::endl;
+  if (record) {
+    report_emit(record);
+  }
+}
+
+static void print_summary(const DistSnapshot &sum, size_t workers) {
+  ReportRecord *record =
+      report_enabled() ? new ReportRecord("cluster_summary") : nullptr;
+  std::cout << "Cluster summary, workers: " << workers;
+  if (record) {
+    record->add("workers", (uint64_t)workers);
+  }
+  for (auto &counter : sum.counters) {
+    std::cout << ", " << counter.first << ": " << counter.second;
+    if (record) {
+      record->add(counter.first, counter.second);
+    }
+  }
+  std::cout << std::endl;
+  for (auto &named : sum.hists) {
+    std::cout << "Cluster " << named.first
+              << "(us): " << named.second.percentile_summary()
+              << ", avg: " << named.second.get_mean() << std::endl;
+    if (record) {
+      record->add_latency(named.first, named.second);
+    }
+  }
+  if (record) {
+    report_emit(record);
+  }
+}
+
+static void broadcast(std::vector<DistWorker> &workers, uint32_t type,
+                      const std::string &payload) {
+  for (auto &worker : workers) {
+    if (!worker.done) {
+      worker.conn->send(type, payload);
+    }
+  }
+}
+
+// a worker that went away counts with what it sent last.
+static void lose_worker(DistWorker &worker, size_t index) {
+  std::cerr << "Lost worker " << index << "." << std::endl;
+  worker.final = worker.pending.empty() ? worker.last
+                                        : worker.pending.rbegin()->second;
+  worker.done = true;
+}
+
+// prints every interval all workers have reported, or finished before.
+static void print_ready_intervals(std::vector<DistWorker> &workers,
+                                  uint64_t &seq, DistSnapshot &pre) {
+  while (true) {
+    bool any = false;
+    for (auto &worker : workers) {
+      bool has = worker.pending.count(seq) != 0;
+      if (!has && !worker.done) {
+        return;
+      }
+      any = any || has;
+    }
+    if (!any) {
+      return;
+    }
+    DistSnapshot sum;
+    size_t reported = 0;
+    for (auto &worker : workers) {
+      auto it = worker.pending.find(seq);
+      if (it != worker.pending.end()) {
+        worker.last = it->second;
+        worker.pending.erase(it);
+        merge_snapshot(sum, worker.last);
+        reported++;
+      } else {
+        merge_snapshot(sum, worker.final);
+      }
+    }
+    print_interval(seq, sum, pre, reported);
+    pre = sum;
+    seq++;
+  }
+}
+
+int main_coordinator(int argc, char *argv[]) {
+  int listen_fd = dist_socket(dist_listen, true);
+  if (listen_fd < 0) {
+    std::cerr << "Failed to listen on " << dist_listen << ", errno: " << errno
+              << std::endl;
+    return -1;
+  }
+  std::vector<std::string> args = worker_args(argc, argv);
+  std::vector<DistWorker> workers;
+  std::cout << "Coordinator listening on " << dist_listen << ", waiting for "
+            << dist_workers << " workers." << std::endl;
+  while (workers.size() < dist_workers && !stop_requested) {
+    struct pollfd p = {listen_fd, POLLIN, 0};
+    if (poll(&p, 1, 100) <= 0) {
+      continue;
+    }
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    DistConn *conn = new DistConn(fd);
+    uint32_t type = 0;
+    uint32_t version = 0;
+    std::string payload;
+    if (!conn->recv_frame(type, payload, 5000) || type != DIST_HELLO ||
+        !WireReader(payload).u32(version) || version != kDistVersion) {
+      std::cerr << "Rejected a worker with a bad hello." << std::endl;
+      delete conn;
+      continue;
+    }
+    WireWriter config;
+    config.u64(workers.size());
+    config.u64(dist_workers);
+    config.u32(args.size());
+    for (auto &arg : args) {
+      config.str(arg);
+    }
+    if (!conn->send(DIST_CONFIG, config.data())) {
+      delete conn;
+      continue;
+    }
+    std::cout << "Worker " << workers.size() << " joined." << std::endl;
+    workers.push_back(DistWorker());
+    workers.back().conn = conn;
+  }
+  close(listen_fd);
+
+  bool started = false;
+  bool stop_sent = false;
+  uint64_t seq = 1;
+  DistSnapshot pre;
+  while (true) {
+    std::vector<struct pollfd> fds;
+    std::vector<size_t> owners;
+    for (size_t i = 0; i < workers.size(); i++) {
+      if (!workers[i].done) {
+        fds.push_back({workers[i].conn->fd(), POLLIN, 0});
+        owners.push_back(i);
+      }
+    }
+    if (fds.empty()) {
+      break;
+    }
+    if (stop_requested && !stop_sent) {
+      broadcast(workers, DIST_STOP, "");
+      stop_sent = true;
+    }
+    if (poll(fds.data(), fds.size(), 100) <= 0) {
+      continue;
+    }
+
+    for (size_t f = 0; f < fds.size(); f++) {
+      if (fds[f].revents == 0) {
+        continue;
+      }
+      DistWorker &worker = workers[owners[f]];
+      if (!worker.conn->fill()) {
+        lose_worker(worker, owners[f]);
+        continue;
+      }
+      uint32_t type = 0;
+      std::string payload;
+      while (!worker.done && worker.conn->next(type, payload)) {
+        WireReader in(payload);
+        DistSnapshot snap;
+        if (type == DIST_READY) {
+          worker.ready = true;
+        } else if (type == DIST_SNAPSHOT && get_snapshot(in, snap)) {
+          worker.pending[snap.seq] = snap;
+        } else if (type == DIST_DONE && get_snapshot(in, snap)) {
+          // the intervals it reported before still print.
+          worker.final = snap;
+          worker.done = true;
+        }
+      }
+    }
+
+    if (!started) {
+      bool all_ready = true;
+      for (auto &worker : workers) {
+        all_ready = all_ready && (worker.ready || worker.done);
+      }
+      if (all_ready) {
+        // a second for the start time to reach every worker.
+        uint64_t start = wall_us() + 1000000;
+        WireWriter out;
+        out.u64(start);
+        broadcast(workers, DIST_START, out.data());
+        started = true;
+        std::cout << "All workers prepared, starting." << std::endl;
+      }
+    }
+    print_ready_intervals(workers, seq, pre);
+  }
+
+  DistSnapshot sum;
+  for (auto &worker : workers) {
+    merge_snapshot(sum, worker.final);
+    delete worker.conn;
+  }
+  print_summary(sum, workers.size());
+  return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : dist.h
+ * @Description  : multi-process runs of the sct mode. A coordinator
+ *                 (--dist-listen) waits for --dist-workers processes
+ *                 (--dist-connect) and hands every one its command line and
+ *                 its index. Once all of them prepared their data, it sends
+ *                 a shared start time. The workers send cumulative snapshots
+ *                 of their counters and histograms every --report-interval,
+ *                 aligned to the start time, and the coordinator prints and
+ *                 exports the cluster wide intervals and summary.
+ */
+
+#ifndef DIST_H
+#define DIST_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+
+// this process of a distributed run, 0 of 1 without --dist-connect.
+extern uint64_t dist_index;
+extern uint64_t dist_count;
+
+// cumulative counters and histograms of one process, by name.
+struct DistSnapshot {
+  uint64_t seq{0};
+  std::vector<std::pair<std::string, uint64_t>> counters;
+  std::vector<std::pair<std::string, Histogram>> hists;
+};
+
+// worker: connects to --dist-connect, takes the index and the command line
+// of the coordinator and parses it. false when that fails.
+bool dist_join();
+// worker: tells the coordinator this process is prepared and sleeps until
+// the shared start time.
+void dist_wait_start();
+// worker: sends what take fills every --report-interval after the start.
+void dist_start_reporter(std::function<void(DistSnapshot &)> take);
+// worker: sends the final snapshot and disconnects.
+void dist_finish();
+
+int main_coordinator(int argc, char *argv[]);
+
+#endif // DIST_H
@@ -0,0 +1,170 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : histogram.cc
+ * @Description  : log-bucketed latency histograms.
+ */
+
+#include "histogram.h"
+
+#include <cstring>
+#include <sstream>
+
+size_t Histogram::bucket_index(uint64_t value) {
+  if (value < kHistSubCount) {
+    return value;
+  }
+  if (value >= (1ULL << kHistMaxBits)) {
+    value = (1ULL << kHistMaxBits) - 1;
+  }
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - kHistSubBits + 1;
+  // value >> shift is in [kHistSubHalf, kHistSubCount)
+  return shift * kHistSubHalf + (value >> shift);
+}
+
+uint64_t Histogram::bucket_high(size_t index) {
+  if (index < kHistSubCount) {
+    return index;
+  }
+  uint64_t shift = index / kHistSubHalf - 1;
+  uint64_t sub = index - shift * kHistSubHalf;
+  return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+  m_buckets_[bucket_index(value)]++;
+  m_count_++;
+  m_sum_ += value;
+  if (value > m_max_) {
+    m_max_ = value;
+  }
+}
+
+void Histogram::merge(const Histogram &other) {
+  for (size_t i = 0; i < kHistBuckets; i++) {
+    m_buckets_[i] += other.m_buckets_[i];
+  }
+  m_count_ += other.m_count_;
+  m_sum_ += other.m_sum_;
+  if (other.m_max_ > m_max_) {
+    m_max_ = other.m_max_;
+  }
+}
+
+void Histogram::subtract(const Histogram &other) {
+  uint64_t max_idx = 0;
+  for (size_t i = 0; i < kHistBuckets; i++) {
+    m_buckets_[i] -= other.m_buckets_[i];
+    if (m_buckets_[i] != 0) {
+      max_idx = i;
+    }
+  }
+  m_count_ -= other.m_count_;
+  m_sum_ -= other.m_sum_;
+  // the exact max of an interval is unknown, use the highest bucket seen.
+  uint64_t high = m_count_ ? bucket_high(max_idx) : 0;
+  if (high < m_max_) {
+    m_max_ = high;
+  }
+}
+
+void Histogram::clear() {
+  memset(m_buckets_, 0, sizeof(m_buckets_));
+  m_count_ = 0;
+  m_sum_ = 0;
+  m_max_ = 0;
+}
+
+uint64_t Histogram::percentile(double p) const {
+  if (m_count_ == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(p / 100.0 * m_count_ + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kHistBuckets; i++) {
+    seen += m_buckets_[i];
+    if (seen >= rank) {
+      uint64_t high = bucket_high(i);
+      return high < m_max_ ? high : m_max_;
+    }
+  }
+  return m_max_;
+}
+
+std::string Histogram::percentile_summary() const {
+  std::ostringstream os;
+  os << "p50: " << percentile(50) << ", p90: " << percentile(90)
+     << ", p99: " << percentile(99) << ", p99.9: " << percentile(99.9)
+     << ", max: " << m_max_;
+  return os.str();
+}
+
+void ConcurrentHistogram::snapshot_into(Histogram &hist) const {
+  // count is derived from the buckets so a snapshot taken while the writer
+  // is recording stays self consistent.
+  hist.m_count_ = 0;
+  for (size_t i = 0; i < kHistBuckets; i++) {
+    hist.m_buckets_[i] = m_buckets_[i].load(std::memory_order_relaxed);
+    hist.m_count_ += hist.m_buckets_[i];
+  }
+  hist.m_sum_ = m_sum_.load(std::memory_order_relaxed);
+  hist.m_max_ = m_max_.load(std::memory_order_relaxed);
+}
+
+LatencyStats::~LatencyStats() { clear(); }
+
+void LatencyStats::clear() {
+  for (size_t i = 0; i < m_threads_; i++) {
+    delete m_per_thread_[i].load();
+  }
+  m_per_thread_.reset();
+  m_threads_ = 0;
+}
+
+void LatencyStats::init(size_t threads) {
+  clear();
+  m_per_thread_.reset(new std::atomic<ConcurrentHistogram *>[threads]);
+  for (size_t i = 0; i < threads; i++) {
+    m_per_thread_[i].store(nullptr);
+  }
+  m_threads_ = threads;
+}
+
+// a slot has one writer, the thread or event loop of thread_id, since
+// ConcurrentHistogram::record is not safe for two. The compare and swap only
+// keeps a slot from being created twice, it does not make that safe.
+ConcurrentHistogram *LatencyStats::create(size_t thread_id) {
+  ConcurrentHistogram *hist = new ConcurrentHistogram();
+  ConcurrentHistogram *expected = nullptr;
+  if (!m_per_thread_[thread_id].compare_exchange_strong(
+          expected, hist, std::memory_order_acq_rel,
+          std::memory_order_acquire)) {
+    delete hist;
+    return expected;
+  }
+  return hist;
+}
+
+void LatencyStats::snapshot(Histogram &hist) const {
+  Histogram one;
+  hist.clear();
+  for (size_t i = 0; i < m_threads_; i++) {
+    ConcurrentHistogram *thread_hist =
+        m_per_thread_[i].load(std::memory_order_acquire);
+    if (thread_hist != nullptr) {
+      thread_hist->snapshot_into(one);
+      hist.merge(one);
+    }
+  }
+}
+
+const Histogram &IntervalHistogram::next() {
+  m_stats_.snapshot(m_cur_);
+  m_interval_ = m_cur_;
+  m_interval_.subtract(m_pre_);
+  m_pre_ = m_cur_;
+  return m_interval_;
+}
@@ -0,0 +1,146 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : histogram.h
+ * @Description  : log-bucketed latency histograms (HDR style). Every worker
+ *                 thread records into its own histogram, the reporter merges
+ *                 them, so recording never waits on other threads.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 32 sub buckets per power of two, buckets are at most ~6% wide. Values up
+// to 2^40 (us, ~12 days) are tracked, larger ones land in the last bucket.
+static const int kHistSubBits = 5;
+static const uint64_t kHistSubCount = 1ULL << kHistSubBits;
+static const uint64_t kHistSubHalf = kHistSubCount / 2;
+static const int kHistMaxBits = 40;
+static const size_t kHistBuckets =
+    (kHistMaxBits - kHistSubBits) * kHistSubHalf + kHistSubCount;
+
+inline uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Plain histogram, used for snapshots and merged results.
+class Histogram {
+public:
+  Histogram() { clear(); }
+
+  void record(uint64_t value);
+  void merge(const Histogram &other);
+  // this = this - other, other must be an older snapshot of the same source.
+  void subtract(const Histogram &other);
+  void clear();
+
+  uint64_t get_count() const { return m_count_; }
+  uint64_t get_max() const { return m_max_; }
+  uint64_t get_mean() const { return m_count_ ? m_sum_ / m_count_ : 0; }
+  // p in [0, 100]
+  uint64_t percentile(double p) const;
+
+  // "p50: x, p90: x, p99: x, p99.9: x, max: x"
+  std::string percentile_summary() const;
+
+  static size_t bucket_index(uint64_t value);
+  static uint64_t bucket_high(size_t index);
+
+  uint64_t m_buckets_[kHistBuckets];
+  uint64_t m_count_;
+  uint64_t m_sum_;
+  uint64_t m_max_;
+};
+
+// Histogram with a single writer and any number of readers. The writer uses
+// relaxed load/store pairs instead of read-modify-write, readers may observe
+// a recording half way, which only skews one interval by one sample.
+class ConcurrentHistogram {
+public:
+  ConcurrentHistogram() {
+    for (size_t i = 0; i < kHistBuckets; i++) {
+      m_buckets_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void record(uint64_t value) {
+    size_t idx = Histogram::bucket_index(value);
+    bump(m_buckets_[idx], 1);
+    bump(m_sum_, value);
+    if (value > m_max_.load(std::memory_order_relaxed)) {
+      m_max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  void snapshot_into(Histogram &hist) const;
+
+private:
+  static void bump(std::atomic<uint64_t> &v, uint64_t delta) {
+    v.store(v.load(std::memory_order_relaxed) + delta,
+            std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> m_buckets_[kHistBuckets];
+  std::atomic<uint64_t> m_sum_{0};
+  std::atomic<uint64_t> m_max_{0};
+};
+
+// One histogram per worker thread, merged on demand by the reporter. A
+// thread allocates its histogram on its first record, so with pinned workers
+// the memory is local to the numa node the thread runs on. Only one thread
+// (or event loop) may record into a thread_id.
+class LatencyStats {
+public:
+  LatencyStats() {}
+  ~LatencyStats();
+
+  void init(size_t threads);
+  void record(size_t thread_id, uint64_t us) {
+    ConcurrentHistogram *hist =
+        m_per_thread_[thread_id].load(std::memory_order_acquire);
+    if (hist == nullptr) {
+      hist = create(thread_id);
+    }
+    hist->record(us);
+  }
+  // merge all thread histograms recorded so far.
+  void snapshot(Histogram &hist) const;
+
+private:
+  LatencyStats(const LatencyStats &) = delete;
+  void operator=(const LatencyStats &) = delete;
+
+  ConcurrentHistogram *create(size_t thread_id);
+  void clear();
+
+  std::unique_ptr<std::atomic<ConcurrentHistogram *>[]> m_per_thread_;
+  size_t m_threads_{0};
+};
+
+// Tracks a cumulative snapshot so the reporter can produce per interval
+// histograms by difference.
+class IntervalHistogram {
+public:
+  explicit IntervalHistogram(const LatencyStats &stats) : m_stats_(stats) {}
+
+  // returns the samples recorded since the last call.
+  const Histogram &next();
+  // all samples recorded so far.
+  const Histogram &total() const { return m_pre_; }
+
+private:
+  const LatencyStats &m_stats_;
+  Histogram m_pre_;
+  Histogram m_cur_;
+  Histogram m_interval_;
+};
+
+#endif // HISTOGRAM_H
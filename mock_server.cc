@@ -0,0 +1,1215 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : mock_server.cc
+ * @Description  : mysqlsct_mock_server, a stand-in for a mysql cluster that
+ *                 speaks enough of the client protocol for mysqlsct: the
+ *                 handshake, COM_QUERY with text resultsets and LOAD DATA
+ *                 LOCAL, COM_STMT_* with binary resultsets, and the gtid of
+ *                 a write in the OK packet. It serves the sct schema from
+ *                 memory on an RW port and one RO port per replica, the
+ *                 replicas apply the writes after the --lag-us delay.
+ */
+
+#include "mock_store.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+static const char *MOCK_VERSION = "8.0.34-mysqlsct-mock";
+static const char *MOCK_UUID = "3e11fa47-71ca-11e1-9e33-c80aa9429562";
+static const char *NATIVE_PASSWORD = "mysql_native_password";
+
+enum : uint32_t {
+  CLIENT_LONG_PASSWORD = 1,
+  CLIENT_FOUND_ROWS = 2,
+  CLIENT_LONG_FLAG = 4,
+  CLIENT_CONNECT_WITH_DB = 8,
+  CLIENT_LOCAL_FILES = 0x80,
+  CLIENT_PROTOCOL_41 = 0x200,
+  CLIENT_TRANSACTIONS = 0x2000,
+  CLIENT_SECURE_CONNECTION = 0x8000,
+  CLIENT_MULTI_RESULTS = 0x20000,
+  CLIENT_PS_MULTI_RESULTS = 0x40000,
+  CLIENT_PLUGIN_AUTH = 0x80000,
+  CLIENT_CONNECT_ATTRS = 0x100000,
+  CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA = 0x200000,
+  CLIENT_SESSION_TRACK = 0x800000,
+};
+
+static const uint32_t SERVER_CAPABILITIES =
+    CLIENT_LONG_PASSWORD | CLIENT_FOUND_ROWS | CLIENT_LONG_FLAG |
+    CLIENT_CONNECT_WITH_DB | CLIENT_LOCAL_FILES | CLIENT_PROTOCOL_41 |
+    CLIENT_TRANSACTIONS | CLIENT_SECURE_CONNECTION | CLIENT_MULTI_RESULTS |
+    CLIENT_PS_MULTI_RESULTS | CLIENT_PLUGIN_AUTH | CLIENT_CONNECT_ATTRS |
+    CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA | CLIENT_SESSION_TRACK;
+
+static const uint16_t SERVER_STATUS_AUTOCOMMIT = 0x2;
+static const uint16_t SERVER_SESSION_STATE_CHANGED = 0x4000;
+static const uint8_t SESSION_TRACK_SYSTEM_VARIABLES = 0;
+static const uint8_t SESSION_TRACK_GTIDS = 3;
+static const uint8_t MYSQL_TYPE_LONGLONG = 8;
+
+enum {
+  COM_QUIT = 0x01,
+  COM_INIT_DB = 0x02,
+  COM_QUERY = 0x03,
+  COM_PING = 0x0e,
+  COM_STMT_PREPARE = 0x16,
+  COM_STMT_EXECUTE = 0x17,
+  COM_STMT_SEND_LONG_DATA = 0x18,
+  COM_STMT_CLOSE = 0x19,
+  COM_STMT_RESET = 0x1a,
+  COM_SET_OPTION = 0x1b,
+  COM_RESET_CONNECTION = 0x1f,
+};
+
+static const char *bind_address = "127.0.0.1";
+static uint64_t rw_port = 3306;
+static uint64_t ro_port = 3307;
+static uint64_t replicas = 1;
+static uint64_t lag_us = 0;
+static LagDist lag_dist = LAG_FIXED;
+static uint64_t report_interval = 0;
+
+static MockCluster *cluster = nullptr;
+static std::atomic<uint64_t> commands{0};
+static std::atomic<uint64_t> connections{0};
+static std::atomic<uint32_t> next_connection_id{1};
+
+static void put_int(std::string &p, uint64_t v, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) {
+    p.push_back((char)(v >> (8 * i)));
+  }
+}
+
+static void put_lenenc(std::string &p, uint64_t v) {
+  if (v < 251) {
+    put_int(p, v, 1);
+  } else if (v < (1 << 16)) {
+    p.push_back((char)0xfc);
+    put_int(p, v, 2);
+  } else if (v < (1 << 24)) {
+    p.push_back((char)0xfd);
+    put_int(p, v, 3);
+  } else {
+    p.push_back((char)0xfe);
+    put_int(p, v, 8);
+  }
+}
+
+static void put_lenenc_str(std::string &p, const std::string &s) {
+  put_lenenc(p, s.size());
+  p += s;
+}
+
+static uint64_t get_int(const std::string &p, size_t &pos, size_t bytes) {
+  uint64_t v = 0;
+  for (size_t i = 0; i < bytes && pos < p.size(); i++) {
+    v |= (uint64_t)(uint8_t)p[pos++] << (8 * i);
+  }
+  return v;
+}
+
+static uint64_t get_lenenc(const std::string &p, size_t &pos) {
+  if (pos >= p.size()) {
+    return 0;
+  }
+  uint8_t first = p[pos++];
+  switch (first) {
+  case 0xfc:
+    return get_int(p, pos, 2);
+  case 0xfd:
+    return get_int(p, pos, 3);
+  case 0xfe:
+    return get_int(p, pos, 8);
+  default:
+    return first;
+  }
+}
+
+static std::string get_str_nul(const std::string &p, size_t &pos) {
+  size_t end = p.find('\0', pos);
+  if (end == std::string::npos) {
+    end = p.size();
+  }
+  std::string s = p.substr(pos, end - pos);
+  pos = std::min(end + 1, p.size());
+  return s;
+}
+
+/*
+  Just enough sql for the statements mysqlsct sends. Every method skips the
+  blanks before its token and consumes it only when it matches.
+*/
+class Lexer {
+public:
+  explicit Lexer(const std::string &sql) : m_sql_(sql) {}
+
+  bool word(const char *kw) {
+    skip();
+    size_t len = strlen(kw);
+    if (strncasecmp(m_sql_.c_str() + m_pos_, kw, len) != 0 ||
+        is_ident(m_pos_ + len)) {
+      return false;
+    }
+    m_pos_ += len;
+    return true;
+  }
+  // a table name, maybe `quoted` or db.table, without the db.
+  bool name(std::string &out) {
+    skip();
+    out.clear();
+    while (m_pos_ < m_sql_.size()) {
+      if (m_sql_[m_pos_] == '`') {
+        size_t end = m_sql_.find('`', m_pos_ + 1);
+        if (end == std::string::npos) {
+          return false;
+        }
+        out = m_sql_.substr(m_pos_ + 1, end - m_pos_ - 1);
+        m_pos_ = end + 1;
+      } else if (is_ident(m_pos_)) {
+        size_t start = m_pos_;
+        while (is_ident(m_pos_)) {
+          m_pos_++;
+        }
+        out = m_sql_.substr(start, m_pos_ - start);
+      } else {
+        return false;
+      }
+      if (m_pos_ >= m_sql_.size() || m_sql_[m_pos_] != '.') {
+        break;
+      }
+      m_pos_++;
+    }
+    return !out.empty();
+  }
+  bool number(uint64_t &out) {
+    skip();
+    if (m_pos_ < m_sql_.size() && m_sql_[m_pos_] == '\'') {
+      // a quoted number, as the string parameters of a statement come.
+      std::string s;
+      size_t start = m_pos_;
+      char *end = nullptr;
+      if (str(s) && !s.empty() &&
+          (out = strtoull(s.c_str(), &end, 10), *end == '\0')) {
+        return true;
+      }
+      m_pos_ = start;
+      return false;
+    }
+    if (m_pos_ >= m_sql_.size() || !isdigit(m_sql_[m_pos_])) {
+      return false;
+    }
+    char *end = nullptr;
+    out = strtoull(m_sql_.c_str() + m_pos_, &end, 10);
+    m_pos_ = end - m_sql_.c_str();
+    return true;
+  }
+  bool decimal(double &out) {
+    skip();
+    const char *start = m_sql_.c_str() + m_pos_;
+    char *end = nullptr;
+    out = strtod(start, &end);
+    m_pos_ += end - start;
+    return end != start;
+  }
+  bool str(std::string &out) {
+    skip();
+    if (m_pos_ >= m_sql_.size() || m_sql_[m_pos_] != '\'') {
+      return false;
+    }
+    out.clear();
+    for (size_t i = m_pos_ + 1; i < m_sql_.size(); i++) {
+      if (m_sql_[i] == '\\' && i + 1 < m_sql_.size()) {
+        out.push_back(m_sql_[++i]);
+      } else if (m_sql_[i] == '\'') {
+        m_pos_ = i + 1;
+        return true;
+      } else {
+        out.push_back(m_sql_[i]);
+      }
+    }
+    return false;
+  }
+  bool punct(char c) {
+    skip();
+    if (m_pos_ < m_sql_.size() && m_sql_[m_pos_] == c) {
+      m_pos_++;
+      return true;
+    }
+    return false;
+  }
+
+private:
+  void skip() {
+    while (m_pos_ < m_sql_.size() && isspace(m_sql_[m_pos_])) {
+      m_pos_++;
+    }
+  }
+  bool is_ident(size_t pos) {
+    return pos < m_sql_.size() &&
+           (isalnum(m_sql_[pos]) || m_sql_[pos] == '_' || m_sql_[pos] == '$');
+  }
+
+  const std::string &m_sql_;
+  size_t m_pos_{0};
+};
+
+// what a statement returns, an OK, an error or a one column resultset.
+struct SqlResult {
+  int error{0};
+  std::string message;
+  bool has_rows{false};
+  std::string column;
+  std::vector<int64_t> rows;
+  uint64_t affected{0};
+  uint64_t seqno{0};
+  // LOAD DATA LOCAL into this table, the rows come from the client.
+  std::string infile_table;
+};
+
+static void sql_error(SqlResult &r, int error, const std::string &message) {
+  r.error = error;
+  r.message = message;
+}
+
+static void store_error(SqlResult &r, int error, const std::string &table) {
+  if (error == MOCK_ER_NO_SUCH_TABLE) {
+    sql_error(r, error, "Table '" + table + "' doesn't exist");
+  } else if (error == MOCK_ER_TABLE_EXISTS) {
+    sql_error(r, error, "Table '" + table + "' already exists");
+  } else if (error == MOCK_ER_DUP_ENTRY) {
+    sql_error(r, error, "Duplicate entry for key '" + table + ".PRIMARY'");
+  } else if (error != 0) {
+    sql_error(r, error, "Failed on table '" + table + "'");
+  }
+}
+
+static const char *sqlstate(int error) {
+  switch (error) {
+  case MOCK_ER_TABLE_EXISTS:
+    return "42S01";
+  case MOCK_ER_DUP_ENTRY:
+    return "23000";
+  case MOCK_ER_NO_SUCH_TABLE:
+    return "42S02";
+  case 1064:
+    return "42000";
+  case 1047:
+    return "08S01";
+  default:
+    return "HY000";
+  }
+}
+
+struct Statement {
+  std::string sql;
+  uint16_t params;
+  bool has_rows;
+  // the parameter types the client sent with the first execute.
+  std::string types;
+};
+
+class Session {
+public:
+  // replica is the index of the replica, -1 on the RW port.
+  Session(int fd, int replica)
+      : m_fd_(fd), m_replica_(replica), m_id_(next_connection_id++) {}
+  ~Session() { close(m_fd_); }
+
+  void run() {
+    if (!handshake()) {
+      return;
+    }
+    std::string packet;
+    while (read_packet(packet) && !packet.empty()) {
+      commands.fetch_add(1, std::memory_order_relaxed);
+      if (!dispatch(packet) || !flush()) {
+        break;
+      }
+    }
+  }
+
+private:
+  MockStore &store() {
+    return m_replica_ < 0 ? cluster->primary() : cluster->replica(m_replica_);
+  }
+
+  bool read_packet(std::string &payload) {
+    payload.clear();
+    uint32_t len = 0;
+    do {
+      uint8_t header[4];
+      if (!read_bytes(header, 4)) {
+        return false;
+      }
+      len = header[0] | (header[1] << 8) | (header[2] << 16);
+      m_seq_ = header[3] + 1;
+      size_t old = payload.size();
+      payload.resize(old + len);
+      if (len > 0 && !read_bytes(&payload[old], len)) {
+        return false;
+      }
+      // a payload of 2^24-1 bytes goes on in the next packet.
+    } while (len == 0xffffff);
+    return true;
+  }
+
+  bool read_bytes(void *buf, size_t len) {
+    char *out = (char *)buf;
+    while (len > 0) {
+      if (m_in_pos_ == m_in_len_) {
+        ssize_t n = recv(m_fd_, m_in_, sizeof(m_in_), 0);
+        if (n <= 0) {
+          if (n < 0 && errno == EINTR) {
+            continue;
+          }
+          return false;
+        }
+        m_in_pos_ = 0;
+        m_in_len_ = n;
+      }
+      size_t n = std::min(len, m_in_len_ - m_in_pos_);
+      memcpy(out, m_in_ + m_in_pos_, n);
+      m_in_pos_ += n;
+      out += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  void write_packet(const std::string &payload) {
+    size_t pos = 0;
+    while (true) {
+      size_t len = std::min<size_t>(payload.size() - pos, 0xffffff);
+      put_int(m_out_, len, 3);
+      m_out_.push_back((char)m_seq_++);
+      m_out_.append(payload, pos, len);
+      pos += len;
+      if (len < 0xffffff) {
+        break;
+      }
+    }
+  }
+
+  bool flush() {
+    size_t pos = 0;
+    while (pos < m_out_.size()) {
+      ssize_t n =
+          send(m_fd_, m_out_.data() + pos, m_out_.size() - pos, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      pos += n;
+    }
+    m_out_.clear();
+    return true;
+  }
+
+  /*
+    Any user and password is let in. A client that starts with another
+    plugin than mysql_native_password is switched to it.
+  */
+  bool handshake() {
+    std::string scramble;
+    for (int i = 0; i < 20; i++) {
+      scramble.push_back((char)('0' + (m_id_ * 7 + i * 13) % 64));
+    }
+    std::string p;
+    p.push_back(10);
+    p += MOCK_VERSION;
+    p.push_back('\0');
+    put_int(p, m_id_, 4);
+    p.append(scramble, 0, 8);
+    p.push_back('\0');
+    put_int(p, SERVER_CAPABILITIES & 0xffff, 2);
+    put_int(p, 255, 1);
+    put_int(p, SERVER_STATUS_AUTOCOMMIT, 2);
+    put_int(p, SERVER_CAPABILITIES >> 16, 2);
+    put_int(p, scramble.size() + 1, 1);
+    p.append(10, '\0');
+    p.append(scramble, 8, 12);
+    p.push_back('\0');
+    p += NATIVE_PASSWORD;
+    p.push_back('\0');
+    m_seq_ = 0;
+    write_packet(p);
+    if (!flush() || !read_packet(p) || p.size() < 32) {
+      return false;
+    }
+
+    size_t pos = 0;
+    m_caps_ = get_int(p, pos, 4) & SERVER_CAPABILITIES;
+    pos = 32;
+    get_str_nul(p, pos); // user
+    if (m_caps_ & CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA) {
+      pos += get_lenenc(p, pos);
+    } else if (m_caps_ & CLIENT_SECURE_CONNECTION) {
+      pos += get_int(p, pos, 1);
+    } else {
+      get_str_nul(p, pos);
+    }
+    pos = std::min(pos, p.size());
+    if (m_caps_ & CLIENT_CONNECT_WITH_DB) {
+      get_str_nul(p, pos);
+    }
+    std::string plugin = NATIVE_PASSWORD;
+    if ((m_caps_ & CLIENT_PLUGIN_AUTH) && pos < p.size()) {
+      plugin = get_str_nul(p, pos);
+    }
+    if (plugin != NATIVE_PASSWORD) {
+      std::string auth_switch(1, (char)0xfe);
+      auth_switch += NATIVE_PASSWORD;
+      auth_switch.push_back('\0');
+      auth_switch += scramble;
+      auth_switch.push_back('\0');
+      write_packet(auth_switch);
+      if (!flush() || !read_packet(p)) {
+        return false;
+      }
+    }
+    send_ok(0, 0);
+    return flush();
+  }
+
+  bool dispatch(const std::string &packet) {
+    uint8_t command = packet[0];
+    std::string body = packet.substr(1);
+    switch (command) {
+    case COM_QUIT:
+      return false;
+    case COM_INIT_DB:
+    case COM_PING:
+    case COM_STMT_RESET:
+      send_ok(0, 0);
+      break;
+    case COM_RESET_CONNECTION:
+      m_stmts_.clear();
+      m_track_gtids_ = false;
+      m_track_last_gtid_ = false;
+      send_ok(0, 0);
+      break;
+    case COM_SET_OPTION:
+      send_eof();
+      break;
+    case COM_QUERY:
+      query(body);
+      break;
+    case COM_STMT_PREPARE:
+      prepare(body);
+      break;
+    case COM_STMT_EXECUTE:
+      execute(body);
+      break;
+    case COM_STMT_CLOSE: {
+      size_t pos = 0;
+      m_stmts_.erase(get_int(body, pos, 4));
+      break;
+    }
+    case COM_STMT_SEND_LONG_DATA:
+      // no reply, long data is not supported.
+      break;
+    default:
+      send_error(1047, "Unknown command");
+    }
+    return true;
+  }
+
+  void query(const std::string &sql) {
+    SqlResult r;
+    run_sql(sql, r);
+    if (r.error == 0 && !r.infile_table.empty()) {
+      load_infile(r);
+    }
+    send_result(r, false);
+  }
+
+  // the client sends the "file" in packets up to an empty one.
+  void load_infile(SqlResult &r) {
+    std::string request(1, (char)0xfb);
+    request += "mysqlsct.stream";
+    write_packet(request);
+    if (!flush()) {
+      return;
+    }
+    std::string data, packet;
+    while (read_packet(packet) && !packet.empty()) {
+      data += packet;
+    }
+
+    MockRows rows;
+    size_t pos = 0;
+    while (pos < data.size()) {
+      size_t end = data.find('\n', pos);
+      if (end == std::string::npos) {
+        end = data.size();
+      }
+      const char *line = data.c_str() + pos;
+      char *field = nullptr;
+      uint64_t id = strtoull(line, &field, 10);
+      if (field != line) {
+        uint64_t c1 = strtoull(field + (*field == '\n' ? 0 : 1), nullptr, 10);
+        rows.emplace_back(id, c1);
+      }
+      pos = end + 1;
+    }
+    store_error(r, cluster->insert(r.infile_table, rows, &r.seqno),
+                r.infile_table);
+    r.affected = r.error == 0 ? rows.size() : 0;
+  }
+
+  void prepare(const std::string &sql) {
+    Statement stmt;
+    stmt.sql = sql;
+    stmt.params = 0;
+    bool quoted = false;
+    for (char c : sql) {
+      quoted = c == '\'' ? !quoted : quoted;
+      stmt.params += (c == '?' && !quoted) ? 1 : 0;
+    }
+    Lexer lexer(sql);
+    stmt.has_rows = lexer.word("select");
+    uint32_t stmt_id = ++m_next_stmt_id_;
+    m_stmts_[stmt_id] = stmt;
+
+    std::string p(1, '\0');
+    put_int(p, stmt_id, 4);
+    put_int(p, stmt.has_rows ? 1 : 0, 2);
+    put_int(p, stmt.params, 2);
+    p.push_back('\0');
+    put_int(p, 0, 2);
+    write_packet(p);
+    if (stmt.params > 0) {
+      for (uint16_t i = 0; i < stmt.params; i++) {
+        send_column("?");
+      }
+      send_eof();
+    }
+    if (stmt.has_rows) {
+      send_column(result_column(sql));
+      send_eof();
+    }
+  }
+
+  /*
+    The parameters are put into the sql as literals, then it runs like a
+    COM_QUERY and the rows are sent in the binary protocol.
+  */
+  void execute(const std::string &body) {
+    size_t pos = 0;
+    auto it = m_stmts_.find(get_int(body, pos, 4));
+    if (it == m_stmts_.end()) {
+      send_error(1243, "Unknown prepared statement handler given to execute");
+      return;
+    }
+    Statement &stmt = it->second;
+    pos += 5; // flags, iteration count
+    std::string sql;
+    if (stmt.params == 0) {
+      sql = stmt.sql;
+    } else {
+      size_t bitmap = pos;
+      pos += (stmt.params + 7) / 8;
+      if (get_int(body, pos, 1) == 1) {
+        stmt.types = body.substr(pos, 2 * stmt.params);
+        pos += 2 * stmt.params;
+      }
+      std::vector<std::string> values;
+      for (uint16_t i = 0; i < stmt.params; i++) {
+        bool null = bitmap + i / 8 < body.size() &&
+                    ((uint8_t)body[bitmap + i / 8] & (1 << (i % 8)));
+        values.push_back(null ? "NULL" : param_value(stmt, i, body, pos));
+      }
+      size_t next = 0;
+      bool quoted = false;
+      for (char c : stmt.sql) {
+        quoted = c == '\'' ? !quoted : quoted;
+        if (c == '?' && !quoted && next < values.size()) {
+          sql += values[next++];
+        } else {
+          sql.push_back(c);
+        }
+      }
+    }
+    SqlResult r;
+    run_sql(sql, r);
+    if (!r.infile_table.empty()) {
+      sql_error(r, 1295,
+                "This command is not supported in the prepared statement "
+                "protocol yet");
+    }
+    send_result(r, true);
+  }
+
+  std::string param_value(const Statement &stmt, size_t i,
+                          const std::string &body, size_t &pos) {
+    uint8_t type = 0xfd;
+    bool is_unsigned = false;
+    if (2 * i + 1 < stmt.types.size()) {
+      type = stmt.types[2 * i];
+      is_unsigned = (uint8_t)stmt.types[2 * i + 1] & 0x80;
+    }
+    size_t bytes = 0;
+    switch (type) {
+    case 1: // tiny
+      bytes = 1;
+      break;
+    case 2: // short
+    case 13: // year
+      bytes = 2;
+      break;
+    case 3: // long
+    case 9: // int24
+      bytes = 4;
+      break;
+    case MYSQL_TYPE_LONGLONG:
+      bytes = 8;
+      break;
+    case 4: { // float
+      float f;
+      uint32_t raw = get_int(body, pos, 4);
+      memcpy(&f, &raw, 4);
+      return std::to_string(f);
+    }
+    case 5: { // double
+      double d;
+      uint64_t raw = get_int(body, pos, 8);
+      memcpy(&d, &raw, 8);
+      return std::to_string(d);
+    }
+    default: { // the string types
+      uint64_t len = get_lenenc(body, pos);
+      std::string s = "'";
+      for (char c : body.substr(pos, len)) {
+        if (c == '\'' || c == '\\') {
+          s.push_back('\\');
+        }
+        s.push_back(c);
+      }
+      pos += len;
+      return s + "'";
+    }
+    }
+    uint64_t v = get_int(body, pos, bytes);
+    if (is_unsigned || bytes == 8) {
+      return is_unsigned ? std::to_string(v) : std::to_string((int64_t)v);
+    }
+    // sign extend the short ints.
+    uint64_t sign = 1ULL << (8 * bytes - 1);
+    return std::to_string((int64_t)((v ^ sign) - sign));
+  }
+
+  static std::string result_column(const std::string &sql) {
+    Lexer lexer(sql);
+    lexer.word("select");
+    if (lexer.word("c1")) {
+      return "c1";
+    }
+    if (lexer.word("count")) {
+      return "count(*)";
+    }
+    return "1";
+  }
+
+  void run_sql(const std::string &sql, SqlResult &r) {
+    Lexer lexer(sql);
+    std::string table;
+    if (lexer.word("select")) {
+      select(sql, lexer, r);
+      return;
+    }
+    if (lexer.word("set")) {
+      set(sql);
+      return;
+    }
+    bool write = lexer.word("insert") || lexer.word("update") ||
+                 lexer.word("create") || lexer.word("drop") ||
+                 lexer.word("alter") || lexer.word("load");
+    if (!write) {
+      // begin, commit, rollback, use, ... have nothing to do.
+      return;
+    }
+    if (m_replica_ >= 0) {
+      sql_error(r, 1290,
+                "The MySQL server is running with the --super-read-only "
+                "option so it cannot execute this statement");
+      return;
+    }
+
+    Lexer stmt(sql);
+    if (stmt.word("insert")) {
+      insert(stmt, r);
+    } else if (stmt.word("update")) {
+      update(stmt, r);
+    } else if (stmt.word("create")) {
+      bool if_not_exists = false;
+      if (stmt.word("table") &&
+          (if_not_exists = stmt.word("if"), !if_not_exists ||
+                                                (stmt.word("not") &&
+                                                 stmt.word("exists"))) &&
+          stmt.name(table)) {
+        store_error(r, cluster->create_table(table, if_not_exists, &r.seqno),
+                    table);
+      } else {
+        syntax_error(r, sql);
+      }
+    } else if (stmt.word("drop")) {
+      bool if_exists = false;
+      if (stmt.word("table") &&
+          (if_exists = stmt.word("if"), !if_exists || stmt.word("exists")) &&
+          stmt.name(table)) {
+        store_error(r, cluster->drop_table(table, if_exists, &r.seqno),
+                    table);
+      } else {
+        syntax_error(r, sql);
+      }
+    } else if (stmt.word("alter")) {
+      // the pk is always there, only the table must be.
+      if (stmt.word("table") && stmt.name(table)) {
+        store_error(r, store().exists(table) ? 0 : MOCK_ER_NO_SUCH_TABLE,
+                    table);
+      } else {
+        syntax_error(r, sql);
+      }
+    } else if (stmt.word("load")) {
+      std::string file;
+      if (stmt.word("data") && stmt.word("local") && stmt.word("infile") &&
+          stmt.str(file) && stmt.word("into") && stmt.word("table") &&
+          stmt.name(table)) {
+        store_error(r, store().exists(table) ? 0 : MOCK_ER_NO_SUCH_TABLE,
+                    table);
+        r.infile_table = r.error == 0 ? table : "";
+      } else {
+        syntax_error(r, sql);
+      }
+    }
+  }
+
+  void syntax_error(SqlResult &r, const std::string &sql) {
+    sql_error(r, 1064,
+              "You have an error in your SQL syntax near '" +
+                  sql.substr(0, 80) + "'");
+  }
+
+  // session_track_gtids and session_track_system_variables, the rest is
+  // accepted and ignored.
+  void set(const std::string &sql) {
+    std::string lower = sql;
+    for (auto &c : lower) {
+      c = tolower(c);
+    }
+    if (lower.find("session_track_gtids") != std::string::npos) {
+      m_track_gtids_ = lower.find("off") == std::string::npos;
+    }
+    if (lower.find("session_track_system_variables") != std::string::npos) {
+      m_track_last_gtid_ = lower.find("last_gtid") != std::string::npos;
+    }
+  }
+
+  void select(const std::string &sql, Lexer &lexer, SqlResult &r) {
+    std::string table, token;
+    uint64_t id = 0, first = 0, last = UINT64_MAX, value = 0;
+    double timeout_s = 0;
+    bool mariadb = false;
+    r.has_rows = true;
+    r.column = result_column(sql);
+    if (lexer.word("c1")) {
+      bool found = false;
+      if (!lexer.word("from") || !lexer.name(table) || !lexer.word("where") ||
+          !lexer.word("id") || !lexer.punct('=') || !lexer.number(id)) {
+        syntax_error(r, sql);
+        return;
+      }
+      store_error(r, store().get(table, id, &value, &found), table);
+      if (found) {
+        r.rows.push_back(value);
+      }
+    } else if (lexer.word("count")) {
+      if (!lexer.punct('(') || !lexer.punct('*') || !lexer.punct(')') ||
+          !lexer.word("from") || !lexer.name(table)) {
+        syntax_error(r, sql);
+        return;
+      }
+      if (lexer.word("where") &&
+          (!lexer.word("id") || !lexer.word("between") ||
+           !lexer.number(first) || !lexer.word("and") || !lexer.number(last))) {
+        syntax_error(r, sql);
+        return;
+      }
+      store_error(r, store().count(table, first, last, &value), table);
+      r.rows.push_back(value);
+    } else if (lexer.word("wait_for_executed_gtid_set") ||
+               (mariadb = lexer.word("master_gtid_wait"))) {
+      // both tokens end with the sequence number, uuid:n or domain-server-n.
+      if (!lexer.punct('(') || !lexer.str(token) ||
+          (lexer.punct(',') && !lexer.decimal(timeout_s))) {
+        syntax_error(r, sql);
+        return;
+      }
+      size_t digits = token.find_last_not_of("0123456789");
+      uint64_t seqno = strtoull(
+          token.c_str() + (digits == std::string::npos ? 0 : digits + 1),
+          nullptr, 10);
+      bool applied = store().wait_applied(
+          seqno, timeout_s > 0 ? (uint64_t)(timeout_s * 1e6) : UINT32_MAX);
+      r.rows.push_back(applied ? 0 : (mariadb ? -1 : 1));
+    } else {
+      // anything else selects one row, enough for the short connection and
+      // remain qps query files.
+      r.rows.push_back(1);
+    }
+  }
+
+  void insert(Lexer &lexer, SqlResult &r) {
+    std::string table, column;
+    MockRows rows;
+    if (!lexer.word("into") || !lexer.name(table)) {
+      syntax_error(r, "insert");
+      return;
+    }
+    if (lexer.punct('(')) {
+      while (lexer.name(column) && lexer.punct(',')) {
+      }
+      lexer.punct(')');
+    }
+    if (!lexer.word("values") && !lexer.word("value")) {
+      syntax_error(r, "insert into " + table);
+      return;
+    }
+    do {
+      uint64_t id = 0, c1 = 0;
+      if (!lexer.punct('(') || !lexer.number(id) || !lexer.punct(',') ||
+          !lexer.number(c1) || !lexer.punct(')')) {
+        syntax_error(r, "insert into " + table);
+        return;
+      }
+      rows.emplace_back(id, c1);
+    } while (lexer.punct(','));
+    store_error(r, cluster->insert(table, rows, &r.seqno), table);
+    r.affected = r.error == 0 ? rows.size() : 0;
+  }
+
+  void update(Lexer &lexer, SqlResult &r) {
+    std::string table;
+    uint64_t id = 0, value = 0;
+    bool greatest = false;
+    if (!lexer.name(table) || !lexer.word("set") || !lexer.word("c1") ||
+        !lexer.punct('=')) {
+      syntax_error(r, "update");
+      return;
+    }
+    if (lexer.word("greatest")) {
+      greatest = true;
+      if (!lexer.punct('(') || !lexer.word("c1") || !lexer.punct(',') ||
+          !lexer.number(value) || !lexer.punct(')')) {
+        syntax_error(r, "update " + table);
+        return;
+      }
+    } else if (!lexer.number(value)) {
+      syntax_error(r, "update " + table);
+      return;
+    }
+    if (!lexer.word("where") || !lexer.word("id") || !lexer.punct('=') ||
+        !lexer.number(id)) {
+      syntax_error(r, "update " + table);
+      return;
+    }
+    store_error(r,
+                cluster->update(table, id, value, greatest, &r.affected,
+                                &r.seqno),
+                table);
+  }
+
+  void send_result(const SqlResult &r, bool binary) {
+    if (r.error != 0) {
+      send_error(r.error, r.message);
+      return;
+    }
+    if (!r.has_rows) {
+      send_ok(r.affected, r.seqno);
+      return;
+    }
+    std::string p;
+    put_lenenc(p, 1);
+    write_packet(p);
+    send_column(r.column);
+    send_eof();
+    for (int64_t v : r.rows) {
+      p.clear();
+      if (binary) {
+        // header and the null bitmap, which is offset by 2 bits.
+        p.push_back('\0');
+        p.push_back('\0');
+        put_int(p, v, 8);
+      } else {
+        put_lenenc_str(p, std::to_string(v));
+      }
+      write_packet(p);
+    }
+    send_eof();
+  }
+
+  void send_column(const std::string &name) {
+    std::string p;
+    put_lenenc_str(p, "def");
+    put_lenenc_str(p, "");
+    put_lenenc_str(p, "");
+    put_lenenc_str(p, "");
+    put_lenenc_str(p, name);
+    put_lenenc_str(p, name);
+    put_lenenc(p, 0x0c);
+    put_int(p, 63, 2); // binary
+    put_int(p, 20, 4);
+    put_int(p, MYSQL_TYPE_LONGLONG, 1);
+    put_int(p, 0x8080, 2); // NUM_FLAG | BINARY_FLAG
+    put_int(p, 0, 1);
+    put_int(p, 0, 2);
+    write_packet(p);
+  }
+
+  /*
+    With CLIENT_SESSION_TRACK the OK of a write carries its gtid, as
+    session_track_gtids = OWN_GTID or the mariadb last_gtid variable asked.
+  */
+  void send_ok(uint64_t affected, uint64_t seqno) {
+    std::string p(1, '\0');
+    put_lenenc(p, affected);
+    put_lenenc(p, 0);
+    std::string state;
+    if (seqno != 0 && (m_caps_ & CLIENT_SESSION_TRACK)) {
+      if (m_track_gtids_) {
+        std::string data(1, '\0'); // encoding specification
+        put_lenenc_str(data, std::string(MOCK_UUID) + ":" +
+                                 std::to_string(seqno));
+        state.push_back(SESSION_TRACK_GTIDS);
+        put_lenenc_str(state, data);
+      }
+      if (m_track_last_gtid_) {
+        std::string data;
+        put_lenenc_str(data, "last_gtid");
+        put_lenenc_str(data, "0-1-" + std::to_string(seqno));
+        state.push_back(SESSION_TRACK_SYSTEM_VARIABLES);
+        put_lenenc_str(state, data);
+      }
+    }
+    put_int(p,
+            SERVER_STATUS_AUTOCOMMIT |
+                (state.empty() ? 0 : SERVER_SESSION_STATE_CHANGED),
+            2);
+    put_int(p, 0, 2);
+    if (m_caps_ & CLIENT_SESSION_TRACK) {
+      put_lenenc_str(p, "");
+      if (!state.empty()) {
+        put_lenenc_str(p, state);
+      }
+    }
+    write_packet(p);
+  }
+
+  void send_eof() {
+    std::string p(1, (char)0xfe);
+    put_int(p, 0, 2);
+    put_int(p, SERVER_STATUS_AUTOCOMMIT, 2);
+    write_packet(p);
+  }
+
+  void send_error(int error, const std::string &message) {
+    std::string p(1, (char)0xff);
+    put_int(p, error, 2);
+    p.push_back('#');
+    p += sqlstate(error);
+    p += message;
+    write_packet(p);
+  }
+
+  int m_fd_;
+  int m_replica_;
+  uint32_t m_id_;
+  uint32_t m_caps_{0};
+  uint8_t m_seq_{0};
+  char m_in_[16384];
+  size_t m_in_pos_{0};
+  size_t m_in_len_{0};
+  std::string m_out_;
+  bool m_track_gtids_{false};
+  bool m_track_last_gtid_{false};
+  std::map<uint32_t, Statement> m_stmts_;
+  uint32_t m_next_stmt_id_{0};
+};
+
+static int listen_on(uint64_t port) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, bind_address, &addr.sin_addr) != 1) {
+    std::cerr << "invalid bind-address: " << bind_address << std::endl;
+    return -1;
+  }
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, 1024) != 0) {
+    std::cerr << "Failed to listen on " << bind_address << ":" << port
+              << ", errno: " << errno << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+static void accept_loop(int listen_fd, int replica) {
+  while (true) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno != EINTR && errno != ECONNABORTED) {
+        std::cerr << "Failed to accept, errno: " << errno << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      continue;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    std::thread([fd, replica] {
+      connections++;
+      Session(fd, replica).run();
+      connections--;
+    }).detach();
+  }
+}
+
+static void usage() {
+  std::cout << "Usage: mysqlsct_mock_server [OPTIONS]" << std::endl;
+  std::cout << "--bind-address	address to listen on, 127.0.0.1 by default.\n";
+  std::cout << "--rw-port	port of the RW node, 3306 by default.\n";
+  std::cout << "--ro-port	port of the first RO node, the others follow, "
+               "3307 by default.\n";
+  std::cout << "--replicas	number of RO nodes, 1 by default.\n";
+  std::cout << "--lag-us	mean delay in us before a replica applies a "
+               "write, 0 by default.\n";
+  std::cout << "--lag-dist	fixed|uniform|exp, distribution of the "
+               "delay, uniform is 0 to twice the mean.\n";
+  std::cout << "--report-interval	seconds between the commands/s "
+               "reports, 0 is off.\n";
+}
+
+static bool parse_option(int argc, char *argv[]) {
+  static const struct option long_options[] = {
+      {"help", 0, nullptr, '?'},
+      {"bind-address", 1, nullptr, 'b'},
+      {"rw-port", 1, nullptr, 'P'},
+      {"ro-port", 1, nullptr, 'o'},
+      {"replicas", 1, nullptr, 'n'},
+      {"lag-us", 1, nullptr, 'l'},
+      {"lag-dist", 1, nullptr, 'd'},
+      {"report-interval", 1, nullptr, 'r'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "?", long_options, nullptr)) != -1) {
+    switch (opt) {
+    case 'b':
+      bind_address = optarg;
+      break;
+    case 'P':
+      rw_port = strtoull(optarg, nullptr, 10);
+      break;
+    case 'o':
+      ro_port = strtoull(optarg, nullptr, 10);
+      break;
+    case 'n':
+      replicas = strtoull(optarg, nullptr, 10);
+      break;
+    case 'l':
+      lag_us = strtoull(optarg, nullptr, 10);
+      break;
+    case 'd':
+      if (strcasecmp(optarg, "fixed") == 0) {
+        lag_dist = LAG_FIXED;
+      } else if (strcasecmp(optarg, "uniform") == 0) {
+        lag_dist = LAG_UNIFORM;
+      } else if (strcasecmp(optarg, "exp") == 0) {
+        lag_dist = LAG_EXP;
+      } else {
+        std::cout << "unknown lag-dist: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'r':
+      report_interval = strtoull(optarg, nullptr, 10);
+      break;
+    default:
+      usage();
+      return false;
+    }
+  }
+  if (rw_port == 0 || rw_port > 65535 || ro_port == 0 ||
+      ro_port + replicas > 65536) {
+    std::cout << "invalid rw-port or ro-port." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (!parse_option(argc, argv)) {
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  std::vector<int> fds;
+  fds.push_back(listen_on(rw_port));
+  for (uint64_t i = 0; i < replicas; i++) {
+    fds.push_back(listen_on(ro_port + i));
+  }
+  for (int fd : fds) {
+    if (fd < 0) {
+      return 1;
+    }
+  }
+  cluster = new MockCluster(replicas, lag_us, lag_dist);
+  for (size_t i = 0; i < fds.size(); i++) {
+    std::thread(accept_loop, fds[i], (int)i - 1).detach();
+  }
+  static const char *lag_dist_names[] = {"fixed", "uniform", "exp"};
+  std::cout << "mysqlsct_mock_server " << MOCK_VERSION << ", RW "
+            << bind_address << ":" << rw_port << ", RO ports " << ro_port
+            << "-" << ro_port + replicas - 1 << ", lag " << lag_us << "us "
+            << lag_dist_names[lag_dist] << std::endl;
+
+  uint64_t last = 0;
+  while (true) {
+    std::this_thread::sleep_for(
+        std::chrono::seconds(report_interval ? report_interval : 3600));
+    if (report_interval == 0) {
+      continue;
+    }
+    uint64_t now = commands.load();
+    std::cout << "Mock server: " << (now - last) / report_interval
+              << " commands/s, " << connections.load() << " connections"
+              << std::endl;
+    last = now;
+  }
+  return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : mock_store.cc
+ * @Description  : in memory tables of the mock server and their replication.
+ */
+
+#include "mock_store.h"
+
+#include <algorithm>
+#include <chrono>
+
+static uint64_t steady_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int MockStore::get(const std::string &table, uint64_t id, uint64_t *value,
+                   bool *found) {
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  auto it = m_tables_.find(table);
+  if (it == m_tables_.end()) {
+    return MOCK_ER_NO_SUCH_TABLE;
+  }
+  auto row = it->second.find(id);
+  *found = row != it->second.end();
+  if (*found) {
+    *value = row->second;
+  }
+  return 0;
+}
+
+int MockStore::count(const std::string &table, uint64_t first, uint64_t last,
+                     uint64_t *rows) {
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  auto it = m_tables_.find(table);
+  if (it == m_tables_.end()) {
+    return MOCK_ER_NO_SUCH_TABLE;
+  }
+  const MockTable &t = it->second;
+  if (first == 0 && last == UINT64_MAX) {
+    *rows = t.size();
+  } else if (last - first < t.size()) {
+    *rows = 0;
+    for (uint64_t id = first; id <= last && id >= first; id++) {
+      *rows += t.count(id);
+    }
+  } else {
+    *rows = std::count_if(t.begin(), t.end(),
+                          [&](const MockTable::value_type &row) {
+                            return row.first >= first && row.first <= last;
+                          });
+  }
+  return 0;
+}
+
+bool MockStore::exists(const std::string &table) {
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  return m_tables_.count(table) != 0;
+}
+
+bool MockStore::wait_applied(uint64_t seqno, uint64_t timeout_us) {
+  std::unique_lock<std::mutex> lock(m_mutex_);
+  return m_applied_cv_.wait_for(lock, std::chrono::microseconds(timeout_us),
+                                [&] { return m_applied_ >= seqno; });
+}
+
+void MockStore::apply(const MockChange &change) {
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  switch (change.kind) {
+  case MockChange::CREATE:
+    m_tables_[change.table];
+    break;
+  case MockChange::DROP:
+    m_tables_.erase(change.table);
+    break;
+  case MockChange::UPSERT: {
+    MockTable &t = m_tables_[change.table];
+    for (auto &row : change.rows) {
+      t[row.first] = row.second;
+    }
+    break;
+  }
+  }
+  m_applied_ = change.seqno;
+  m_applied_cv_.notify_all();
+}
+
+MockCluster::MockCluster(size_t replicas, uint64_t lag_us, LagDist lag_dist)
+    : m_lag_us_(lag_us), m_lag_dist_(lag_dist), m_rand_(steady_us()) {
+  for (size_t i = 0; i < replicas; i++) {
+    m_replicas_.emplace_back(new Replica());
+    Replica *replica = m_replicas_.back().get();
+    replica->store.reset(new MockStore());
+    replica->applier = std::thread(&MockCluster::apply_loop, this, replica);
+  }
+}
+
+MockCluster::~MockCluster() {
+  for (auto &replica : m_replicas_) {
+    {
+      std::lock_guard<std::mutex> lock(replica->mutex);
+      m_stop_ = true;
+      replica->cv.notify_all();
+    }
+    replica->applier.join();
+  }
+}
+
+int MockCluster::create_table(const std::string &table, bool if_not_exists,
+                              uint64_t *seqno) {
+  std::lock_guard<std::mutex> lock(m_primary_.m_mutex_);
+  *seqno = 0;
+  if (m_primary_.m_tables_.count(table)) {
+    return if_not_exists ? 0 : MOCK_ER_TABLE_EXISTS;
+  }
+  m_primary_.m_tables_[table];
+  MockChange *change = new MockChange{MockChange::CREATE, table, {}, 0};
+  *seqno = ship(change);
+  return 0;
+}
+
+int MockCluster::drop_table(const std::string &table, bool if_exists,
+                            uint64_t *seqno) {
+  std::lock_guard<std::mutex> lock(m_primary_.m_mutex_);
+  *seqno = 0;
+  if (m_primary_.m_tables_.erase(table) == 0) {
+    return if_exists ? 0 : MOCK_ER_NO_SUCH_TABLE;
+  }
+  MockChange *change = new MockChange{MockChange::DROP, table, {}, 0};
+  *seqno = ship(change);
+  return 0;
+}
+
+int MockCluster::insert(const std::string &table, const MockRows &rows,
+                        uint64_t *seqno) {
+  std::lock_guard<std::mutex> lock(m_primary_.m_mutex_);
+  *seqno = 0;
+  auto it = m_primary_.m_tables_.find(table);
+  if (it == m_primary_.m_tables_.end()) {
+    return MOCK_ER_NO_SUCH_TABLE;
+  }
+  MockTable &t = it->second;
+  for (size_t i = 0; i < rows.size(); i++) {
+    if (!t.emplace(rows[i].first, rows[i].second).second) {
+      // the statement is atomic, take back what it inserted.
+      for (size_t j = 0; j < i; j++) {
+        t.erase(rows[j].first);
+      }
+      return MOCK_ER_DUP_ENTRY;
+    }
+  }
+  if (rows.empty()) {
+    return 0;
+  }
+  MockChange *change = new MockChange{MockChange::UPSERT, table, rows, 0};
+  *seqno = ship(change);
+  return 0;
+}
+
+int MockCluster::update(const std::string &table, uint64_t id, uint64_t value,
+                        bool greatest, uint64_t *affected, uint64_t *seqno) {
+  std::lock_guard<std::mutex> lock(m_primary_.m_mutex_);
+  *affected = 0;
+  *seqno = 0;
+  auto it = m_primary_.m_tables_.find(table);
+  if (it == m_primary_.m_tables_.end()) {
+    return MOCK_ER_NO_SUCH_TABLE;
+  }
+  auto row = it->second.find(id);
+  if (row == it->second.end()) {
+    return 0;
+  }
+  uint64_t new_value = greatest ? std::max(row->second, value) : value;
+  // like mysql, an update that changes nothing is not logged.
+  if (new_value == row->second) {
+    return 0;
+  }
+  row->second = new_value;
+  *affected = 1;
+  MockChange *change =
+      new MockChange{MockChange::UPSERT, table, {{id, new_value}}, 0};
+  *seqno = ship(change);
+  return 0;
+}
+
+uint64_t MockCluster::ship(MockChange *change) {
+  std::shared_ptr<const MockChange> shared(change);
+  change->seqno = ++m_seqno_;
+  m_primary_.m_applied_ = change->seqno;
+  m_primary_.m_applied_cv_.notify_all();
+
+  if (m_lag_us_ == 0) {
+    // without a lag the replicas apply the change before the write returns,
+    // so a read after it never sees an old value.
+    for (auto &replica : m_replicas_) {
+      replica->store->apply(*shared);
+    }
+    return change->seqno;
+  }
+
+  uint64_t now = steady_us();
+  for (auto &replica : m_replicas_) {
+    // a replica applies in order, a change is never due before the last one.
+    uint64_t due = std::max(replica->last_due_us, now + draw_lag_us());
+    std::lock_guard<std::mutex> lock(replica->mutex);
+    replica->last_due_us = due;
+    replica->log.emplace_back(shared, due);
+    if (replica->log.size() == 1) {
+      replica->cv.notify_one();
+    }
+  }
+  return change->seqno;
+}
+
+uint64_t MockCluster::draw_lag_us() {
+  if (m_lag_us_ == 0) {
+    return 0;
+  }
+  switch (m_lag_dist_) {
+  case LAG_UNIFORM:
+    return std::uniform_int_distribution<uint64_t>(0, 2 * m_lag_us_)(m_rand_);
+  case LAG_EXP:
+    return std::exponential_distribution<double>(1.0 / m_lag_us_)(m_rand_);
+  case LAG_FIXED:
+  default:
+    return m_lag_us_;
+  }
+}
+
+void MockCluster::apply_loop(Replica *replica) {
+  std::unique_lock<std::mutex> lock(replica->mutex);
+  while (!m_stop_) {
+    if (replica->log.empty()) {
+      replica->cv.wait(lock);
+      continue;
+    }
+    uint64_t now = steady_us();
+    uint64_t due = replica->log.front().second;
+    if (due > now) {
+      replica->cv.wait_for(lock, std::chrono::microseconds(due - now));
+      continue;
+    }
+    std::shared_ptr<const MockChange> change = replica->log.front().first;
+    replica->log.pop_front();
+    lock.unlock();
+    replica->store->apply(*change);
+    lock.lock();
+  }
+}
@@ -0,0 +1,118 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : mock_store.h
+ * @Description  : in memory tables of the mock server and their replication.
+ *                 The primary runs the writes and logs every change with a
+ *                 sequence number, its gtid. Each replica applies the log in
+ *                 order, every change after a delay drawn from --lag-dist
+ *                 with a mean of --lag-us, with --lag-us=0 before the write
+ *                 returns.
+ */
+
+#ifndef MOCK_STORE_H
+#define MOCK_STORE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// the sct schema, (id bigint primary key, c1 bigint).
+using MockTable = std::unordered_map<uint64_t, uint64_t>;
+using MockRows = std::vector<std::pair<uint64_t, uint64_t>>;
+
+enum LagDist { LAG_FIXED, LAG_UNIFORM, LAG_EXP };
+
+// mysql error codes the store returns.
+enum {
+  MOCK_ER_TABLE_EXISTS = 1050,
+  MOCK_ER_DUP_ENTRY = 1062,
+  MOCK_ER_NO_SUCH_TABLE = 1146
+};
+
+struct MockChange {
+  enum Kind { CREATE, DROP, UPSERT } kind;
+  std::string table;
+  // id, c1 after the change.
+  MockRows rows;
+  uint64_t seqno;
+};
+
+class MockStore {
+public:
+  // 0, or MOCK_ER_NO_SUCH_TABLE. found is false for a missing row.
+  int get(const std::string &table, uint64_t id, uint64_t *value,
+          bool *found);
+  int count(const std::string &table, uint64_t first, uint64_t last,
+            uint64_t *rows);
+  bool exists(const std::string &table);
+  // sequence number of the last change applied here.
+  uint64_t applied() {
+    std::lock_guard<std::mutex> lock(m_mutex_);
+    return m_applied_;
+  }
+  // false when seqno was not applied within timeout_us.
+  bool wait_applied(uint64_t seqno, uint64_t timeout_us);
+
+private:
+  friend class MockCluster;
+  void apply(const MockChange &change);
+
+  std::mutex m_mutex_;
+  std::condition_variable m_applied_cv_;
+  std::map<std::string, MockTable> m_tables_;
+  uint64_t m_applied_{0};
+};
+
+class MockCluster {
+public:
+  MockCluster(size_t replicas, uint64_t lag_us, LagDist lag_dist);
+  ~MockCluster();
+
+  MockStore &primary() { return m_primary_; }
+  MockStore &replica(size_t i) { return *m_replicas_[i]->store; }
+
+  // the writes run on the primary and are shipped to the replicas, seqno is
+  // 0 when nothing changed. They return 0 or a mysql error code.
+  int create_table(const std::string &table, bool if_not_exists,
+                   uint64_t *seqno);
+  int drop_table(const std::string &table, bool if_exists, uint64_t *seqno);
+  int insert(const std::string &table, const MockRows &rows,
+             uint64_t *seqno);
+  int update(const std::string &table, uint64_t id, uint64_t value,
+             bool greatest, uint64_t *affected, uint64_t *seqno);
+
+private:
+  struct Replica {
+    std::unique_ptr<MockStore> store;
+    std::mutex mutex;
+    std::condition_variable cv;
+    // the changes with the monotonic time in us they are due at.
+    std::deque<std::pair<std::shared_ptr<const MockChange>, uint64_t>> log;
+    uint64_t last_due_us{0};
+    std::thread applier;
+  };
+  // applies change on the primary and queues it for the replicas, with the
+  // primary locked so the log has the order of the primary.
+  uint64_t ship(MockChange *change);
+  uint64_t draw_lag_us();
+  void apply_loop(Replica *replica);
+
+  MockStore m_primary_;
+  std::vector<std::unique_ptr<Replica>> m_replicas_;
+  uint64_t m_lag_us_;
+  LagDist m_lag_dist_;
+  std::mt19937_64 m_rand_;
+  uint64_t m_seqno_{0};
+  bool m_stop_{false};
+};
+
+#endif // MOCK_STORE_H
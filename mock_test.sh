@@ -0,0 +1,68 @@
+#!/bin/bash
+# runs mysqlsct against mysqlsct_mock_server and checks its summary, for ctest:
+#   mock_test.sh MYSQLSCT MOCK_SERVER PORT LAG_US EXPECT [MYSQLSCT OPTIONS]
+# the mock serves RW on PORT and one replica on PORT+1 that applies the writes
+# LAG_US later. EXPECT is none when the summary must count no failures, some
+# when it must count failures, e.g. the stale reads of sct with a lag.
+
+if [ $# -lt 5 ]; then
+  echo "usage: $0 MYSQLSCT MOCK_SERVER PORT LAG_US none|some [OPTIONS]"
+  exit 2
+fi
+mysqlsct=$1
+mock_server=$2
+port=$3
+lag_us=$4
+expect=$5
+shift 5
+
+"$mock_server" --rw-port=$port --ro-port=$((port + 1)) --replicas=1 \
+  --lag-us=$lag_us --lag-dist=fixed &
+mock_pid=$!
+trap 'kill $mock_pid 2>/dev/null; wait $mock_pid 2>/dev/null' EXIT
+
+for i in $(seq 50); do
+  if (echo >/dev/tcp/127.0.0.1/$port) 2>/dev/null; then
+    break
+  fi
+  if ! kill -0 $mock_pid 2>/dev/null; then
+    echo "mysqlsct_mock_server did not start."
+    exit 1
+  fi
+  sleep 0.1
+done
+
+output=$("$mysqlsct" --host-rw=127.0.0.1 --port-rw=$port \
+  --host-ro=127.0.0.1:$((port + 1)) --host=127.0.0.1 --port=$port \
+  --user=sct --password=sct --database=sct "$@" 2>&1)
+status=$?
+echo "$output"
+if [ $status -ne 0 ]; then
+  echo "mysqlsct exited with $status."
+  exit 1
+fi
+
+# the summary of sct, shortct and rqps: "...: <total>, failed cnt: <failed>".
+summary=$(echo "$output" |
+  grep -E '^(Test .* cnt|mean qps in all time): [0-9]+, failed cnt: [0-9]+' |
+  head -1)
+if [ -z "$summary" ]; then
+  echo "no summary in the output."
+  exit 1
+fi
+total=$(echo "$summary" | sed -E 's/^[^:]*: ([0-9]+),.*/\1/')
+failed=$(echo "$summary" | sed -E 's/.*failed cnt: ([0-9]+).*/\1/')
+
+if [ "$total" -eq 0 ]; then
+  echo "nothing was tested."
+  exit 1
+fi
+if [ "$expect" = none ] && [ "$failed" -ne 0 ]; then
+  echo "expected no failures, got $failed."
+  exit 1
+fi
+if [ "$expect" = some ] && [ "$failed" -eq 0 ]; then
+  echo "expected failures, got none."
+  exit 1
+fi
+exit 0
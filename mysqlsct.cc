@@ -4,37 +4,63 @@
  * @date 9/13/22
  * @version 0.0.1
  **/
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstring>
+#include <deque>
 #include <getopt.h>
 #include <iostream>
+#include <memory>
+#include <mysql/errmsg.h>
 #include <mysql/mysql.h>
+#include <mysql/mysqld_error.h>
 #include <string>
 #include <thread>
 #include <unistd.h>
-
+#include <vector>
+
+#include "async_engine.h"
+#include "async_log.h"
+#include "barrier.h"
+#include "cpu_affinity.h"
+#include "data_loader.h"
+#include "dist.h"
+#include "histogram.h"
 #include "options.h"
+#include "pacer.h"
+#include "rand_gen.h"
 #include "remain_qps.h"
+#include "replay.h"
+#include "report_writer.h"
+#include "sct_sql.h"
 #include "short_connection.h"
+#include "stop_signal.h"
+#include "sweep.h"
+#include "work_budget.h"
 
 using std::string;
 
 std::atomic<uint32_t> active_threads{0};
 std::atomic<uint32_t> running_threads{0};
-std::atomic<uint64_t> processed_times{0};
 
 extern char *user;
 extern char *password;
 extern char *database;
-extern char *host_ro;
 extern char *host_rw;
 extern uint port_rw;
-extern uint port_ro;
+extern std::vector<Endpoint> ro_endpoints;
+extern ReplicaPick ro_pick;
+extern uint64_t ro_subset;
+extern ReadBarrier ro_barrier;
+extern char *ro_barrier_sql;
+extern uint64_t ro_barrier_timeout_ms;
 extern uint sc_gap_us;
 extern uint table_cnt;
 extern uint64_t concurrency;
 extern uint64_t table_size;
 extern uint64_t iterations;
+extern uint64_t test_time; // s, 0 runs until --iterations are done
 extern uint64_t report_interval; // s
 extern uint detail_log;
 extern uint64_t sleep_after_sct_failed; // s
@@ -42,6 +68,21 @@ extern uint select_after_insert;
 extern uint short_connection;
 extern std::string table_name_prefix;
 extern bool skip_prepare;
+extern uint lag_mode;
+extern uint64_t lag_timeout_us;
+extern uint64_t lag_poll_us;
+extern uint64_t lag_poll_max_us;
+extern uint ps_mode;
+extern uint prepare_drop_pk;
+extern uint64_t warmup_time; // s
+extern uint64_t warmup_ops;
+extern double steady_cv;
+extern SweepMode sweep_mode;
+extern uint64_t sweep_step_time; // s
+extern char *dist_listen;
+extern char *dist_connect;
+extern ClientEngine engine;
+extern uint64_t async_threads;
 
 extern TestMode test_mode;
 
@@ -79,23 +120,35 @@ int main(int argc, char *argv[]) {
     free_option();
     return 1;
   }
+  if (dist_connect != nullptr && !dist_join()) {
+    free_option();
+    return 1;
+  }
 
-  if (!verify_variables()) {
+  if (!verify_variables() || !report_open()) {
     free_option();
     return 1;
   }
   mysql_library_init(0, NULL, NULL);
-  if (test_mode == TestMode::CONSISTENT) {
-    main_sct();
+  async_log_start();
+  install_stop_signals();
+  if (dist_listen != nullptr) {
+    ret = main_coordinator(argc, argv);
+  } else if (test_mode == TestMode::CONSISTENT) {
+    ret = main_sct();
   } else if (test_mode == TestMode::SHORT_CONNECT) {
-    main_shortct();
+    ret = main_shortct();
   } else if (test_mode == TestMode::REMAIN_QPS) {
-    main_remain_qps();
+    ret = main_remain_qps();
+  } else if (test_mode == TestMode::REPLAY) {
+    ret = main_replay();
   } else {
     std::cout << "wrong mode : " << test_mode << std::endl;
   }
 
+  async_log_stop();
   mysql_library_end();
+  report_close();
   free_option();
   return ret;
 }
@@ -103,16 +156,332 @@ int main(int argc, char *argv[]) {
 
 
 static Statistics state;
+static LatencyStats rw_latency;
+static LatencyStats ro_latency;
+// lag mode: cnt total is visible writes, cnt failed is timeouts.
+static Statistics lag_state;
+static LatencyStats lag_latency;
+// shared tables are prepared by all threads together in phases.
+static Barrier *prepare_barrier = nullptr;
+
+// per RO endpoint. checks: cnt total is reads checked, cnt failed is
+// inconsistent reads (lag mode: lag timeouts).
+struct ReplicaStats {
+  Statistics checks;
+  LatencyStats read_latency;
+  LatencyStats lag_latency;
+};
+static std::vector<ReplicaStats *> replica_stats;
+// --ro-barrier: cnt total is barriers applied, cnt failed is barriers that
+// timed out or failed, the latency is their cost per check.
+static Statistics barrier_state;
+static LatencyStats barrier_latency;
+// every thread starts testing at the same time, once all are prepared.
+static Barrier *start_barrier = nullptr;
+static std::atomic<uint64_t> run_start_us{0};
+// a session failed to connect, prepare or update, main_sct returns -1.
+static std::atomic_bool sct_failed{false};
+static WorkBudget *sct_budget = nullptr;
+// nullptr without --sweep.
+static SweepGate *sweep_gate = nullptr;
+// intervals whose tps must vary less than --steady-cv.
+static const size_t kSteadyWindow = 5;
+
+// the counters when the measured window started, after warmup and steady
+// state detection. The summary only reports what came after.
+struct SctBaseline {
+  explicit SctBaseline(size_t replicas)
+      : checks(replicas), read(replicas), replica_lag(replicas) {}
+
+  Statistics state;
+  Statistics lag_state;
+  Statistics barrier_state;
+  Histogram rw;
+  Histogram ro;
+  Histogram lag;
+  Histogram barrier;
+  std::vector<Statistics> checks;
+  std::vector<Histogram> read;
+  std::vector<Histogram> replica_lag;
+};
+
+static void take_baseline(SctBaseline &base) {
+  base.state = state;
+  base.lag_state = lag_state;
+  base.barrier_state = barrier_state;
+  rw_latency.snapshot(base.rw);
+  ro_latency.snapshot(base.ro);
+  lag_latency.snapshot(base.lag);
+  barrier_latency.snapshot(base.barrier);
+  for (size_t r = 0; r < replica_stats.size(); r++) {
+    base.checks[r] = replica_stats[r]->checks;
+    replica_stats[r]->read_latency.snapshot(base.read[r]);
+    replica_stats[r]->lag_latency.snapshot(base.replica_lag[r]);
+  }
+}
+
+// what stats recorded after base was taken.
+static void since(const LatencyStats &stats, const Histogram &base,
+                  Histogram &hist) {
+  stats.snapshot(hist);
+  hist.subtract(base);
+}
+
+// coefficient of variation of the interval tps.
+static double tps_cv(const std::deque<uint64_t> &tps) {
+  double mean = 0;
+  for (auto v : tps) {
+    mean += v;
+  }
+  mean /= tps.size();
+  if (mean == 0) {
+    return 0;
+  }
+  double var = 0;
+  for (auto v : tps) {
+    var += (v - mean) * (v - mean);
+  }
+  return sqrt(var / tps.size()) / mean;
+}
+
+// runs the sweep steps once all threads are prepared, then lets the threads
+// finish. Each step is measured from its own start, the samples of the step
+// before are left out.
+static void run_sweep() {
+  while (run_start_us.load() == 0 && active_threads.load() != 0) {
+    usleep(100000);
+  }
+  SweepSchedule schedule(sweep_mode, concurrency);
+  std::vector<SweepPoint> points;
+  IntervalHistogram rw_interval(rw_latency);
+  IntervalHistogram ro_interval(ro_latency);
+  IntervalHistogram lag_interval(lag_latency);
+  uint64_t workers = 0;
+  while (!stop_requested && active_threads.load() != 0 &&
+         (workers = schedule.next(points)) != 0) {
+    sweep_gate->open(workers);
+    rw_interval.next();
+    ro_interval.next();
+    lag_interval.next();
+    Statistics pre_state;
+    pre_state = state;
+    uint64_t start_us = now_us();
+    while (!stop_requested && now_us() - start_us < sweep_step_time * 1000000) {
+      usleep(100000);
+    }
+    double elapsed_s = (now_us() - start_us) / 1e6;
+    Statistics new_state;
+    new_state = state;
+    uint64_t total = new_state.get_cnt_total() - pre_state.get_cnt_total();
+    uint64_t failed = new_state.get_cnt_failed() - pre_state.get_cnt_failed();
+
+    SweepPoint point;
+    point.concurrency = workers;
+    point.tps = total / elapsed_s;
+    point.failed_pct = total ? failed * 100.0 / total : 0;
+    point.rw_p99 = rw_interval.next().percentile(99);
+    point.ro_p99 = ro_interval.next().percentile(99);
+    point.lag_p99 = lag_mode ? lag_interval.next().percentile(99) : 0;
+    points.push_back(point);
+
+    std::cout << "Sweep concurrency: " << workers << ", tps: " << point.tps
+              << ", failed: " << point.failed_pct
+              << "%, rw p99(us): " << point.rw_p99
+              << ", ro p99(us): " << point.ro_p99;
+    if (lag_mode) {
+      std::cout << ", lag p99(us): " << point.lag_p99;
+    }
+    std::cout << std::endl;
+    if (report_enabled()) {
+      ReportRecord *record = new ReportRecord("sweep");
+      record->add("concurrency", workers)
+          .add("tps", point.tps)
+          .add("failed_pct", point.failed_pct)
+          .add("rw_p99", point.rw_p99)
+          .add("ro_p99", point.ro_p99)
+          .add("lag_p99", point.lag_p99);
+      report_emit(record);
+    }
+  }
+  sweep_gate->finish();
+  print_sweep_curve(points);
+}
+
+// the cumulative counters of this process, for the coordinator.
+static void take_dist_snapshot(DistSnapshot &snap) {
+  Statistics cur;
+  cur = state;
+  snap.counters.push_back({"ops", cur.get_cnt_total()});
+  snap.counters.push_back({"failed", cur.get_cnt_failed()});
+  snap.hists.resize(2);
+  snap.hists[0].first = "rw_lat";
+  rw_latency.snapshot(snap.hists[0].second);
+  snap.hists[1].first = "ro_lat";
+  ro_latency.snapshot(snap.hists[1].second);
+  if (lag_mode) {
+    snap.hists.push_back({"lag", Histogram()});
+    lag_latency.snapshot(snap.hists.back().second);
+  }
+  if (ro_barrier != BARRIER_NONE) {
+    snap.hists.push_back({"barrier_lat", Histogram()});
+    barrier_latency.snapshot(snap.hists.back().second);
+  }
+}
+
+// with shared tables, process i of a distributed run works on its own slice
+// [key_begin, key_end) of the key space, so no two processes write a row.
+static uint64_t key_begin(uint64_t keys) {
+  return table_cnt > 0 ? keys * dist_index / dist_count : 0;
+}
+
+static uint64_t key_end(uint64_t keys) {
+  return table_cnt > 0 ? keys * (dist_index + 1) / dist_count : keys;
+}
+
+// the replicas a check reads, per --ro-pick.
+class ReplicaPicker {
+public:
+  explicit ReplicaPicker(uint64_t session) {
+    size_t replicas = ro_endpoints.size();
+    for (size_t r = 0; r < replicas; r++) {
+      m_order_.push_back(r);
+    }
+    m_rr_next_ = session % std::max<size_t>(replicas, 1);
+  }
+
+  // the replicas of the next check, the caller may shrink the list.
+  std::vector<size_t> &pick(FastRand &rand) {
+    size_t replicas = m_order_.size();
+    m_picked_.clear();
+    if (ro_pick == PICK_ALL) {
+      m_picked_ = m_order_;
+      return m_picked_;
+    }
+
+    if (ro_pick == PICK_ROUND_ROBIN) {
+      for (size_t i = 0; i < ro_subset; i++) {
+        m_picked_.push_back((m_rr_next_ + i) % replicas);
+      }
+      m_rr_next_ = (m_rr_next_ + 1) % replicas;
+      return m_picked_;
+    }
+
+    // random subset, a partial shuffle of all replicas.
+    for (size_t i = 0; i < ro_subset; i++) {
+      size_t j = i + rand.uniform(replicas - i);
+      std::swap(m_order_[i], m_order_[j]);
+      m_picked_.push_back(m_order_[i]);
+    }
+    return m_picked_;
+  }
+
+private:
+  std::vector<size_t> m_picked_;
+  std::vector<size_t> m_order_;
+  size_t m_rr_next_{0};
+};
+
+// what RW runs on a new connection so the gtid waits of --ro-barrier get
+// the GTID of its commits in the OK packet, empty if nothing.
+static string track_gtid_sql() {
+  if (ro_barrier == BARRIER_GTID_WAIT) {
+    return "set session session_track_gtids = OWN_GTID";
+  }
+  if (ro_barrier == BARRIER_MARIADB_GTID_WAIT) {
+    return "set session session_track_system_variables = 'last_gtid'";
+  }
+  return string();
+}
+
+/*
+  The GTID of the last update on conn from the OK packet. An update that
+  changed nothing has no GTID, and nothing to wait for.
+*/
+static string gtid_token(MYSQL *conn) {
+  const char *data = nullptr;
+  size_t len = 0;
+  string token;
+
+  if (ro_barrier == BARRIER_GTID_WAIT) {
+    if (mysql_session_track_get_first(conn, SESSION_TRACK_GTIDS, &data,
+                                      &len) == 0) {
+      token.assign(data, len);
+    }
+  } else if (ro_barrier == BARRIER_MARIADB_GTID_WAIT) {
+    // system variables come as name, value pairs.
+    int res = mysql_session_track_get_first(
+        conn, SESSION_TRACK_SYSTEM_VARIABLES, &data, &len);
+    while (res == 0) {
+      bool is_gtid = string(data, len) == "last_gtid";
+      res = mysql_session_track_get_next(conn, SESSION_TRACK_SYSTEM_VARIABLES,
+                                         &data, &len);
+      if (res == 0 && is_gtid) {
+        token.assign(data, len);
+        break;
+      }
+    }
+  }
+  return token;
+}
+
+// the --ro-barrier query run before a consistency read, empty if none.
+static string barrier_sql(const string &token) {
+  double timeout_s = ro_barrier_timeout_ms / 1000.0;
+  if (ro_barrier == BARRIER_GTID_WAIT && !token.empty()) {
+    return "select wait_for_executed_gtid_set('" + token + "', " +
+           std::to_string(timeout_s) + ")";
+  }
+  if (ro_barrier == BARRIER_MARIADB_GTID_WAIT && !token.empty()) {
+    return "select master_gtid_wait('" + token + "', " +
+           std::to_string(timeout_s) + ")";
+  }
+  if (ro_barrier == BARRIER_READ_SQL) {
+    return ro_barrier_sql;
+  }
+  return string();
+}
+
+// the gtid waits return 0 once the GTID was applied.
+static bool barrier_timed_out(MYSQL_RES *mysql_res) {
+  if (mysql_res == nullptr || ro_barrier == BARRIER_READ_SQL) {
+    return false;
+  }
+  MYSQL_ROW row = mysql_fetch_row(mysql_res);
+  return row == nullptr || row[0] == nullptr || strcmp(row[0], "0") != 0;
+}
 
+/*
+  Every operation picks a (table, pk) pair from the key space of all tables
+  the thread works on. With --table-cnt=0 that is the thread's own table,
+  otherwise the --table-cnt tables shared by all threads.
+
+  Rows of shared tables are written by several threads, so the value a
+  thread wrote may already be overwritten when it reads RO. There c1 only
+  grows: the new value is old + 1, written with greatest(), and RO is
+  consistent when it returns at least the value written.
+*/
 class TestC {
 public:
-  TestC(const char *db_name, string table_name, uint64_t times,
-        uint64_t table_size, uint64_t thread_id) {
+  TestC(const char *db_name, const std::vector<string> &tables,
+        uint64_t times, uint64_t table_size, uint64_t thread_id)
+      : m_key_base_(key_begin(tables.size() * table_size)),
+        m_keys_(key_end(tables.size() * table_size) - m_key_base_,
+                thread_id),
+        m_picker_(thread_id) {
     m_db_name_ = db_name;
-    m_table_name_ = table_name;
+    m_tables_ = tables;
     m_times_ = times;
     m_table_size_ = table_size;
     m_thread_id_ = thread_id;
+    m_shared_ = table_cnt > 0;
+    m_stmts_.resize(tables.size());
+
+    size_t replicas = ro_endpoints.size();
+    m_conns_ro_.resize(replicas, nullptr);
+    m_ro_stmts_.assign(replicas,
+                       std::vector<MYSQL_STMT *>(tables.size(), nullptr));
+    m_ro_vals_.resize(replicas, 0);
+    m_ro_res_.resize(replicas, 0);
   }
 
   int run();
@@ -121,96 +490,170 @@ public:
 private:
   int conns_prepare();
   void conns_close();
-  int data_prepare();
-  int test_select_after_insert(const uint64_t pk);
+  int data_prepare(int conn_res);
   int commit_conn_trx(MYSQL *conn);
-  int insert_test(uint64_t pk);
-  int update(uint64_t &pk, uint64_t &old_value, uint64_t &new_value);
-  int consistency_test(uint64_t pk, uint64_t old_value, uint64_t expected);
+  int insert_test(size_t table, uint64_t pk);
+  int update(size_t &table, uint64_t &pk, uint64_t &old_value,
+             uint64_t &new_value);
+  int consistency_test(size_t table, uint64_t pk, uint64_t old_value,
+                       uint64_t expected);
+  int read_ro_values(size_t table, uint64_t pk, uint64_t expected,
+                     const std::vector<size_t> &replicas);
+  int read_ro_result(size_t replica, const string &query, uint64_t expected);
+  int session_setup();
+  int apply_barrier(const std::vector<size_t> &replicas);
+  string replica_name(size_t replica) {
+    return ro_endpoints[replica].host + ":" +
+           std::to_string(ro_endpoints[replica].port);
+  }
+  int lag_test(size_t table, uint64_t pk, uint64_t old_value,
+               uint64_t expected);
+  string select_sql(size_t table, uint64_t pk);
+  bool visible(uint64_t ro_val, uint64_t expected) {
+    return m_shared_ ? ro_val >= expected : ro_val == expected;
+  }
+
+  // prepared statement mode, one set of statements per table, the RO
+  // selects are in m_ro_stmts_[replica][table].
+  struct TableStmts {
+    MYSQL_STMT *rw_select{nullptr};
+    MYSQL_STMT *rw_update{nullptr};
+  };
+  int stmts_prepare();
+  void stmts_close();
+  int stmt_prepare(MYSQL *conn, MYSQL_STMT *&stmt, const string &sql,
+                   MYSQL_BIND *params, MYSQL_BIND *result);
+  int stmt_run(MYSQL_STMT *stmt, uint64_t *value);
+  int ps_execute(MYSQL_STMT **slot, uint64_t *value);
 
   const char *m_db_name_;
-  string m_table_name_;
+  std::vector<string> m_tables_;
   uint64_t m_times_;
   uint64_t m_table_size_;
   uint64_t m_thread_id_;
+  bool m_shared_;
+  // m_keys_ picks keys from m_key_base_ on.
+  uint64_t m_key_base_;
+  KeyGenerator m_keys_;
 
   MYSQL *m_conn_rw_{nullptr};
-  MYSQL *m_conn_ro_{nullptr};
+  // one connection per RO endpoint.
+  std::vector<MYSQL *> m_conns_ro_;
+  ReplicaPicker m_picker_;
+  // what each replica read by the current check returned.
+  std::vector<uint64_t> m_ro_vals_;
+  std::vector<int> m_ro_res_;
+  // when the last RW update returned, the start of the visibility lag.
+  uint64_t m_commit_us_{0};
+  // the GTID of the last RW update, from the session tracker.
+  string m_token_;
+
+  // statements are prepared per connection and re-prepared on reconnect,
+  // the bind buffers below stay bound to them for their whole life.
+  std::vector<TableStmts> m_stmts_;
+  std::vector<std::vector<MYSQL_STMT *>> m_ro_stmts_;
+  MYSQL_BIND m_ps_params_[2];
+  MYSQL_BIND m_ps_result_;
+  uint64_t m_ps_value_{0};
+  uint64_t m_ps_pk_{0};
+  uint64_t m_ps_c1_{0};
+  my_bool m_ps_c1_null_{0};
 };
 
+// the tables of session or thread index. The own tables of all processes
+// of a distributed run are numbered through.
+static std::vector<string> session_tables(uint64_t index) {
+  std::vector<string> tables;
+  if (table_cnt == 0) {
+    tables.push_back(table_name_prefix +
+                     std::to_string(dist_index * concurrency + index));
+  } else {
+    for (uint i = 0; i < table_cnt; i++) {
+      tables.push_back(table_name_prefix + std::to_string(i));
+    }
+  }
+  return tables;
+}
+
 void start_test(int thread_id) {
   if (detail_log) {
-    std::cout << "start thread: " << thread_id << std::endl;
+    AsyncLog(LOG_INFO, LOG_SITE_THREAD) << "start thread: " << thread_id;
+  }
+  // before TestC and its connections are allocated, to keep them local.
+  pin_worker(thread_id);
+  TestC t(database, session_tables(thread_id), iterations, table_size,
+          thread_id);
+  if (t.run() != 0) {
+    sct_failed = true;
   }
-  string table_name = table_name_prefix + std::to_string(thread_id);
-  TestC t(database, table_name, iterations, table_size, thread_id);
-  t.run();
   t.cleanup();
   active_threads--;
 
   if (detail_log) {
-    std::cout << "stop thread: " << thread_id << std::endl;
+    AsyncLog(LOG_INFO, LOG_SITE_THREAD) << "stop thread: " << thread_id;
   }
   return;
 }
 
-int TestC::data_prepare() {
+static int create_table(MYSQL *conn, const string &table) {
   int res = 0;
-  string query = "drop table if exists " + m_table_name_;
-  res = mysql_query(m_conn_rw_, query.data());
+  string query = "drop table if exists " + table;
+  res = mysql_query(conn, query.data());
   if (res != 0) {
     std::cout << "Failed to drop table, sql: " << query
-              << ", errno: " << mysql_errno(m_conn_rw_)
-              << ", errmsg: " << mysql_error(m_conn_rw_) << std::endl;
+              << ", errno: " << mysql_errno(conn)
+              << ", errmsg: " << mysql_error(conn) << std::endl;
   }
 
-  query = "create table " + m_table_name_ +
-          " (id bigint not null primary key, c1 bigint)";
-  res = mysql_query(m_conn_rw_, query.data());
+  // with --prepare-drop-pk the pk is added after loading, which is much
+  // cheaper than maintaining it row by row on large tables.
+  query = "create table " + table +
+          (prepare_drop_pk ? " (id bigint not null, c1 bigint)"
+                           : " (id bigint not null primary key, c1 bigint)");
+  res = mysql_query(conn, query.data());
   if (res != 0) {
     std::cout << "Failed to create table, sql: " << query
-              << ", errno: " << mysql_errno(m_conn_rw_)
-              << ", errmsg: " << mysql_error(m_conn_rw_) << std::endl;
+              << ", errno: " << mysql_errno(conn)
+              << ", errmsg: " << mysql_error(conn) << std::endl;
   }
 
-  for (uint64_t pk = 1; pk <= m_table_size_; pk++) {
-    query = "insert into " + m_table_name_ + " values(" + std::to_string(pk) +
-            "," + "0)";
-    res = mysql_query(m_conn_rw_, query.data());
-    if (res != 0) {
-      std::cout << "Failed to insert, sql: " << query
-                << ", errno: " << mysql_errno(m_conn_rw_)
-                << ", errmsg: " << mysql_error(m_conn_rw_) << std::endl;
-      return res;
-    }
+  return res;
+}
 
-    if (select_after_insert) {
-      res = test_select_after_insert(pk);
-    }
+static int finish_table(MYSQL *conn, const string &table) {
+  int res = 0;
+  string query;
+
+  if (prepare_drop_pk) {
+    query = "alter table " + table + " add primary key (id)";
+    res = mysql_query(conn, query.data());
     if (res != 0) {
+      std::cout << "Failed to add primary key, sql: " << query
+                << ", errno: " << mysql_errno(conn)
+                << ", errmsg: " << mysql_error(conn) << std::endl;
       return res;
     }
   }
 
-  query = "select count(*) from " + m_table_name_;
-  res = mysql_query(m_conn_rw_, query.data());
+  query = "select count(*) from " + table;
+  res = mysql_query(conn, query.data());
   if (res != 0) {
     std::cout << "Failed to check the table size, errno: "
-              << mysql_errno(m_conn_rw_)
-              << ", errmsg: " << mysql_error(m_conn_rw_) << std::endl;
+              << mysql_errno(conn) << ", errmsg: " << mysql_error(conn)
+              << std::endl;
     return res;
   }
   MYSQL_RES *mysql_res = nullptr;
   MYSQL_ROW row;
-  mysql_res = mysql_store_result(m_conn_rw_);
+  mysql_res = mysql_store_result(conn);
   row = mysql_fetch_row(mysql_res);
   if (row[0] == nullptr) {
     std::cout << "Failed to check the table size." << std::endl;
   }
-  uint64_t table_size = strtoull(row[0], nullptr, 10);
-  if (table_size != m_table_size_) {
-    std::cout << "Failed to check the table size, " << m_table_name_
-              << " should be: " << m_table_size_ << ", but " << table_size
+  uint64_t rows = strtoull(row[0], nullptr, 10);
+  if (rows != table_size) {
+    std::cout << "Failed to check the table size, " << table
+              << " should be: " << table_size << ", but " << rows
               << std::endl;
   }
   mysql_free_result(mysql_res);
@@ -218,15 +661,75 @@ int TestC::data_prepare() {
   return res;
 }
 
+/*
+  Prepare tables as worker out of workers, conn_res is the result of
+  connecting conn. Own tables are prepared whole, worker takes tables
+  worker, worker + workers, ... Shared tables are prepared in phases by all
+  workers: each creates the tables it owns, then loads its slice of every
+  table, then adds the pk and checks the tables it owns, so a worker that
+  failed to connect still has to pass the barriers.
+*/
+static int prepare_tables(MYSQL *conn, const char *db,
+                          const std::vector<string> &tables, uint64_t worker,
+                          uint64_t workers, int conn_res) {
+  int res = conn_res;
+
+  if (table_cnt == 0) {
+    for (size_t i = worker; res == 0 && i < tables.size(); i += workers) {
+      res = create_table(conn, tables[i]);
+      if (res == 0) {
+        DataLoader loader(db, tables[i]);
+        res = loader.load(1, table_size);
+      }
+      if (res == 0) {
+        res = finish_table(conn, tables[i]);
+      }
+    }
+    return res;
+  }
+
+  for (size_t i = worker; res == 0 && i < tables.size(); i += workers) {
+    res = create_table(conn, tables[i]);
+  }
+  prepare_barrier->wait();
+
+  uint64_t first_pk = worker * table_size / workers + 1;
+  uint64_t last_pk = (worker + 1) * table_size / workers;
+  for (size_t i = 0; res == 0 && i < tables.size(); i++) {
+    DataLoader loader(db, tables[i]);
+    res = loader.load(first_pk, last_pk);
+  }
+  prepare_barrier->wait();
+
+  for (size_t i = worker; res == 0 && i < tables.size(); i += workers) {
+    res = finish_table(conn, tables[i]);
+  }
+  return res;
+}
+
+// conn_res is the result of conns_prepare(), the thread prepares its own
+// table alone and the shared tables with all other threads.
+int TestC::data_prepare(int conn_res) {
+  if (!m_shared_) {
+    return prepare_tables(m_conn_rw_, m_db_name_, m_tables_, 0, 1, conn_res);
+  }
+  return prepare_tables(m_conn_rw_, m_db_name_, m_tables_, m_thread_id_,
+                        concurrency, conn_res);
+}
+
 void TestC::conns_close() {
+  stmts_close();
+
   if (m_conn_rw_ != nullptr) {
     mysql_close(m_conn_rw_);
     m_conn_rw_ = nullptr;
   }
 
-  if (m_conn_ro_ != nullptr) {
-    mysql_close(m_conn_ro_);
-    m_conn_ro_ = nullptr;
+  for (auto &conn : m_conns_ro_) {
+    if (conn != nullptr) {
+      mysql_close(conn);
+      conn = nullptr;
+    }
   }
 }
 
@@ -236,34 +739,47 @@ int TestC::conns_prepare() {
     // Connect to RW
     m_conn_rw_ = mysql_init(0);
     if (m_conn_rw_ == nullptr) {
-      std::cerr << "Failed to init m_conn_rw_ " << std::endl;
+      AsyncLog(LOG_ERROR, LOG_SITE_CONNECT) << "Failed to init m_conn_rw_ ";
       res = -1;
       break;
     }
 
     if (!mysql_real_connect(m_conn_rw_, host_rw, user, password, m_db_name_,
                             port_rw, nullptr, 0)) {
-      std::cerr << "Failed to connect to RW."
-                << " errno: " << mysql_errno(m_conn_rw_)
-                << ",errmsg: " << mysql_error(m_conn_rw_) << std::endl;
+      AsyncLog(LOG_ERROR, LOG_SITE_CONNECT, mysql_errno(m_conn_rw_))
+          << "Failed to connect to RW. errno: " << mysql_errno(m_conn_rw_)
+          << ",errmsg: " << mysql_error(m_conn_rw_);
       res = -1;
       break;
     }
 
-    // Connection to RO
-    m_conn_ro_ = mysql_init(0);
-    if (m_conn_ro_ == nullptr) {
-      std::cerr << "Failed to init m_conn_ro_ " << std::endl;
-      res = -1;
+    // Connection to every RO
+    for (size_t r = 0; res == 0 && r < m_conns_ro_.size(); r++) {
+      MYSQL *&conn = m_conns_ro_[r];
+      conn = mysql_init(0);
+      if (conn == nullptr) {
+        AsyncLog(LOG_ERROR, LOG_SITE_CONNECT) << "Failed to init RO connection";
+        res = -1;
+        break;
+      }
+
+      if (!mysql_real_connect(conn, ro_endpoints[r].host.c_str(), user,
+                              password, m_db_name_, ro_endpoints[r].port,
+                              nullptr, 0)) {
+        AsyncLog(LOG_ERROR, LOG_SITE_CONNECT, mysql_errno(conn))
+            << "Failed to connect to RO " << replica_name(r)
+            << ". errno: " << mysql_errno(conn)
+            << ",errmsg: " << mysql_error(conn);
+        res = -1;
+        break;
+      }
+    }
+    if (res != 0) {
       break;
     }
 
-    if (!mysql_real_connect(m_conn_ro_, host_ro, user, password, m_db_name_,
-                            port_ro, nullptr, 0)) {
-      std::cout << "Failed to connect to RO."
-                << " errno: " << mysql_errno(m_conn_ro_)
-                << ",errmsg: " << mysql_error(m_conn_ro_);
-      res = -1;
+    res = session_setup();
+    if (res != 0) {
       break;
     }
 
@@ -272,97 +788,231 @@ int TestC::conns_prepare() {
     /*   std::cout << "Failed to set session  autocommit = 0" << std::endl; */
     /* } */
 
+    if (ps_mode) {
+      res = stmts_prepare();
+    }
   } while (0);
 
   return res;
 }
 
-int TestC::commit_conn_trx(MYSQL *conn) {
-  int res = 0;
-  res = mysql_query(conn, "commit");
-  if (res != 0) {
-    std::cerr << "Failed to commit, errno: " << mysql_errno(conn)
-              << ", errmsg: " << mysql_error(conn);
+int TestC::stmt_prepare(MYSQL *conn, MYSQL_STMT *&stmt, const string &sql,
+                        MYSQL_BIND *params, MYSQL_BIND *result) {
+  stmt = mysql_stmt_init(conn);
+  if (stmt == nullptr) {
+    AsyncLog(LOG_ERROR, LOG_SITE_STMT_PREPARE, mysql_errno(conn))
+        << "Failed to init stmt, errno: " << mysql_errno(conn)
+        << ", errmsg: " << mysql_error(conn);
+    return -1;
   }
 
-  return res;
-}
+  if (mysql_stmt_prepare(stmt, sql.data(), sql.size()) != 0 ||
+      mysql_stmt_bind_param(stmt, params) != 0 ||
+      (result != nullptr && mysql_stmt_bind_result(stmt, result) != 0)) {
+    AsyncLog(LOG_ERROR, LOG_SITE_STMT_PREPARE, mysql_stmt_errno(stmt))
+        << "Failed to prepare stmt, sql: " << sql
+        << ", errno: " << mysql_stmt_errno(stmt)
+        << ", errmsg: " << mysql_stmt_error(stmt);
+    return -1;
+  }
 
-int TestC::test_select_after_insert(const uint64_t pk) {
-  int res = 0;
-  string query;
-  MYSQL_RES *mysql_res = nullptr;
+  return 0;
+}
 
-  do {
-    query =
-        "select * from " + m_table_name_ + " where id = " + std::to_string(pk);
-    res = mysql_query(m_conn_ro_, query.data());
-    if (res != 0) {
-      std::cout << "Failed to select after insert, sql: " << query
-                << ", errno: " << mysql_errno(m_conn_ro_)
-                << ", errmsg: " << mysql_error(m_conn_ro_);
+int TestC::stmts_prepare() {
+  // m_ps_params_[0] is the new value, m_ps_params_[1] the pk, so the
+  // selects bind the tail of the array.
+  memset(m_ps_params_, 0, sizeof(m_ps_params_));
+  m_ps_params_[0].buffer_type = MYSQL_TYPE_LONGLONG;
+  m_ps_params_[0].buffer = &m_ps_value_;
+  m_ps_params_[0].is_unsigned = 1;
+  m_ps_params_[1].buffer_type = MYSQL_TYPE_LONGLONG;
+  m_ps_params_[1].buffer = &m_ps_pk_;
+  m_ps_params_[1].is_unsigned = 1;
+
+  memset(&m_ps_result_, 0, sizeof(m_ps_result_));
+  m_ps_result_.buffer_type = MYSQL_TYPE_LONGLONG;
+  m_ps_result_.buffer = &m_ps_c1_;
+  m_ps_result_.is_unsigned = 1;
+  m_ps_result_.is_null = &m_ps_c1_null_;
+
+  for (size_t i = 0; i < m_tables_.size(); i++) {
+    const string &table = m_tables_[i];
+    string select_sql = "select c1 from " + table + " where id = ?";
+    string update_sql =
+        "update " + table +
+        (m_shared_ ? " set c1 = greatest(c1, ?) where id = ?"
+                   : " set c1 = ? where id = ?");
+    TableStmts &stmts = m_stmts_[i];
+
+    if (stmt_prepare(m_conn_rw_, stmts.rw_select, select_sql,
+                     &m_ps_params_[1], &m_ps_result_) != 0 ||
+        stmt_prepare(m_conn_rw_, stmts.rw_update, update_sql, m_ps_params_,
+                     nullptr) != 0) {
+      return -1;
+    }
+    for (size_t r = 0; r < m_conns_ro_.size(); r++) {
+      if (stmt_prepare(m_conns_ro_[r], m_ro_stmts_[r][i], select_sql,
+                       &m_ps_params_[1], &m_ps_result_) != 0) {
+        return -1;
+      }
     }
+  }
 
-    mysql_res = mysql_store_result(m_conn_ro_);
+  return 0;
+}
 
-    if (mysql_res == nullptr) {
-      res = -1;
-      if (detail_log) {
-        std::cerr << "Failed to test consistency after insert, mysql res is "
-                     "nullptr, sql: "
-                  << query << std::endl;
+void TestC::stmts_close() {
+  for (auto &stmts : m_stmts_) {
+    MYSQL_STMT **all[] = {&stmts.rw_select, &stmts.rw_update};
+    for (auto stmt : all) {
+      if (*stmt != nullptr) {
+        mysql_stmt_close(*stmt);
+        *stmt = nullptr;
       }
-      break;
     }
-
-    if (mysql_res->row_count == 0) {
-      mysql_free_result(mysql_res);
-      if (detail_log) {
-        std::cerr << "Failed to test consistency after insert, mysql res "
-                     "row_count is 0, sql: "
-                  << query << std::endl;
+  }
+  for (auto &replica : m_ro_stmts_) {
+    for (auto &stmt : replica) {
+      if (stmt != nullptr) {
+        mysql_stmt_close(stmt);
+        stmt = nullptr;
       }
-      break;
     }
+  }
+}
 
-    mysql_free_result(mysql_res);
-  } while (0);
+/*
+  Execute a prepared statement with the current bind buffers, fetch the
+  single c1 value into *value if value is not nullptr. Returns 1 if the row
+  does not exist.
+*/
+int TestC::stmt_run(MYSQL_STMT *stmt, uint64_t *value) {
+  if (stmt == nullptr || mysql_stmt_execute(stmt) != 0) {
+    return -1;
+  }
+
+  if (value == nullptr) {
+    return 0;
+  }
+
+  if (mysql_stmt_store_result(stmt) != 0) {
+    return -1;
+  }
+  int res = mysql_stmt_fetch(stmt);
+  mysql_stmt_free_result(stmt);
+  if (res == MYSQL_NO_DATA || (res == 0 && m_ps_c1_null_)) {
+    return 1;
+  }
+  if (res != 0) {
+    return -1;
+  }
+
+  *value = m_ps_c1_;
+  return 0;
+}
+
+/*
+  Run the prepared statement in *slot, if the connection was lost or the
+  server dropped the statement, reconnect (which prepares all statements
+  into their slots again) and retry once.
+*/
+int TestC::ps_execute(MYSQL_STMT **slot, uint64_t *value) {
+  for (int retry = 0;; retry++) {
+    MYSQL_STMT *stmt = *slot;
+    int res = stmt_run(stmt, value);
+    if (res >= 0) {
+      return res;
+    }
+
+    unsigned int err = stmt ? mysql_stmt_errno(stmt) : CR_SERVER_GONE_ERROR;
+    bool reconnect = err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST ||
+                     err == ER_UNKNOWN_STMT_HANDLER ||
+                     err == ER_NEED_REPREPARE;
+    if (!reconnect || retry > 0) {
+      AsyncLog(LOG_ERROR, LOG_SITE_STMT_EXECUTE, err)
+          << "Failed to execute stmt, errno: " << err << ", errmsg: "
+          << (stmt ? mysql_stmt_error(stmt) : "");
+      return res;
+    }
+
+    if (detail_log) {
+      AsyncLog(LOG_ERROR, LOG_SITE_STMT_REPREPARE, err)
+          << "Reconnect and prepare stmts again, errno: " << err;
+    }
+    conns_close();
+    if (conns_prepare() != 0) {
+      return res;
+    }
+  }
+}
+
+int TestC::commit_conn_trx(MYSQL *conn) {
+  int res = 0;
+  res = mysql_query(conn, "commit");
+  if (res != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_COMMIT, mysql_errno(conn))
+        << "Failed to commit, errno: " << mysql_errno(conn) << ", errmsg: "
+        << mysql_error(conn);
+  }
 
-  commit_conn_trx(m_conn_ro_);
   return res;
 }
 
-int TestC::insert_test(uint64_t pk) {
+int TestC::insert_test(size_t table, uint64_t pk) {
   int res = 0;
-  string query = "insert into " + m_table_name_ + " values(" +
-                 std::to_string(pk) + "," + "0)";
+  string query = sct_insert_sql(m_tables_[table], pk);
   res = mysql_query(m_conn_rw_, query.data());
   if (res != 0) {
-    std::cerr << "Failed to insert, sql: " << query
-              << ", errno: " << mysql_errno(m_conn_rw_)
-              << ", errmsg: " << mysql_error(m_conn_rw_) << std::endl;
+    AsyncLog(LOG_ERROR, LOG_SITE_INSERT, mysql_errno(m_conn_rw_))
+        << "Failed to insert, sql: " << query << ", errno: "
+        << mysql_errno(m_conn_rw_) << ", errmsg: " << mysql_error(m_conn_rw_);
   }
 
   return res;
 }
 
-int TestC::update(uint64_t &pk, uint64_t &old_value, uint64_t &new_value) {
+int TestC::update(size_t &table, uint64_t &pk, uint64_t &old_value,
+                  uint64_t &new_value) {
   int res = 0;
   MYSQL_RES *mysql_res = nullptr;
   MYSQL_ROW row;
   string query;
 
-  pk = rand() % m_table_size_ + 1;
-  new_value = rand() % m_table_size_;
+  uint64_t key = m_keys_.next();
+  table = (m_key_base_ + key) / m_table_size_;
+  pk = (m_key_base_ + key) % m_table_size_ + 1;
+  new_value = m_keys_.rand().uniform(m_table_size_);
+
+  if (ps_mode) {
+    m_ps_pk_ = pk;
+    res = ps_execute(&m_stmts_[table].rw_select, &old_value);
+    if (res != 0) {
+      if (res > 0 && detail_log) {
+        AsyncLog(LOG_ERROR, LOG_SITE_RW_ROW) << "RW row is nullptr, pk: " << pk;
+      }
+      return -1;
+    }
+
+    if (m_shared_) {
+      new_value = old_value + 1;
+    }
+    m_ps_value_ = new_value;
+    m_ps_pk_ = pk;
+    res = ps_execute(&m_stmts_[table].rw_update, nullptr);
+    m_commit_us_ = now_us();
+    m_token_ = gtid_token(m_conn_rw_);
+    m_keys_.written(key);
+    return res;
+  }
 
-  query =
-      "select c1 from " + m_table_name_ + " where id = " + std::to_string(pk);
+  query = select_sql(table, pk);
 
   res = mysql_query(m_conn_rw_, query.data());
   if (res != 0) {
-    std::cout << "Failed to test consistency, sql: " << query
-              << ", errno: " << mysql_errno(m_conn_rw_)
-              << ", errmsg: " << mysql_error(m_conn_rw_);
+    AsyncLog(LOG_ERROR, LOG_SITE_RW_SELECT, mysql_errno(m_conn_rw_))
+        << "Failed to select the row on RW, sql: " << query << ", errno: "
+        << mysql_errno(m_conn_rw_) << ", errmsg: " << mysql_error(m_conn_rw_);
     return -1;
   }
 
@@ -371,7 +1021,7 @@ int TestC::update(uint64_t &pk, uint64_t &old_value, uint64_t &new_value) {
   row = mysql_fetch_row(mysql_res);
   if (row == nullptr) {
     if (detail_log) {
-      std::cerr << "RW row is nullptr, expected: " << std::endl;
+      AsyncLog(LOG_ERROR, LOG_SITE_RW_ROW) << "RW row is nullptr, expected: ";
     }
     res = -1;
     return res;
@@ -380,88 +1030,325 @@ int TestC::update(uint64_t &pk, uint64_t &old_value, uint64_t &new_value) {
   old_value = strtoull(row[0], nullptr, 10);
   mysql_free_result(mysql_res);
 
-  query = "update " + m_table_name_ + " set c1 = " + std::to_string(new_value) +
-          " where id = " + std::to_string(pk);
+  if (m_shared_) {
+    new_value = old_value + 1;
+  }
+  query = sct_update_sql(m_tables_[table], pk, new_value, m_shared_);
 
   res = mysql_query(m_conn_rw_, query.data());
   if (res != 0) {
-    std::cerr << "Failed to update, sql: " << query
-              << ", errno: " << mysql_errno(m_conn_rw_)
-              << ", error: " << mysql_error(m_conn_rw_);
+    AsyncLog(LOG_ERROR, LOG_SITE_UPDATE, mysql_errno(m_conn_rw_))
+        << "Failed to update, sql: " << query << ", errno: "
+        << mysql_errno(m_conn_rw_) << ", error: " << mysql_error(m_conn_rw_);
   }
+  m_commit_us_ = now_us();
+  m_token_ = gtid_token(m_conn_rw_);
+  m_keys_.written(key);
   return res;
 }
 
-int TestC::consistency_test(uint64_t pk, uint64_t old_value,
-                            uint64_t expected) {
+string TestC::select_sql(size_t table, uint64_t pk) {
+  return sct_select_sql(m_tables_[table], pk);
+}
+
+/*
+  --ro-barrier setup of new connections: the gtid waits need RW to send the
+  GTID of its commits in the OK packet, the session barrier runs its sql
+  once on every RO connection.
+*/
+int TestC::session_setup() {
+  string query = track_gtid_sql();
+  if (!query.empty() && mysql_query(m_conn_rw_, query.data()) != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_TRACK_GTID, mysql_errno(m_conn_rw_))
+        << "Failed to track gtid, sql: " << query << ", errno: "
+        << mysql_errno(m_conn_rw_) << ", errmsg: " << mysql_error(m_conn_rw_);
+    return -1;
+  }
+
+  if (ro_barrier != BARRIER_SESSION_SQL) {
+    return 0;
+  }
+  for (size_t r = 0; r < m_conns_ro_.size(); r++) {
+    if (mysql_query(m_conns_ro_[r], ro_barrier_sql) != 0) {
+      AsyncLog(LOG_ERROR, LOG_SITE_RO_SESSION, mysql_errno(m_conns_ro_[r]))
+          << "Failed to run ro-barrier-sql, RO: " << replica_name(r)
+          << ", sql: " << ro_barrier_sql << ", errno: "
+          << mysql_errno(m_conns_ro_[r]) << ", errmsg: "
+          << mysql_error(m_conns_ro_[r]);
+      return -1;
+    }
+    mysql_free_result(mysql_store_result(m_conns_ro_[r]));
+  }
+  return 0;
+}
+
+/*
+  Run the --ro-barrier on the replicas before the consistency read, sent to
+  all of them before any result is read. A barrier that times out is counted
+  and the read goes on, a failed one fails the check.
+*/
+int TestC::apply_barrier(const std::vector<size_t> &replicas) {
+  string query = barrier_sql(m_token_);
+  if (query.empty()) {
+    return 0;
+  }
+
   int res = 0;
+  bool timeout = false;
+  uint64_t start_us = now_us();
+  for (size_t r : replicas) {
+    m_ro_res_[r] = mysql_send_query(m_conns_ro_[r], query.data(), query.size());
+  }
+  for (size_t r : replicas) {
+    MYSQL *conn = m_conns_ro_[r];
+    if (m_ro_res_[r] != 0 || mysql_read_query_result(conn) != 0) {
+      AsyncLog(LOG_ERROR, LOG_SITE_RO_BARRIER, mysql_errno(conn))
+          << "Failed to apply ro barrier, RO: " << replica_name(r) << ", sql: "
+          << query << ", errno: " << mysql_errno(conn) << ", errmsg: "
+          << mysql_error(conn);
+      res = -1;
+      continue;
+    }
+
+    MYSQL_RES *mysql_res = mysql_store_result(conn);
+    if (barrier_timed_out(mysql_res)) {
+      timeout = true;
+      if (detail_log) {
+        AsyncLog(LOG_ERROR, LOG_SITE_RO_BARRIER_TIMEOUT)
+            << "RO barrier timeout, RO: " << replica_name(r) << ", sql: "
+            << query;
+      }
+    }
+    mysql_free_result(mysql_res);
+  }
+
+  barrier_latency.record(m_thread_id_, now_us() - start_us);
+  barrier_state.increase_cnt_total();
+  if (res != 0 || timeout) {
+    barrier_state.increase_cnt_failed();
+  }
+  return res;
+}
+
+int TestC::read_ro_result(size_t replica, const string &query,
+                          uint64_t expected) {
+  MYSQL *conn = m_conns_ro_[replica];
   MYSQL_RES *mysql_res = nullptr;
   MYSQL_ROW row;
-  uint64_t ro_val;
-  bool failed = false;
-  string query =
-      "select c1 from " + m_table_name_ + " where id = " + std::to_string(pk);
-  do {
-    res = mysql_query(m_conn_ro_, query.data());
-    if (res != 0) {
-      std::cerr << "Failed to test consistency, sql: " << query
-                << ", errno: " << mysql_errno(m_conn_ro_)
-                << ", errmsg: " << mysql_error(m_conn_ro_);
-      break;
-    }
 
-    mysql_res = mysql_store_result(m_conn_ro_);
+  if (mysql_read_query_result(conn) != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_RO_READ, mysql_errno(conn))
+        << "Failed to test consistency, RO: " << replica_name(replica)
+        << ", sql: " << query << ", errno: " << mysql_errno(conn)
+        << ", errmsg: " << mysql_error(conn);
+    return -1;
+  }
+
+  mysql_res = mysql_store_result(conn);
 
-    row = mysql_fetch_row(mysql_res);
-    if (row == nullptr) {
-      if (detail_log) {
-        std::cerr << "RO row is nullptr, expected: " << expected << std::endl;
+  row = mysql_fetch_row(mysql_res);
+  if (row == nullptr || row[0] == nullptr) {
+    if (detail_log) {
+      AsyncLog(LOG_ERROR, LOG_SITE_RO_ROW)
+          << "RO row is nullptr, RO: " << replica_name(replica)
+          << ", expected: " << expected;
+    }
+    mysql_free_result(mysql_res);
+    return -1;
+  }
+  m_ro_vals_[replica] = strtoull(row[0], nullptr, 10);
+  mysql_free_result(mysql_res);
+  return 0;
+}
+
+/*
+  Read the row from the given replicas into m_ro_vals_, with the result of
+  each replica in m_ro_res_. The select is sent to all of them before any
+  result is read, so the replicas run it at the same time. Returns -1 if any
+  replica failed.
+*/
+int TestC::read_ro_values(size_t table, uint64_t pk, uint64_t expected,
+                          const std::vector<size_t> &replicas) {
+  int res = 0;
+  uint64_t start_us = now_us();
+
+  if (ps_mode) {
+    // statements execute synchronously, the replicas are read one by one.
+    for (size_t r : replicas) {
+      m_ps_pk_ = pk;
+      m_ro_res_[r] = ps_execute(&m_ro_stmts_[r][table], &m_ro_vals_[r]);
+      if (m_ro_res_[r] > 0) {
+        if (detail_log) {
+          AsyncLog(LOG_ERROR, LOG_SITE_RO_ROW)
+              << "RO row is nullptr, RO: " << replica_name(r) << ", expected: "
+              << expected;
+        }
+        m_ro_res_[r] = -1;
+      }
+      uint64_t cur_us = now_us();
+      replica_stats[r]->read_latency.record(m_thread_id_, cur_us - start_us);
+      start_us = cur_us;
+      if (m_ro_res_[r] != 0) {
+        res = -1;
       }
+    }
+    return res;
+  }
+
+  string query = select_sql(table, pk);
+  for (size_t r : replicas) {
+    m_ro_res_[r] = mysql_send_query(m_conns_ro_[r], query.data(), query.size());
+    if (m_ro_res_[r] != 0) {
+      AsyncLog(LOG_ERROR, LOG_SITE_RO_READ, mysql_errno(m_conns_ro_[r]))
+          << "Failed to test consistency, RO: " << replica_name(r) << ", sql: "
+          << query << ", errno: " << mysql_errno(m_conns_ro_[r])
+          << ", errmsg: " << mysql_error(m_conns_ro_[r]);
+      m_ro_res_[r] = -1;
+    }
+  }
+  for (size_t r : replicas) {
+    if (m_ro_res_[r] == 0) {
+      m_ro_res_[r] = read_ro_result(r, query, expected);
+    }
+    replica_stats[r]->read_latency.record(m_thread_id_, now_us() - start_us);
+    if (m_ro_res_[r] != 0) {
       res = -1;
-      break;
     }
-    ro_val = strtoull(row[0], nullptr, 10);
-    mysql_free_result(mysql_res);
-    mysql_res = nullptr;
-    if (ro_val != expected) {
+  }
+  return res;
+}
+
+int TestC::consistency_test(size_t table, uint64_t pk, uint64_t old_value,
+                            uint64_t expected) {
+  int res = 0;
+  bool inconsistent = false;
+
+  if (lag_mode) {
+    return lag_test(table, pk, old_value, expected);
+  }
+
+  std::vector<size_t> &picked = m_picker_.pick(m_keys_.rand());
+  if (apply_barrier(picked) != 0) {
+    return -1;
+  }
+  read_ro_values(table, pk, expected, picked);
+  for (size_t r : picked) {
+    if (m_ro_res_[r] != 0) {
+      res = -1;
+      continue;
+    }
+
+    replica_stats[r]->checks.increase_cnt_total();
+    if (!visible(m_ro_vals_[r], expected)) {
+      replica_stats[r]->checks.increase_cnt_failed();
       if (detail_log) {
-        std::cerr << "RO val: " << ro_val << ", expected: " << expected
-                  << ", RW old: " << old_value << ", query: " << query
-                  << std::endl;
+        AsyncLog(LOG_ERROR, LOG_SITE_RO_STALE)
+            << "RO: " << replica_name(r) << ", RO val: " << m_ro_vals_[r]
+            << ", expected: " << expected << ", RW old: " << old_value
+            << ", query: " << select_sql(table, pk);
       }
-      failed = true;
       res = -1;
-      if (sleep_after_sct_failed > 0) {
-        sleep(sleep_after_sct_failed);
+      inconsistent = true;
+    }
+  }
+
+  if (inconsistent && sleep_after_sct_failed > 0) {
+    sleep(sleep_after_sct_failed);
+  }
+
+  return res;
+}
+
+/*
+  Poll the picked replicas until the value written by update() shows up on
+  all of them. The time from the RW commit returning to a replica returning
+  the new value is its visibility lag, the lag of the write is the slowest
+  replica.
+*/
+int TestC::lag_test(size_t table, uint64_t pk, uint64_t old_value,
+                    uint64_t expected) {
+  uint64_t backoff_us = lag_poll_us;
+
+  std::vector<size_t> &pending = m_picker_.pick(m_keys_.rand());
+  if (apply_barrier(pending) != 0) {
+    return -1;
+  }
+  while (true) {
+    if (read_ro_values(table, pk, expected, pending) != 0) {
+      return -1;
+    }
+
+    uint64_t elapsed_us = now_us() - m_commit_us_;
+    size_t still_pending = 0;
+    for (size_t r : pending) {
+      if (visible(m_ro_vals_[r], expected)) {
+        replica_stats[r]->lag_latency.record(m_thread_id_, elapsed_us);
+        replica_stats[r]->checks.increase_cnt_total();
+      } else {
+        pending[still_pending++] = r;
       }
     }
+    pending.resize(still_pending);
 
-    if (failed) {
-      res = -1;
+    if (pending.empty()) {
+      lag_latency.record(m_thread_id_, elapsed_us);
+      lag_state.increase_cnt_total();
+      return 0;
     }
 
-  } while (0);
+    if (elapsed_us >= lag_timeout_us) {
+      for (size_t r : pending) {
+        replica_stats[r]->checks.increase_cnt_total();
+        replica_stats[r]->checks.increase_cnt_failed();
+        if (detail_log) {
+          AsyncLog(LOG_ERROR, LOG_SITE_RO_LAG_TIMEOUT)
+              << "RO lag timeout after " << elapsed_us << "us, RO: "
+              << replica_name(r) << ", RO val: " << m_ro_vals_[r]
+              << ", expected: " << expected << ", RW old: " << old_value
+              << ", query: " << select_sql(table, pk);
+        }
+      }
+      lag_state.increase_cnt_failed();
+      if (sleep_after_sct_failed > 0) {
+        sleep(sleep_after_sct_failed);
+      }
+      return -1;
+    }
 
-  return res;
+    if (backoff_us != 0) {
+      usleep(backoff_us);
+      backoff_us = std::min(backoff_us * 2, lag_poll_max_us);
+    }
+  }
 }
 
 int TestC::run() {
   int res = 0;
+  size_t table = 0;
   uint64_t pk = 0;
   uint64_t old_val = 0;
   uint64_t new_val = 0;
-  if ((res = conns_prepare()) != 0) {
-    return -1;
-  }
+  res = conns_prepare();
 
-  if (!skip_prepare){
+  // shared tables of a distributed run are prepared by the first process,
+  // the coordinator starts the others once it is done.
+  if (!skip_prepare && (res == 0 || m_shared_) &&
+      (!m_shared_ || dist_index == 0)) {
     if (detail_log) {
-      std::cout << "thread id: " << m_thread_id_ << " data preparing." << std::endl;
+      AsyncLog(LOG_INFO, LOG_SITE_THREAD)
+          << "thread id: " << m_thread_id_ << " data preparing.";
     }
 
-    if ((res = data_prepare() != 0)) {
-      return -1;
-    }
+    res = data_prepare(res);
+  }
+
+  // threads that failed pass the barrier too, or the others would wait
+  // forever.
+  start_barrier->wait();
+  uint64_t unset = 0;
+  run_start_us.compare_exchange_strong(unset, now_us());
+  if (res != 0) {
+    return -1;
   }
 
   if (short_connection) {
@@ -470,22 +1357,37 @@ int TestC::run() {
 
   running_threads++;
 
-  while (processed_times++ < iterations) {
+  WorkerCpuTime cpu_time(m_thread_id_);
+  WorkClaim claim(*sct_budget);
+  uint64_t deadline_us =
+      test_time != 0 ? run_start_us.load() + test_time * 1000000 : 0;
+  while (!stop_requested && claim.next()) {
+    if (deadline_us != 0 && now_us() >= deadline_us) {
+      break;
+    }
+    // idle sweep workers keep their connections until their step.
+    if (sweep_gate != nullptr && !sweep_gate->wait(m_thread_id_)) {
+      break;
+    }
     if (short_connection) {
       conns_prepare();
     }
     state.increase_cnt_total();
-    res = update(pk, old_val, new_val);
+    uint64_t start_us = now_us();
+    res = update(table, pk, old_val, new_val);
     if (res != 0) {
       conns_close();
       return -1;
     }
+    rw_latency.record(m_thread_id_, now_us() - start_us);
 
     if (sc_gap_us != 0) {
       usleep(sc_gap_us);
     }
 
-    res = consistency_test(pk, old_val, new_val);
+    start_us = now_us();
+    res = consistency_test(table, pk, old_val, new_val);
+    ro_latency.record(m_thread_id_, now_us() - start_us);
     if (res != 0) {
       state.increase_cnt_failed();
     }
@@ -497,60 +1399,960 @@ int TestC::run() {
   running_threads--;
 
   if (detail_log) {
-    std::cout << "thread id: " << m_thread_id_ << " finish." << std::endl;
+    AsyncLog(LOG_INFO, LOG_SITE_THREAD)
+        << "thread id: " << m_thread_id_ << " finish.";
   }
-  return res;
+  // an inconsistent read is a result of the test, not a failure of it.
+  return 0;
 }
 
 int TestC::cleanup() {
-  if (m_conn_rw_ != nullptr) {
-    mysql_close(m_conn_rw_);
-    m_conn_rw_ = nullptr;
+  conns_close();
+  mysql_thread_end();
+  return 0;
+}
+
+#ifdef MYSQL_WAIT_READ
+
+enum AsyncSctState {
+  SCT_CONNECT, // RW and every RO connecting at once
+  SCT_SETUP,   // session_setup() queries
+  SCT_SELECT,  // RW select of the row
+  SCT_UPDATE,  // RW update of the row
+  SCT_GAP,     // waiting --sc-gap-us
+  SCT_BARRIER, // --ro-barrier on the picked replicas
+  SCT_READ,    // the picked replicas read the row
+  SCT_BACKOFF, // lag mode, waiting to poll again
+  SCT_PAUSE,   // waiting --sleep-after-sct-failed
+  SCT_CLOSE,   // closing the connections
+  SCT_DONE,
+};
+
+/*
+  One sct session of --engine=async, the steps of TestC::run as a state
+  machine. The barrier and the reads go to all picked replicas at once and
+  each replica's read latency is its own. Statistics are recorded in the
+  slot of the loop.
+*/
+class AsyncTestC : public AsyncTask {
+public:
+  AsyncTestC(AsyncLoop &loop, const std::vector<string> &tables,
+             uint64_t session)
+      : m_loop_(loop), m_slot_(loop.index()), m_tables_(tables),
+        m_shared_(table_cnt > 0),
+        m_key_base_(key_begin(tables.size() * table_size)),
+        m_keys_(key_end(tables.size() * table_size) - m_key_base_, session),
+        m_picker_(session), m_rw_(loop, *this), m_claim_(*sct_budget) {
+    for (size_t r = 0; r < ro_endpoints.size(); r++) {
+      m_ro_.emplace_back(new AsyncChannel(loop, *this));
+    }
+    m_ro_vals_.resize(ro_endpoints.size(), 0);
+    m_ro_res_.resize(ro_endpoints.size(), 0);
   }
 
-  if (m_conn_ro_ != nullptr) {
-    mysql_close(m_conn_ro_);
-    m_conn_ro_ = nullptr;
+  void start() override;
+  void on_timer() override;
+  void on_done(AsyncChannel &channel) override;
+  void on_stop() override;
+
+private:
+  void connect_all();
+  void connect_done(AsyncChannel &channel);
+  void setup_done(AsyncChannel &channel);
+  void conns_ready();
+  void next_op();
+  void begin_op();
+  void select_done();
+  void update_done();
+  void check();
+  void barrier_done(size_t replica);
+  void read();
+  void read_done(size_t replica);
+  void evaluate();
+  void end_check(bool ok, bool pause);
+  void end_op();
+  void close_all();
+  void close_done();
+  void finish_session();
+  size_t replica_of(const AsyncChannel &channel) const;
+  string replica_name(size_t replica) const {
+    return ro_endpoints[replica].host + ":" +
+           std::to_string(ro_endpoints[replica].port);
+  }
+  bool visible(uint64_t ro_val, uint64_t expected) const {
+    return m_shared_ ? ro_val >= expected : ro_val == expected;
+  }
+
+  AsyncLoop &m_loop_;
+  size_t m_slot_;
+  std::vector<string> m_tables_;
+  bool m_shared_;
+  uint64_t m_key_base_;
+  KeyGenerator m_keys_;
+  ReplicaPicker m_picker_;
+  AsyncChannel m_rw_;
+  std::vector<std::unique_ptr<AsyncChannel>> m_ro_;
+  WorkClaim m_claim_;
+  AsyncSctState m_state_{SCT_CONNECT};
+  // operations of the current step still in flight, and if one failed.
+  size_t m_pending_{0};
+  bool m_failed_{false};
+  bool m_timeout_{false};
+  // the session ends once its connections are closed.
+  bool m_finishing_{false};
+
+  size_t m_table_{0};
+  uint64_t m_pk_{0};
+  uint64_t m_key_{0};
+  uint64_t m_old_value_{0};
+  uint64_t m_new_value_{0};
+  std::vector<size_t> *m_picked_{nullptr};
+  std::vector<uint64_t> m_ro_vals_;
+  std::vector<int> m_ro_res_;
+  // the queries in flight, they stay here until their operations finish.
+  string m_rw_sql_;
+  string m_ro_sql_;
+  string m_token_;
+  uint64_t m_op_start_us_{0};
+  uint64_t m_commit_us_{0};
+  uint64_t m_check_start_us_{0};
+  uint64_t m_step_start_us_{0};
+  uint64_t m_backoff_us_{0};
+};
+
+void AsyncTestC::start() {
+  running_threads++;
+  if (short_connection) {
+    next_op();
+  } else {
+    connect_all();
+  }
+}
+
+void AsyncTestC::on_timer() {
+  switch (m_state_) {
+  case SCT_GAP:
+    check();
+    return;
+  case SCT_BACKOFF:
+    read();
+    return;
+  case SCT_PAUSE:
+    end_op();
+    return;
+  default:
+    return;
+  }
+}
+
+void AsyncTestC::on_stop() {
+  if (m_state_ == SCT_PAUSE) {
+    m_loop_.set_timer(*this, 0);
+    end_op();
+  }
+}
+
+void AsyncTestC::on_done(AsyncChannel &channel) {
+  switch (m_state_) {
+  case SCT_CONNECT:
+    connect_done(channel);
+    return;
+  case SCT_SETUP:
+    setup_done(channel);
+    return;
+  case SCT_SELECT:
+    select_done();
+    return;
+  case SCT_UPDATE:
+    update_done();
+    return;
+  case SCT_BARRIER:
+    barrier_done(replica_of(channel));
+    return;
+  case SCT_READ:
+    read_done(replica_of(channel));
+    return;
+  case SCT_CLOSE:
+    close_done();
+    return;
+  default:
+    return;
+  }
+}
+
+size_t AsyncTestC::replica_of(const AsyncChannel &channel) const {
+  size_t r = 0;
+  while (m_ro_[r].get() != &channel) {
+    r++;
+  }
+  return r;
+}
+
+void AsyncTestC::connect_all() {
+  m_state_ = SCT_CONNECT;
+  m_pending_ = 1 + m_ro_.size();
+  m_failed_ = false;
+  m_rw_.connect(host_rw, port_rw, database);
+  for (size_t r = 0; r < m_ro_.size(); r++) {
+    m_ro_[r]->connect(ro_endpoints[r].host.c_str(), ro_endpoints[r].port,
+                      database);
+  }
+}
+
+// the channels log a failed connect.
+void AsyncTestC::connect_done(AsyncChannel &channel) {
+  if (channel.err() != 0) {
+    m_failed_ = true;
+  }
+  if (--m_pending_ > 0) {
+    return;
+  }
+  if (m_failed_) {
+    finish_session();
+    return;
+  }
+
+  // the setup of TestC::session_setup, on all connections at once.
+  m_state_ = SCT_SETUP;
+  m_rw_sql_ = track_gtid_sql();
+  if (!m_rw_sql_.empty()) {
+    m_rw_.query(m_rw_sql_.data(), m_rw_sql_.size());
+    m_pending_++;
+  }
+  if (ro_barrier == BARRIER_SESSION_SQL) {
+    for (auto &ro : m_ro_) {
+      ro->query(ro_barrier_sql, strlen(ro_barrier_sql));
+      m_pending_++;
+    }
+  }
+  if (m_pending_ == 0) {
+    conns_ready();
+  }
+}
+
+void AsyncTestC::setup_done(AsyncChannel &channel) {
+  unsigned int err = channel.err();
+  if (err != 0) {
+    m_failed_ = true;
+    if (&channel == &m_rw_) {
+      AsyncLog(LOG_ERROR, LOG_SITE_TRACK_GTID, err)
+          << "Failed to track gtid, sql: " << m_rw_sql_ << ", errno: " << err
+          << ", errmsg: " << mysql_error(channel.conn());
+    } else {
+      AsyncLog(LOG_ERROR, LOG_SITE_RO_SESSION, err)
+          << "Failed to run ro-barrier-sql, RO: "
+          << replica_name(replica_of(channel)) << ", sql: " << ro_barrier_sql
+          << ", errno: " << err << ", errmsg: " << mysql_error(channel.conn());
+    }
+  }
+  channel.free_result();
+  if (--m_pending_ > 0) {
+    return;
+  }
+  if (m_failed_) {
+    finish_session();
+    return;
+  }
+  conns_ready();
+}
+
+void AsyncTestC::conns_ready() {
+  if (short_connection) {
+    begin_op();
+  } else {
+    next_op();
+  }
+}
+
+// the checks of TestC::run before an operation and its key. With
+// --short-connection the connections are opened first.
+void AsyncTestC::next_op() {
+  uint64_t deadline_us =
+      test_time != 0 ? run_start_us.load() + test_time * 1000000 : 0;
+  if (stop_requested || (deadline_us != 0 && now_us() >= deadline_us) ||
+      !m_claim_.next()) {
+    finish_session();
+    return;
+  }
+
+  m_key_ = m_keys_.next();
+  m_table_ = (m_key_base_ + m_key_) / table_size;
+  m_pk_ = (m_key_base_ + m_key_) % table_size + 1;
+  m_new_value_ = m_keys_.rand().uniform(table_size);
+  if (short_connection) {
+    connect_all();
+  } else {
+    begin_op();
   }
-  mysql_thread_end();
-  return 0;
 }
 
+void AsyncTestC::begin_op() {
+  state.increase_cnt_total();
+  m_op_start_us_ = now_us();
+  m_state_ = SCT_SELECT;
+  m_rw_sql_ = sct_select_sql(m_tables_[m_table_], m_pk_);
+  m_rw_.query(m_rw_sql_.data(), m_rw_sql_.size());
+}
+
+// like TestC::update, a failed RW ends the session.
+void AsyncTestC::select_done() {
+  unsigned int err = m_rw_.err();
+  if (err != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_RW_SELECT, err)
+        << "Failed to select the row on RW, sql: " << m_rw_sql_
+        << ", errno: " << err << ", errmsg: " << mysql_error(m_rw_.conn());
+    finish_session();
+    return;
+  }
+  MYSQL_ROW row = mysql_fetch_row(m_rw_.result());
+  if (row == nullptr || row[0] == nullptr) {
+    if (detail_log) {
+      AsyncLog(LOG_ERROR, LOG_SITE_RW_ROW)
+          << "RW row is nullptr, pk: " << m_pk_;
+    }
+    finish_session();
+    return;
+  }
+  m_old_value_ = strtoull(row[0], nullptr, 10);
+  m_rw_.free_result();
+
+  if (m_shared_) {
+    m_new_value_ = m_old_value_ + 1;
+  }
+  m_state_ = SCT_UPDATE;
+  m_rw_sql_ =
+      sct_update_sql(m_tables_[m_table_], m_pk_, m_new_value_, m_shared_);
+  m_rw_.query(m_rw_sql_.data(), m_rw_sql_.size());
+}
+
+void AsyncTestC::update_done() {
+  unsigned int err = m_rw_.err();
+  m_commit_us_ = now_us();
+  m_token_ = gtid_token(m_rw_.conn());
+  m_keys_.written(m_key_);
+  if (err != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_UPDATE, err)
+        << "Failed to update, sql: " << m_rw_sql_ << ", errno: " << err
+        << ", error: " << mysql_error(m_rw_.conn());
+    finish_session();
+    return;
+  }
+  rw_latency.record(m_slot_, m_commit_us_ - m_op_start_us_);
+
+  if (sc_gap_us != 0) {
+    m_state_ = SCT_GAP;
+    m_loop_.set_timer(*this, monotonic_ns() + sc_gap_us * 1000ULL);
+    return;
+  }
+  check();
+}
+
+// pick the replicas and run the barrier on them, or read right away.
+void AsyncTestC::check() {
+  m_check_start_us_ = now_us();
+  m_backoff_us_ = lag_poll_us;
+  m_picked_ = &m_picker_.pick(m_keys_.rand());
+  m_ro_sql_ = barrier_sql(m_token_);
+  if (m_ro_sql_.empty()) {
+    read();
+    return;
+  }
+
+  m_state_ = SCT_BARRIER;
+  m_step_start_us_ = now_us();
+  m_pending_ = m_picked_->size();
+  m_failed_ = false;
+  m_timeout_ = false;
+  for (size_t r : *m_picked_) {
+    m_ro_[r]->query(m_ro_sql_.data(), m_ro_sql_.size());
+  }
+}
+
+// as TestC::apply_barrier: a timeout is counted and the read goes on, a
+// failed barrier fails the check.
+void AsyncTestC::barrier_done(size_t replica) {
+  AsyncChannel &channel = *m_ro_[replica];
+  if (channel.err() != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_RO_BARRIER, channel.err())
+        << "Failed to apply ro barrier, RO: " << replica_name(replica)
+        << ", sql: " << m_ro_sql_ << ", errno: " << channel.err()
+        << ", errmsg: " << mysql_error(channel.conn());
+    m_failed_ = true;
+  } else if (barrier_timed_out(channel.result())) {
+    m_timeout_ = true;
+    if (detail_log) {
+      AsyncLog(LOG_ERROR, LOG_SITE_RO_BARRIER_TIMEOUT)
+          << "RO barrier timeout, RO: " << replica_name(replica) << ", sql: "
+          << m_ro_sql_;
+    }
+  }
+  channel.free_result();
+  if (--m_pending_ > 0) {
+    return;
+  }
+
+  barrier_latency.record(m_slot_, now_us() - m_step_start_us_);
+  barrier_state.increase_cnt_total();
+  if (m_failed_ || m_timeout_) {
+    barrier_state.increase_cnt_failed();
+  }
+  if (m_failed_) {
+    end_check(false, false);
+    return;
+  }
+  read();
+}
+
+// send the select to every picked replica at once.
+void AsyncTestC::read() {
+  m_state_ = SCT_READ;
+  m_step_start_us_ = now_us();
+  m_pending_ = m_picked_->size();
+  m_ro_sql_ = sct_select_sql(m_tables_[m_table_], m_pk_);
+  for (size_t r : *m_picked_) {
+    m_ro_res_[r] = 0;
+    m_ro_[r]->query(m_ro_sql_.data(), m_ro_sql_.size());
+  }
+}
+
+void AsyncTestC::read_done(size_t replica) {
+  AsyncChannel &channel = *m_ro_[replica];
+  if (channel.err() != 0) {
+    AsyncLog(LOG_ERROR, LOG_SITE_RO_READ, channel.err())
+        << "Failed to test consistency, RO: " << replica_name(replica)
+        << ", sql: " << m_ro_sql_ << ", errno: " << channel.err()
+        << ", errmsg: " << mysql_error(channel.conn());
+    m_ro_res_[replica] = -1;
+  } else {
+    MYSQL_ROW row = mysql_fetch_row(channel.result());
+    if (row == nullptr || row[0] == nullptr) {
+      if (detail_log) {
+        AsyncLog(LOG_ERROR, LOG_SITE_RO_ROW)
+            << "RO row is nullptr, RO: " << replica_name(replica)
+            << ", expected: " << m_new_value_;
+      }
+      m_ro_res_[replica] = -1;
+    } else {
+      m_ro_vals_[replica] = strtoull(row[0], nullptr, 10);
+    }
+  }
+  channel.free_result();
+  replica_stats[replica]->read_latency.record(m_slot_,
+                                              now_us() - m_step_start_us_);
+  if (--m_pending_ == 0) {
+    evaluate();
+  }
+}
+
+// the checks of TestC::consistency_test and TestC::lag_test.
+void AsyncTestC::evaluate() {
+  std::vector<size_t> &picked = *m_picked_;
+  bool ok = true;
+  if (!lag_mode) {
+    bool inconsistent = false;
+    for (size_t r : picked) {
+      if (m_ro_res_[r] != 0) {
+        ok = false;
+        continue;
+      }
+      replica_stats[r]->checks.increase_cnt_total();
+      if (!visible(m_ro_vals_[r], m_new_value_)) {
+        replica_stats[r]->checks.increase_cnt_failed();
+        if (detail_log) {
+          AsyncLog(LOG_ERROR, LOG_SITE_RO_STALE)
+              << "RO: " << replica_name(r) << ", RO val: " << m_ro_vals_[r]
+              << ", expected: " << m_new_value_ << ", RW old: "
+              << m_old_value_ << ", query: " << m_ro_sql_;
+        }
+        ok = false;
+        inconsistent = true;
+      }
+    }
+    end_check(ok, inconsistent);
+    return;
+  }
+
+  for (size_t r : picked) {
+    if (m_ro_res_[r] != 0) {
+      end_check(false, false);
+      return;
+    }
+  }
+  uint64_t elapsed_us = now_us() - m_commit_us_;
+  size_t still_pending = 0;
+  for (size_t r : picked) {
+    if (visible(m_ro_vals_[r], m_new_value_)) {
+      replica_stats[r]->lag_latency.record(m_slot_, elapsed_us);
+      replica_stats[r]->checks.increase_cnt_total();
+    } else {
+      picked[still_pending++] = r;
+    }
+  }
+  picked.resize(still_pending);
+
+  if (picked.empty()) {
+    lag_latency.record(m_slot_, elapsed_us);
+    lag_state.increase_cnt_total();
+    end_check(true, false);
+    return;
+  }
+
+  if (elapsed_us >= lag_timeout_us) {
+    for (size_t r : picked) {
+      replica_stats[r]->checks.increase_cnt_total();
+      replica_stats[r]->checks.increase_cnt_failed();
+      if (detail_log) {
+        AsyncLog(LOG_ERROR, LOG_SITE_RO_LAG_TIMEOUT)
+            << "RO lag timeout after " << elapsed_us
+            << "us, RO: " << replica_name(r) << ", RO val: " << m_ro_vals_[r]
+            << ", expected: " << m_new_value_ << ", RW old: " << m_old_value_
+            << ", query: " << m_ro_sql_;
+      }
+    }
+    lag_state.increase_cnt_failed();
+    end_check(false, true);
+    return;
+  }
+
+  if (m_backoff_us_ == 0) {
+    read();
+    return;
+  }
+  m_state_ = SCT_BACKOFF;
+  m_loop_.set_timer(*this, monotonic_ns() + m_backoff_us_ * 1000);
+  m_backoff_us_ = std::min(m_backoff_us_ * 2, lag_poll_max_us);
+}
+
+void AsyncTestC::end_check(bool ok, bool pause) {
+  ro_latency.record(m_slot_, now_us() - m_check_start_us_);
+  if (!ok) {
+    state.increase_cnt_failed();
+  }
+  if (pause && sleep_after_sct_failed > 0) {
+    m_state_ = SCT_PAUSE;
+    m_loop_.set_timer(*this,
+                      monotonic_ns() + sleep_after_sct_failed * 1000000000ULL);
+    return;
+  }
+  end_op();
+}
+
+void AsyncTestC::end_op() {
+  if (short_connection) {
+    close_all();
+    return;
+  }
+  next_op();
+}
+
+void AsyncTestC::close_all() {
+  m_state_ = SCT_CLOSE;
+  m_pending_ = 0;
+  if (m_rw_.connected()) {
+    m_rw_.close();
+    m_pending_++;
+  }
+  for (auto &ro : m_ro_) {
+    if (ro->connected()) {
+      ro->close();
+      m_pending_++;
+    }
+  }
+  if (m_pending_ == 0) {
+    close_done();
+  }
+}
+
+void AsyncTestC::close_done() {
+  if (m_pending_ > 0 && --m_pending_ > 0) {
+    return;
+  }
+  if (!m_finishing_) {
+    next_op();
+    return;
+  }
+  m_state_ = SCT_DONE;
+  running_threads--;
+  m_loop_.finish(*this);
+}
+
+void AsyncTestC::finish_session() {
+  m_finishing_ = true;
+  close_all();
+}
+
+/*
+  --engine=async: one thread per event loop prepares the tables of all
+  sessions, then the loops run the --concurrency sessions.
+*/
+static void start_test_async(AsyncEngine *engine) {
+  uint64_t workers = engine->loops();
+  std::atomic<int> prepare_res{0};
+  if (!skip_prepare && (table_cnt == 0 || dist_index == 0)) {
+    std::vector<string> tables;
+    if (table_cnt == 0) {
+      for (uint64_t i = 0; i < concurrency; i++) {
+        tables.push_back(session_tables(i)[0]);
+      }
+    } else {
+      tables = session_tables(0);
+    }
+    std::vector<std::thread> preparers;
+    for (uint64_t w = 0; w < workers; w++) {
+      preparers.emplace_back([&, w] {
+        MYSQL *conn = mysql_init(0);
+        int res = 0;
+        if (conn == nullptr ||
+            !mysql_real_connect(conn, host_rw, user, password, database,
+                                port_rw, nullptr, 0)) {
+          unsigned int err = conn ? mysql_errno(conn) : CR_OUT_OF_MEMORY;
+          AsyncLog(LOG_ERROR, LOG_SITE_CONNECT, err)
+              << "Failed to connect to RW to prepare data. errno: " << err
+              << ",errmsg: " << (conn ? mysql_error(conn) : "");
+          res = -1;
+        }
+        res = prepare_tables(conn, database, tables, w, workers, res);
+        if (res != 0) {
+          prepare_res = res;
+        }
+        if (conn != nullptr) {
+          mysql_close(conn);
+        }
+        mysql_thread_end();
+      });
+    }
+    for (auto &preparer : preparers) {
+      preparer.join();
+    }
+  }
+
+  // like the start barrier of the threads, a process that failed to prepare
+  // still lets the coordinator start the others.
+  if (dist_connect != nullptr) {
+    dist_wait_start();
+  }
+  if (prepare_res == 0) {
+    run_start_us = now_us();
+    int res = engine->start(
+        [](AsyncLoop &loop, uint64_t index, uint64_t) -> AsyncTask * {
+          return new AsyncTestC(loop, session_tables(index), index);
+        },
+        stop_requested, nullptr);
+    if (res == 0) {
+      engine->join();
+    } else {
+      sct_failed = true;
+    }
+  } else {
+    std::cout << "Failed to prepare data, no session runs." << std::endl;
+    sct_failed = true;
+  }
+  active_threads--;
+}
+
+#else
+
+static void start_test_async(AsyncEngine *engine) {
+  // reports that the client library has no nonblocking API.
+  engine->start(AsyncEngine::TaskFactory(), stop_requested, nullptr);
+  sct_failed = true;
+  active_threads--;
+}
+
+#endif // MYSQL_WAIT_READ
+
 int main_sct() {
-  std::thread *ct_threads[concurrency];
-  for (uint thread_id = 0; thread_id < concurrency; thread_id++) {
-    ct_threads[thread_id] = new std::thread(start_test, thread_id);
+  // statistics have a slot per thread, or per event loop of the async
+  // engine, whose loops prepare the data with one thread each.
+  AsyncEngine async_engine(concurrency, async_threads);
+  uint64_t slots = engine == ENGINE_ASYNC ? async_engine.loops() : concurrency;
+  std::vector<std::thread *> ct_threads;
+  Barrier barrier(slots);
+  prepare_barrier = &barrier;
+  Barrier start(concurrency,
+                dist_connect != nullptr ? dist_wait_start : nullptr);
+  start_barrier = &start;
+  WorkBudget budget(iterations, concurrency);
+  sct_budget = &budget;
+  SweepGate gate;
+  sweep_gate = sweep_mode != SWEEP_NONE ? &gate : nullptr;
+  rw_latency.init(slots);
+  ro_latency.init(slots);
+  lag_latency.init(slots);
+  barrier_latency.init(slots);
+  worker_cpu_init(slots);
+  for (size_t r = 0; r < ro_endpoints.size(); r++) {
+    replica_stats.push_back(new ReplicaStats());
+    replica_stats[r]->read_latency.init(slots);
+    replica_stats[r]->lag_latency.init(slots);
+  }
+  if (engine == ENGINE_ASYNC) {
+    ct_threads.push_back(new std::thread(start_test_async, &async_engine));
     active_threads++;
+  } else {
+    for (uint thread_id = 0; thread_id < concurrency; thread_id++) {
+      ct_threads.push_back(new std::thread(start_test, thread_id));
+      active_threads++;
+    }
+  }
+  if (dist_connect != nullptr) {
+    dist_start_reporter(take_dist_snapshot);
   }
 
   Statistics new_state;
   Statistics pre_state;
   pre_state = state;
+  IntervalHistogram rw_interval(rw_latency);
+  IntervalHistogram ro_interval(ro_latency);
+  IntervalHistogram lag_interval(lag_latency);
+  IntervalHistogram barrier_interval(barrier_latency);
+  Statistics new_barrier_state;
+  Statistics pre_barrier_state;
+  Statistics new_lag_state;
+  Statistics pre_lag_state;
+  uint64_t pre_loaded_rows = 0;
+  // per replica lines only when there is more than one.
+  bool per_replica = ro_endpoints.size() > 1;
+  std::vector<Statistics> pre_checks(ro_endpoints.size());
+  std::vector<IntervalHistogram *> read_intervals;
+  std::vector<IntervalHistogram *> lag_intervals;
+  for (auto stats : replica_stats) {
+    read_intervals.push_back(new IntervalHistogram(stats->read_latency));
+    lag_intervals.push_back(new IntervalHistogram(stats->lag_latency));
+  }
+  SctBaseline base(ro_endpoints.size());
+  bool measuring = warmup_time == 0 && warmup_ops == 0 && steady_cv == 0;
+  std::deque<uint64_t> recent_tps;
 
-  if (report_interval != 0) {
+  if (sweep_mode != SWEEP_NONE) {
+    run_sweep();
+  } else if (report_interval != 0) {
     while (active_threads.load() != 0) {
       sleep(report_interval);
 
       if (running_threads > 0) {
         new_state = state;
-        std::cout << "Strict consistency tps: "
-                  << (new_state.get_cnt_total() - pre_state.get_cnt_total()) /
-                         report_interval
-                  << ", failed tps: "
-                  << (new_state.get_cnt_failed() - pre_state.get_cnt_failed()) /
-                         report_interval
-                  << std::endl;
+        uint64_t tps =
+            (new_state.get_cnt_total() - pre_state.get_cnt_total()) /
+            report_interval;
+        uint64_t failed_tps =
+            (new_state.get_cnt_failed() - pre_state.get_cnt_failed()) /
+            report_interval;
+        const Histogram &rw_hist = rw_interval.next();
+        const Histogram &ro_hist = ro_interval.next();
+        ReportRecord *record =
+            report_enabled()
+                ? new ReportRecord(measuring ? "interval" : "warmup")
+                : nullptr;
+        std::cout << (measuring ? "" : "[warmup] ")
+                  << "Strict consistency tps: " << tps
+                  << ", failed tps: " << failed_tps
+                  << ", rw lat(us): [" << rw_hist.percentile_summary()
+                  << "], ro lat(us): [" << ro_hist.percentile_summary() << "]";
+        if (record) {
+          record->add("tps", tps).add("failed_tps", failed_tps);
+          record->add_latency("rw_lat", rw_hist).add_latency("ro_lat", ro_hist);
+        }
+        if (lag_mode) {
+          new_lag_state = lag_state;
+          const Histogram &lag_hist = lag_interval.next();
+          uint64_t timeouts =
+              new_lag_state.get_cnt_failed() - pre_lag_state.get_cnt_failed();
+          std::cout << ", lag(us): [" << lag_hist.percentile_summary()
+                    << "], lag timeouts: " << timeouts;
+          if (record) {
+            record->add_latency("lag", lag_hist).add("lag_timeouts", timeouts);
+          }
+          pre_lag_state = new_lag_state;
+        }
+        if (ro_barrier != BARRIER_NONE) {
+          new_barrier_state = barrier_state;
+          const Histogram &barrier_hist = barrier_interval.next();
+          uint64_t timeouts = new_barrier_state.get_cnt_failed() -
+                              pre_barrier_state.get_cnt_failed();
+          std::cout << ", barrier lat(us): ["
+                    << barrier_hist.percentile_summary()
+                    << "], barrier timeouts: " << timeouts;
+          if (record) {
+            record->add_latency("barrier_lat", barrier_hist)
+                .add("barrier_timeouts", timeouts);
+          }
+          pre_barrier_state = new_barrier_state;
+        }
+        std::cout << std::endl;
+        for (size_t r = 0; per_replica && r < replica_stats.size(); r++) {
+          Statistics new_checks;
+          new_checks = replica_stats[r]->checks;
+          uint64_t checks =
+              (new_checks.get_cnt_total() - pre_checks[r].get_cnt_total()) /
+              report_interval;
+          uint64_t failed =
+              (new_checks.get_cnt_failed() - pre_checks[r].get_cnt_failed()) /
+              report_interval;
+          const Histogram &read_hist = read_intervals[r]->next();
+          std::cout << "  RO " << ro_endpoints[r].host << ":"
+                    << ro_endpoints[r].port << " checks: " << checks << ", "
+                    << (lag_mode ? "timeouts: " : "failed: ") << failed
+                    << ", read lat(us): [" << read_hist.percentile_summary()
+                    << "]";
+          std::string prefix = "ro" + std::to_string(r) + "_";
+          if (record) {
+            record->add(prefix + "checks", checks)
+                .add(prefix + "failed", failed)
+                .add_latency(prefix + "read_lat", read_hist);
+          }
+          if (lag_mode) {
+            const Histogram &lag_hist = lag_intervals[r]->next();
+            std::cout << ", lag(us): [" << lag_hist.percentile_summary() << "]";
+            if (record) {
+              record->add_latency(prefix + "lag", lag_hist);
+            }
+          }
+          std::cout << std::endl;
+          pre_checks[r] = new_checks;
+        }
+        if (record) {
+          record->add("active_threads", (uint64_t)active_threads.load());
+          report_emit(record);
+        }
+        if (!measuring) {
+          recent_tps.push_back(tps);
+          if (recent_tps.size() > kSteadyWindow) {
+            recent_tps.pop_front();
+          }
+          double elapsed_s = (now_us() - run_start_us.load()) / 1e6;
+          double cv = tps_cv(recent_tps);
+          bool warm = elapsed_s >= warmup_time &&
+                      new_state.get_cnt_total() >= warmup_ops;
+          bool steady = steady_cv == 0 || (recent_tps.size() == kSteadyWindow &&
+                                           cv <= steady_cv);
+          if (warm && steady) {
+            measuring = true;
+            take_baseline(base);
+            std::cout << "Warmup done after " << elapsed_s << "s, "
+                      << new_state.get_cnt_total() << " ops, tps cv: " << cv
+                      << ", statistics start now." << std::endl;
+          }
+        }
         pre_state = new_state;
+      } else if (loaded_rows() != pre_loaded_rows) {
+        uint64_t rows = loaded_rows();
+        std::cout << "Preparing data rows/s: "
+                  << (rows - pre_loaded_rows) / report_interval
+                  << ", loaded rows: " << rows << std::endl;
+        pre_loaded_rows = rows;
       }
     }
   }
 
-  for (uint thread_id = 0; thread_id < concurrency; thread_id++) {
-    ct_threads[thread_id]->join();
-    delete ct_threads[thread_id];
+  for (auto ct_thread : ct_threads) {
+    ct_thread->join();
+    delete ct_thread;
   }
+  dist_finish();
 
-  std::cout << "Test strict consistency cnt: " << state.get_cnt_total()
-            << ", failed cnt: " << state.get_cnt_failed() << std::endl;
-  return 0;
+  if (!measuring) {
+    // no baseline was taken, the summary covers the whole run.
+    std::cout << "Warmup did not finish, the summary includes it."
+              << std::endl;
+  }
+  Statistics measured;
+  measured = state;
+  measured.subtract(base.state);
+  std::cout << "Test strict consistency cnt: " << measured.get_cnt_total()
+            << ", failed cnt: " << measured.get_cnt_failed() << std::endl;
+  ReportRecord *record =
+      report_enabled() ? new ReportRecord("summary") : nullptr;
+  if (record) {
+    record->add("total", measured.get_cnt_total())
+        .add("failed", measured.get_cnt_failed());
+  }
+
+  Histogram total;
+  since(rw_latency, base.rw, total);
+  std::cout << "RW update latency(us): " << total.percentile_summary()
+            << ", avg: " << total.get_mean() << std::endl;
+  if (record) {
+    record->add_latency("rw_lat", total);
+  }
+  since(ro_latency, base.ro, total);
+  std::cout << "RO read latency(us): " << total.percentile_summary()
+            << ", avg: " << total.get_mean() << std::endl;
+  if (record) {
+    record->add_latency("ro_lat", total);
+  }
+  if (lag_mode) {
+    Statistics measured_lag;
+    measured_lag = lag_state;
+    measured_lag.subtract(base.lag_state);
+    since(lag_latency, base.lag, total);
+    std::cout << "RO visibility lag(us): " << total.percentile_summary()
+              << ", avg: " << total.get_mean()
+              << ", visible cnt: " << measured_lag.get_cnt_total()
+              << ", timeout cnt: " << measured_lag.get_cnt_failed()
+              << std::endl;
+    if (record) {
+      record->add_latency("lag", total)
+          .add("lag_timeouts", measured_lag.get_cnt_failed());
+    }
+  }
+  if (ro_barrier != BARRIER_NONE) {
+    Statistics measured_barrier;
+    measured_barrier = barrier_state;
+    measured_barrier.subtract(base.barrier_state);
+    since(barrier_latency, base.barrier, total);
+    if (record) {
+      record->add_latency("barrier_lat", total)
+          .add("barrier_timeouts", measured_barrier.get_cnt_failed());
+    }
+    std::cout << "RO barrier latency(us): " << total.percentile_summary()
+              << ", avg: " << total.get_mean()
+              << ", barrier cnt: " << measured_barrier.get_cnt_total()
+              << ", timeout cnt: " << measured_barrier.get_cnt_failed()
+              << ", failed rate: "
+              << (measured.get_cnt_total() ? measured.get_cnt_failed() *
+                                                 100.0 /
+                                                 measured.get_cnt_total()
+                                           : 0)
+              << "%" << std::endl;
+  }
+
+  for (size_t r = 0; per_replica && r < replica_stats.size(); r++) {
+    ReplicaStats *stats = replica_stats[r];
+    Statistics checks;
+    checks = stats->checks;
+    checks.subtract(base.checks[r]);
+    std::cout << "RO " << ro_endpoints[r].host << ":" << ro_endpoints[r].port
+              << " checks: " << checks.get_cnt_total()
+              << (lag_mode ? ", timeouts: " : ", failed: ")
+              << checks.get_cnt_failed();
+    since(stats->read_latency, base.read[r], total);
+    std::cout << ", read lat(us): [" << total.percentile_summary() << "]";
+    std::string prefix = "ro" + std::to_string(r) + "_";
+    if (record) {
+      record->add(prefix + "checks", checks.get_cnt_total())
+          .add(prefix + "failed", checks.get_cnt_failed())
+          .add_latency(prefix + "read_lat", total);
+    }
+    if (lag_mode) {
+      since(stats->lag_latency, base.replica_lag[r], total);
+      std::cout << ", lag(us): [" << total.percentile_summary() << "]";
+      if (record) {
+        record->add_latency(prefix + "lag", total);
+      }
+    }
+    std::cout << std::endl;
+  }
+  worker_cpu_summary(record);
+  if (record) {
+    report_emit(record);
+  }
+
+  for (size_t r = 0; r < replica_stats.size(); r++) {
+    delete read_intervals[r];
+    delete lag_intervals[r];
+    delete replica_stats[r];
+  }
+  replica_stats.clear();
+  return sct_failed ? -1 : 0;
 }
@@ -6,14 +6,18 @@
  */
 
 
+#include <chrono>
 #include <cstddef>
 #include <cstring>
 #include <getopt.h>
 #include <ostream>
 #include <string>
 #include <iostream>
+#include <mysql/mysql.h>
+#include <thread>
 
 #include "options.h"
+#include "cpu_affinity.h"
 
 using std::cout;
 using std::endl;
@@ -32,24 +36,92 @@ uint port = 0;
 uint port_rw = 0;
 uint port_ro = 0;
 uint sc_gap_us = 0;
-uint table_cnt = 1;
+uint table_cnt = 0;
 uint64_t concurrency = 1;
 uint64_t table_size = 1000;
-uint64_t iterations = 100000;
+uint64_t iterations = 0; // 100000 unless --test-time bounds sct and shortct
 uint64_t report_interval = 1; // s
 uint detail_log = 0;
 uint64_t sleep_after_sct_failed = 0; // s
 uint select_after_insert = 0;
 uint short_connection = 0;
 bool skip_prepare = 0;
-uint64_t test_time = 60;
+uint64_t test_time = 0; // s, rqps runs 60 s by default
 uint64_t test_qps = 1000;
+uint lag_mode = 0;
+uint64_t lag_timeout_us = 1000000;
+uint64_t lag_poll_us = 10;
+uint64_t lag_poll_max_us = 1000;
+uint ps_mode = 0;
+uint64_t prepare_batch = 1000;
+uint64_t prepare_threads = 1;
+uint prepare_drop_pk = 0;
+PrepareMethod prepare_method{PREPARE_INSERT};
+char *prepare_method_str = nullptr;
+uint64_t rand_seed = 0; // 0: pick one from the clock
+KeyDistribution rand_type{DIST_UNIFORM};
+char *rand_type_str = nullptr;
+double zipf_theta = 0.99;
+uint64_t hotspot_ops = 80;  // % of operations
+uint64_t hotspot_keys = 20; // on % of keys
+ArrivalProcess arrival{ARRIVAL_CLOSED};
+char *arrival_str = nullptr;
+ConnLifecycle conn_mode{CONN_PER_BATCH};
+char *conn_mode_str = nullptr;
+uint64_t pool_size = 0; // 0: one connection per thread
+// --host-ro may list several RO endpoints.
+std::vector<Endpoint> ro_endpoints;
+ReplicaPick ro_pick{PICK_ALL};
+char *ro_pick_str = nullptr;
+uint64_t ro_subset = 1; // replicas read per check with rr and random
+ReadBarrier ro_barrier{BARRIER_NONE};
+char *ro_barrier_str = nullptr;
+char *ro_barrier_sql = nullptr;
+uint64_t ro_barrier_timeout_ms = 1000;
+char *query_file = nullptr; // short_connection_querys.txt by default
+ClientEngine engine{ENGINE_THREAD};
+char *engine_str = nullptr;
+uint64_t async_threads = std::thread::hardware_concurrency();
+char *replay_file = nullptr;
+ReplayFormat replay_format{REPLAY_GENERAL_LOG};
+char *replay_format_str = nullptr;
+double replay_speed = 1; // 0 replays as fast as possible
+ResultMode result_mode{RESULT_STORE};
+char *result_mode_str = nullptr;
+OutputFormat output_format{OUTPUT_NONE};
+char *output_format_str = nullptr;
+char *output_file = nullptr;
+uint64_t warmup_time = 0; // s
+uint64_t warmup_ops = 0;
+double steady_cv = 0; // 0 does not wait for steady state
+char *cpu_affinity = nullptr; // nullptr leaves placement to the scheduler
+SweepMode sweep_mode{SWEEP_NONE};
+char *sweep_mode_str = nullptr;
+uint64_t sweep_step_time = 10; // s
+double sweep_knee_p99 = 2; // p99 growth between steps that marks the knee
+double sweep_knee_failed = 1; // failure rate growth in percentage points
+char *dist_listen = nullptr; // host:port or unix socket path
+uint64_t dist_workers = 0;
+char *dist_connect = nullptr;
 
-// test_mode contains "sct", "shortct", "rqps"
+// test_mode contains "sct", "shortct", "rqps", "replay"
 char *test_mode_str = nullptr;
 
 TestMode test_mode{CONSISTENT}; // defalut sct mode
 
+static const char *prepare_method_names[] = {"insert", "load"};
+
+bool parse_prepare_method() {
+  for (uint i = 0; i <= PREPARE_LOAD_DATA; i++) {
+    if (strcasecmp(prepare_method_str, prepare_method_names[i]) == 0) {
+      prepare_method = (PrepareMethod)i;
+      return true;
+    }
+  }
+  cout << "unknown prepare-method: " << prepare_method_str << endl;
+  return false;
+}
+
 void parse_test_mode() {
   if (test_mode_str == nullptr || strcasecmp(test_mode_str, "sct") == 0) {
     test_mode = CONSISTENT;
@@ -57,7 +129,174 @@ void parse_test_mode() {
     test_mode = SHORT_CONNECT;
   } else if (strcasecmp(test_mode_str, "rqps") == 0) {
     test_mode = REMAIN_QPS;
+  } else if (strcasecmp(test_mode_str, "replay") == 0) {
+    test_mode = REPLAY;
+  }
+}
+
+static const char *rand_type_names[] = {"uniform", "zipfian", "hotspot",
+                                        "seq", "latest"};
+
+bool parse_rand_type() {
+  for (uint i = 0; i <= DIST_LATEST; i++) {
+    if (strcasecmp(rand_type_str, rand_type_names[i]) == 0) {
+      rand_type = (KeyDistribution)i;
+      return true;
+    }
+  }
+  cout << "unknown rand-type: " << rand_type_str << endl;
+  return false;
+}
+
+static const char *arrival_names[] = {"closed", "constant", "poisson"};
+
+bool parse_arrival() {
+  for (uint i = 0; i <= ARRIVAL_POISSON; i++) {
+    if (strcasecmp(arrival_str, arrival_names[i]) == 0) {
+      arrival = (ArrivalProcess)i;
+      return true;
+    }
+  }
+  cout << "unknown arrival: " << arrival_str << endl;
+  return false;
+}
+
+static const char *conn_mode_names[] = {"query", "batch", "persistent",
+                                        "pool"};
+
+bool parse_conn_mode() {
+  for (uint i = 0; i <= CONN_POOL; i++) {
+    if (strcasecmp(conn_mode_str, conn_mode_names[i]) == 0) {
+      conn_mode = (ConnLifecycle)i;
+      return true;
+    }
+  }
+  cout << "unknown conn-mode: " << conn_mode_str << endl;
+  return false;
+}
+
+static const char *engine_names[] = {"thread", "async"};
+
+bool parse_engine() {
+  for (uint i = 0; i <= ENGINE_ASYNC; i++) {
+    if (strcasecmp(engine_str, engine_names[i]) == 0) {
+      engine = (ClientEngine)i;
+      return true;
+    }
+  }
+  cout << "unknown engine: " << engine_str << endl;
+  return false;
+}
+
+static const char *ro_pick_names[] = {"all", "rr", "random"};
+
+bool parse_ro_pick() {
+  for (uint i = 0; i <= PICK_RANDOM; i++) {
+    if (strcasecmp(ro_pick_str, ro_pick_names[i]) == 0) {
+      ro_pick = (ReplicaPick)i;
+      return true;
+    }
+  }
+  cout << "unknown ro-pick: " << ro_pick_str << endl;
+  return false;
+}
+
+bool parse_endpoints(const char *list, unsigned int default_port,
+                     std::vector<Endpoint> &endpoints) {
+  endpoints.clear();
+  std::string all(list);
+  size_t begin = 0;
+  while (begin <= all.size()) {
+    size_t end = all.find(',', begin);
+    if (end == std::string::npos) {
+      end = all.size();
+    }
+    std::string item = all.substr(begin, end - begin);
+    begin = end + 1;
+    if (item.empty()) {
+      continue;
+    }
+
+    // a single ':' separates the port, more are an IPv6 address.
+    Endpoint endpoint{item, default_port};
+    size_t colon = item.rfind(':');
+    if (colon != std::string::npos && item.find(':') == colon) {
+      endpoint.host = item.substr(0, colon);
+      endpoint.port = atoi(item.c_str() + colon + 1);
+    }
+    if (endpoint.host.empty() || endpoint.port == 0) {
+      cout << "wrong endpoint: " << item << endl;
+      return false;
+    }
+    endpoints.push_back(endpoint);
+  }
+  return !endpoints.empty();
+}
+
+static const char *ro_barrier_names[] = {"none", "gtid-wait",
+                                         "mariadb-gtid-wait", "session", "sql"};
+
+bool parse_ro_barrier() {
+  for (uint i = 0; i <= BARRIER_READ_SQL; i++) {
+    if (strcasecmp(ro_barrier_str, ro_barrier_names[i]) == 0) {
+      ro_barrier = (ReadBarrier)i;
+      return true;
+    }
+  }
+  cout << "unknown ro-barrier: " << ro_barrier_str << endl;
+  return false;
+}
+
+static const char *replay_format_names[] = {"general", "slow"};
+
+bool parse_replay_format() {
+  for (uint i = 0; i <= REPLAY_SLOW_LOG; i++) {
+    if (strcasecmp(replay_format_str, replay_format_names[i]) == 0) {
+      replay_format = (ReplayFormat)i;
+      return true;
+    }
+  }
+  cout << "unknown replay-format: " << replay_format_str << endl;
+  return false;
+}
+
+static const char *result_mode_names[] = {"store", "use"};
+
+bool parse_result_mode() {
+  for (uint i = 0; i <= RESULT_USE; i++) {
+    if (strcasecmp(result_mode_str, result_mode_names[i]) == 0) {
+      result_mode = (ResultMode)i;
+      return true;
+    }
   }
+  cout << "unknown result-mode: " << result_mode_str << endl;
+  return false;
+}
+
+static const char *output_format_names[] = {"none", "json", "csv"};
+
+bool parse_output_format() {
+  for (uint i = 0; i <= OUTPUT_CSV; i++) {
+    if (strcasecmp(output_format_str, output_format_names[i]) == 0) {
+      output_format = (OutputFormat)i;
+      return true;
+    }
+  }
+  cout << "unknown output-format: " << output_format_str << endl;
+  return false;
+}
+
+static const char *sweep_mode_names[] = {"none", "geometric", "adaptive"};
+
+bool parse_sweep_mode() {
+  for (uint i = 0; i <= SWEEP_ADAPTIVE; i++) {
+    if (strcasecmp(sweep_mode_str, sweep_mode_names[i]) == 0) {
+      sweep_mode = (SweepMode)i;
+      return true;
+    }
+  }
+  cout << "unknown sweep: " << sweep_mode_str << endl;
+  return false;
 }
 
 int flag = 0;
@@ -74,7 +313,29 @@ static const struct option long_options[] = {
     {"port", 1, nullptr, 'R'}, {"host", 1, nullptr, 'o'},
     {"skip-prepare", 1, nullptr, 'K'},     {"sleep-after-fail", 1, nullptr, 'f'},
     {"port", 1, nullptr, 'R'},             {"host", 1, nullptr, 'o'},
-    {"test-time", 0, &flag, 1},            {"qps", 1, &flag, 2},
+    {"test-time", 1, &flag, 1},            {"qps", 1, &flag, 2},
+    {"lag-mode", 1, &flag, 3},             {"lag-timeout-us", 1, &flag, 4},
+    {"lag-poll-us", 1, &flag, 5},          {"lag-poll-max-us", 1, &flag, 6},
+    {"ps-mode", 1, &flag, 7},              {"prepare-batch", 1, &flag, 8},
+    {"prepare-threads", 1, &flag, 9},      {"prepare-method", 1, &flag, 10},
+    {"prepare-drop-pk", 1, &flag, 11},     {"select-after-insert", 1, &flag, 12},
+    {"seed", 1, &flag, 13},                {"rand-type", 1, &flag, 14},
+    {"zipf-theta", 1, &flag, 15},          {"hotspot-ops", 1, &flag, 16},
+    {"hotspot-keys", 1, &flag, 17},        {"arrival", 1, &flag, 18},
+    {"conn-mode", 1, &flag, 19},           {"pool-size", 1, &flag, 20},
+    {"engine", 1, &flag, 21},              {"async-threads", 1, &flag, 22},
+    {"ro-pick", 1, &flag, 23},             {"ro-subset", 1, &flag, 24},
+    {"ro-barrier", 1, &flag, 25},          {"ro-barrier-sql", 1, &flag, 26},
+    {"ro-barrier-timeout-ms", 1, &flag, 27},
+    {"query-file", 1, &flag, 28},          {"replay-file", 1, &flag, 29},
+    {"replay-format", 1, &flag, 30},       {"replay-speed", 1, &flag, 31},
+    {"result-mode", 1, &flag, 32},         {"output-format", 1, &flag, 33},
+    {"output-file", 1, &flag, 34},         {"warmup-time", 1, &flag, 35},
+    {"warmup-ops", 1, &flag, 36},          {"steady-cv", 1, &flag, 37},
+    {"cpu-affinity", 1, &flag, 38},        {"sweep", 1, &flag, 39},
+    {"sweep-step-time", 1, &flag, 40},     {"sweep-knee-p99", 1, &flag, 41},
+    {"sweep-knee-failed", 1, &flag, 42},   {"dist-listen", 1, &flag, 43},
+    {"dist-workers", 1, &flag, 44},        {"dist-connect", 1, &flag, 45},
     {nullptr, 0, nullptr, 0}
 };
 
@@ -185,6 +446,168 @@ bool parse_option(int argc, char *argv[]) {
         case 2 :
           test_qps = atoi(optarg);
           break;
+        case 3 :
+          lag_mode = atoi(optarg);
+          break;
+        case 4 :
+          lag_timeout_us = atoll(optarg);
+          break;
+        case 5 :
+          lag_poll_us = atoll(optarg);
+          break;
+        case 6 :
+          lag_poll_max_us = atoll(optarg);
+          break;
+        case 7 :
+          ps_mode = atoi(optarg);
+          break;
+        case 8 :
+          prepare_batch = atoll(optarg);
+          break;
+        case 9 :
+          prepare_threads = atoll(optarg);
+          break;
+        case 10 :
+          prepare_method_str = strdup(optarg);
+          if (!parse_prepare_method()) {
+            return false;
+          }
+          break;
+        case 11 :
+          prepare_drop_pk = atoi(optarg);
+          break;
+        case 12 :
+          select_after_insert = atoi(optarg);
+          break;
+        case 13 :
+          rand_seed = strtoull(optarg, nullptr, 10);
+          break;
+        case 14 :
+          rand_type_str = strdup(optarg);
+          if (!parse_rand_type()) {
+            return false;
+          }
+          break;
+        case 15 :
+          zipf_theta = atof(optarg);
+          break;
+        case 16 :
+          hotspot_ops = atoll(optarg);
+          break;
+        case 17 :
+          hotspot_keys = atoll(optarg);
+          break;
+        case 18 :
+          arrival_str = strdup(optarg);
+          if (!parse_arrival()) {
+            return false;
+          }
+          break;
+        case 19 :
+          conn_mode_str = strdup(optarg);
+          if (!parse_conn_mode()) {
+            return false;
+          }
+          break;
+        case 20 :
+          pool_size = atoll(optarg);
+          break;
+        case 21 :
+          engine_str = strdup(optarg);
+          if (!parse_engine()) {
+            return false;
+          }
+          break;
+        case 22 :
+          async_threads = atoll(optarg);
+          break;
+        case 23 :
+          ro_pick_str = strdup(optarg);
+          if (!parse_ro_pick()) {
+            return false;
+          }
+          break;
+        case 24 :
+          ro_subset = atoll(optarg);
+          break;
+        case 25 :
+          ro_barrier_str = strdup(optarg);
+          if (!parse_ro_barrier()) {
+            return false;
+          }
+          break;
+        case 26 :
+          ro_barrier_sql = strdup(optarg);
+          break;
+        case 27 :
+          ro_barrier_timeout_ms = atoll(optarg);
+          break;
+        case 28 :
+          query_file = strdup(optarg);
+          break;
+        case 29 :
+          replay_file = strdup(optarg);
+          break;
+        case 30 :
+          replay_format_str = strdup(optarg);
+          if (!parse_replay_format()) {
+            return false;
+          }
+          break;
+        case 31 :
+          replay_speed = atof(optarg);
+          break;
+        case 32 :
+          result_mode_str = strdup(optarg);
+          if (!parse_result_mode()) {
+            return false;
+          }
+          break;
+        case 33 :
+          output_format_str = strdup(optarg);
+          if (!parse_output_format()) {
+            return false;
+          }
+          break;
+        case 34 :
+          output_file = strdup(optarg);
+          break;
+        case 35 :
+          warmup_time = atoll(optarg);
+          break;
+        case 36 :
+          warmup_ops = atoll(optarg);
+          break;
+        case 37 :
+          steady_cv = atof(optarg);
+          break;
+        case 38 :
+          cpu_affinity = strdup(optarg);
+          break;
+        case 39 :
+          sweep_mode_str = strdup(optarg);
+          if (!parse_sweep_mode()) {
+            return false;
+          }
+          break;
+        case 40 :
+          sweep_step_time = atoll(optarg);
+          break;
+        case 41 :
+          sweep_knee_p99 = atof(optarg);
+          break;
+        case 42 :
+          sweep_knee_failed = atof(optarg);
+          break;
+        case 43 :
+          dist_listen = strdup(optarg);
+          break;
+        case 44 :
+          dist_workers = atoll(optarg);
+          break;
+        case 45 :
+          dist_connect = strdup(optarg);
+          break;
       }
       break;
     }
@@ -196,6 +619,10 @@ bool parse_option(int argc, char *argv[]) {
     }
   }
 
+  if (rand_seed == 0) {
+    rand_seed = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+
   return true;
 }
 
@@ -204,14 +631,17 @@ void usage() {
   cout << "-?	--help		Display this help and exit.\n";
   cout << "-v	--version	Output version information and exit.\n";
   cout << "-h	--host-rw	mysql RW node host.\n";
-  cout << "-H	--host-ro	mysql RO node host.\n";
+  cout << "-H	--host-ro	mysql RO node host, or a list of "
+          "host[:port] separated by ','.\n";
   cout << "-D	--database	mysql database.\n";
   cout << "-P	--port-rw	mysql RW node port.\n";
   cout << "-o	--port-ro	mysql RO node port.\n";
   cout << "-u	--user	mysql user.\n";
   cout << "-p	--password	mysql password.\n";
-  cout << "-i	--iterations	number of times to run the tests.\n";
-  cout << "-T	--table-cnt	number of tables to test.\n";
+  cout << "-i	--iterations	number of times to run the tests over all "
+          "threads.\n";
+  cout << "-T	--table-cnt	number of tables shared by all threads, 0 gives "
+          "every thread its own table.\n";
   cout << "-t	--table-size	table size.\n";
   cout << "-s	--sc-gap-us	time(us) to sleep after write.\n";
   cout << "-r	--report-interval	periodically report intermediate "
@@ -222,12 +652,97 @@ void usage() {
   cout << "-m	--test-mode choose test mode.\n";
   cout << "-K	--skip-prepare skip data prepare.\n";
   cout << "-f	--sleep-after-fail sleep ms after sct failed";
-  cout << "--test-time the totol time in remain_qps mode\n";
-  cout << "--qps the qps you want to remain in test\n";
+  cout << "--test-time seconds to run, rqps defaults to 60, sct and shortct "
+          "run until --iterations are done.\n";
+  cout << "--qps the qps you want to remain in test, spread evenly over "
+          "threads and time, 0 is unlimited\n";
+  cout << "--lag-mode poll RO until the new value is visible and report the "
+          "replication visibility lag instead of pass/fail.\n";
+  cout << "--lag-timeout-us give up polling RO after this long(us), counted "
+          "as a timeout.\n";
+  cout << "--lag-poll-us first sleep(us) between RO polls, doubled after each "
+          "miss, 0 spins.\n";
+  cout << "--lag-poll-max-us upper bound(us) of the poll backoff.\n";
+  cout << "--ps-mode use server side prepared statements in sct mode.\n";
+  cout << "--prepare-batch rows per INSERT/LOAD DATA statement when preparing "
+          "data.\n";
+  cout << "--prepare-threads loader connections per table.\n";
+  cout << "--prepare-method insert(multi-row INSERT) or load(LOAD DATA LOCAL "
+          "INFILE).\n";
+  cout << "--prepare-drop-pk create tables without pk and add it after "
+          "loading.\n";
+  cout << "--select-after-insert check every loaded batch is visible on RO.\n";
+  cout << "--seed seed of the random generators, the same seed repeats the "
+          "same keys per thread, 0 picks one.\n";
+  cout << "--rand-type key distribution: uniform, zipfian, hotspot, seq or "
+          "latest.\n";
+  cout << "--zipf-theta skew of zipfian and latest, in (0, 1).\n";
+  cout << "--hotspot-ops percent of operations that go to the hot keys.\n";
+  cout << "--hotspot-keys percent of keys that are hot.\n";
+  cout << "--arrival rqps send schedule: closed (wait for the previous "
+          "query), constant or poisson (open loop).\n";
+  cout << "--conn-mode rqps connection lifecycle: query, batch(reconnect per "
+          "pass over the queries), persistent or pool.\n";
+  cout << "--pool-size connections shared by all threads with "
+          "--conn-mode=pool, 0 is one per thread.\n";
+  cout << "--engine thread(one thread per session) or async(event loops "
+          "drive all sessions, sct, shortct and rqps).\n";
+  cout << "--async-threads event loop threads of the async engine, default "
+          "is the number of cpus.\n";
+  cout << "--ro-pick RO endpoints each check reads: all, rr(round robin) or "
+          "random.\n";
+  cout << "--ro-subset endpoints read per check with --ro-pick=rr|random.\n";
+  cout << "--ro-barrier wait for the write on RO before reading: none, "
+          "gtid-wait, mariadb-gtid-wait, session or sql.\n";
+  cout << "--ro-barrier-sql sql of the session and sql barriers.\n";
+  cout << "--ro-barrier-timeout-ms timeout of the gtid waits.\n";
+  cout << "--query-file workload of shortct and rqps mode, default is "
+          "short_connection_querys.txt.\n";
+  cout << "--replay-file general log or slow log replayed by replay mode.\n";
+  cout << "--replay-format general or slow.\n";
+  cout << "--replay-speed multiple of the original pace, 0 is as fast as "
+          "possible.\n";
+  cout << "--result-mode store(buffer the whole result) or use(stream the "
+          "rows) for shortct, rqps and replay.\n";
+  cout << "--output-format none, json(lines) or csv time series of the "
+          "intervals and the summary.\n";
+  cout << "--output-file file of --output-format, csv writes each record "
+          "type to FILE with the type before the extension.\n";
+  cout << "--warmup-time seconds of sct left out of the summary after all "
+          "threads started.\n";
+  cout << "--warmup-ops operations of sct left out of the summary.\n";
+  cout << "--steady-cv after warmup, also wait until the tps of the last 5 "
+          "intervals varies less than this (e.g. 0.05).\n";
+  cout << "--cpu-affinity cpus the workers are pinned to, a list like "
+          "0-7,16 or auto(spread over cores and numa nodes, avoiding the "
+          "nic interrupt cpus).\n";
+  cout << "--sweep none, geometric(1, 2, 4, ... up to --concurrency "
+          "workers) or adaptive(bisect the knee) concurrency sweep of sct.\n";
+  cout << "--sweep-step-time seconds each sweep step runs.\n";
+  cout << "--sweep-knee-p99 p99 growth against one worker that marks the "
+          "knee, 0 ignores the latency.\n";
+  cout << "--sweep-knee-failed failure rate growth in percentage points "
+          "that marks the knee, 0 ignores failures.\n";
+  cout << "--dist-listen coordinate --dist-workers processes of sct on "
+          "host:port or a unix socket path, they get this command line.\n";
+  cout << "--dist-workers number of worker processes of the coordinator.\n";
+  cout << "--dist-connect run as a worker of the coordinator at host:port or "
+          "a unix socket path.\n";
 }
 
 bool verify_variables() {
   bool res = true;
+  if (test_mode == TestMode::REMAIN_QPS && test_time == 0) {
+    test_time = 60;
+  }
+  if (iterations == 0) {
+    // a time bounded sct or shortct run is not cut short by the default,
+    // nor is a sweep.
+    iterations = (test_time != 0 && test_mode != TestMode::REMAIN_QPS) ||
+                         sweep_mode != SWEEP_NONE
+                     ? UINT64_MAX
+                     : 100000;
+  }
   cout << "Input parameters: " << endl;
   if (host_rw)
     cout << "host-rw: " << host_rw << endl;
@@ -253,6 +768,60 @@ bool verify_variables() {
   cout << "sleep-after-fail: " << sleep_after_sct_failed << endl;
   cout << "test-time: " << test_time << endl;
   cout << "test-qps: " << test_qps << endl;
+  cout << "lag-mode: " << lag_mode << endl;
+  cout << "lag-timeout-us: " << lag_timeout_us << endl;
+  cout << "lag-poll-us: " << lag_poll_us << endl;
+  cout << "lag-poll-max-us: " << lag_poll_max_us << endl;
+  cout << "ps-mode: " << ps_mode << endl;
+  cout << "prepare-batch: " << prepare_batch << endl;
+  cout << "prepare-threads: " << prepare_threads << endl;
+  cout << "prepare-method: "
+       << (prepare_method == PREPARE_LOAD_DATA ? "load" : "insert") << endl;
+  cout << "prepare-drop-pk: " << prepare_drop_pk << endl;
+  cout << "select-after-insert: " << select_after_insert << endl;
+  cout << "seed: " << rand_seed << endl;
+  cout << "rand-type: " << rand_type_names[rand_type] << endl;
+  cout << "zipf-theta: " << zipf_theta << endl;
+  cout << "hotspot-ops: " << hotspot_ops << endl;
+  cout << "hotspot-keys: " << hotspot_keys << endl;
+  cout << "arrival: " << arrival_names[arrival] << endl;
+  cout << "conn-mode: " << conn_mode_names[conn_mode] << endl;
+  cout << "pool-size: " << pool_size << endl;
+  cout << "engine: " << engine_names[engine] << endl;
+  cout << "async-threads: " << async_threads << endl;
+  cout << "ro-pick: " << ro_pick_names[ro_pick] << endl;
+  cout << "ro-subset: " << ro_subset << endl;
+  cout << "ro-barrier: " << ro_barrier_names[ro_barrier] << endl;
+  if (ro_barrier_sql)
+    cout << "ro-barrier-sql: " << ro_barrier_sql << endl;
+  cout << "ro-barrier-timeout-ms: " << ro_barrier_timeout_ms << endl;
+  if (query_file)
+    cout << "query-file: " << query_file << endl;
+  if (replay_file)
+    cout << "replay-file: " << replay_file << endl;
+  cout << "replay-format: " << replay_format_names[replay_format] << endl;
+  cout << "replay-speed: " << replay_speed << endl;
+  cout << "result-mode: " << result_mode_names[result_mode] << endl;
+  cout << "output-format: " << output_format_names[output_format] << endl;
+  if (output_file)
+    cout << "output-file: " << output_file << endl;
+  cout << "warmup-time: " << warmup_time << endl;
+  cout << "warmup-ops: " << warmup_ops << endl;
+  cout << "steady-cv: " << steady_cv << endl;
+  if (cpu_affinity)
+    cout << "cpu-affinity: " << cpu_affinity << endl;
+  cout << "sweep: " << sweep_mode_names[sweep_mode] << endl;
+  if (sweep_mode != SWEEP_NONE) {
+    cout << "sweep-step-time: " << sweep_step_time << endl;
+    cout << "sweep-knee-p99: " << sweep_knee_p99 << endl;
+    cout << "sweep-knee-failed: " << sweep_knee_failed << endl;
+  }
+  if (dist_listen) {
+    cout << "dist-listen: " << dist_listen << endl;
+    cout << "dist-workers: " << dist_workers << endl;
+  }
+  if (dist_connect)
+    cout << "dist-connect: " << dist_connect << endl;
   cout << "###########################################" << endl;
 
   if (test_mode == TestMode::CONSISTENT) {
@@ -270,6 +839,21 @@ bool verify_variables() {
       std::cerr << "miss port_rw.\n";
       res = false;
     }
+
+    if (host_ro != nullptr && !parse_endpoints(host_ro, port_ro, ro_endpoints)) {
+      std::cerr << "wrong host_ro, or miss port_ro.\n";
+      res = false;
+    }
+    if (ro_subset == 0 || ro_subset > ro_endpoints.size()) {
+      ro_subset = ro_endpoints.size();
+    }
+
+    if ((ro_barrier == BARRIER_SESSION_SQL ||
+         ro_barrier == BARRIER_READ_SQL) &&
+        ro_barrier_sql == nullptr) {
+      std::cerr << "miss ro-barrier-sql.\n";
+      res = false;
+    }
   } else if (test_mode == TestMode::SHORT_CONNECT ||
              test_mode == TestMode::REMAIN_QPS) {
     if (host == nullptr) {
@@ -280,6 +864,22 @@ bool verify_variables() {
       std::cerr << "miss port.\n";
       res = false;
     }
+  } else if (test_mode == TestMode::REPLAY) {
+    if (host == nullptr) {
+      std::cerr << "miss host \n";
+      res = false;
+    }
+    if (port == 0) {
+      std::cerr << "miss port.\n";
+      res = false;
+    }
+    if (replay_file == nullptr) {
+      std::cerr << "miss replay-file.\n";
+      res = false;
+    }
+    if (replay_speed < 0) {
+      replay_speed = 0;
+    }
   } else {
     std::cerr << "wrong test mode: " << test_mode << endl;
     std::cerr << "only suport sct, shotct mode now" << endl;
@@ -291,6 +891,98 @@ bool verify_variables() {
     res = false;
   }
 
+  if (warmup_time != 0 || warmup_ops != 0 || steady_cv != 0) {
+    if (test_mode != TestMode::CONSISTENT) {
+      std::cerr << "warmup only supports sct mode.\n";
+      res = false;
+    }
+    if (report_interval == 0) {
+      std::cerr << "warmup needs --report-interval.\n";
+      res = false;
+    }
+  }
+
+  if (sweep_mode != SWEEP_NONE) {
+    if (test_mode != TestMode::CONSISTENT) {
+      std::cerr << "sweep only supports sct mode.\n";
+      res = false;
+    }
+    if (sweep_step_time == 0) {
+      std::cerr << "sweep needs --sweep-step-time.\n";
+      res = false;
+    }
+    if (test_time != 0) {
+      std::cerr << "sweep runs --sweep-step-time per step, "
+                   "do not set --test-time.\n";
+      res = false;
+    }
+    if (warmup_time != 0 || warmup_ops != 0 || steady_cv != 0) {
+      std::cerr << "warmup does not apply to sweep.\n";
+      res = false;
+    }
+  }
+
+  if (dist_listen != nullptr || dist_connect != nullptr) {
+    if (dist_listen != nullptr && dist_connect != nullptr) {
+      std::cerr << "a process is either the coordinator or a worker.\n";
+      res = false;
+    }
+    if (dist_listen != nullptr && dist_workers == 0) {
+      std::cerr << "miss dist-workers.\n";
+      res = false;
+    }
+    if (test_mode != TestMode::CONSISTENT) {
+      std::cerr << "distributed runs only support sct mode.\n";
+      res = false;
+    }
+    if (report_interval == 0) {
+      std::cerr << "distributed runs need --report-interval.\n";
+      res = false;
+    }
+    if (sweep_mode != SWEEP_NONE || warmup_time != 0 || warmup_ops != 0 ||
+        steady_cv != 0) {
+      std::cerr << "distributed runs do not support sweep or warmup.\n";
+      res = false;
+    }
+  }
+
+  if (cpu_affinity != nullptr && !parse_cpu_affinity(cpu_affinity)) {
+    res = false;
+  }
+
+  if (output_format != OUTPUT_NONE && output_file == nullptr) {
+    std::cerr << "miss output-file.\n";
+    res = false;
+  }
+
+  if (engine == ENGINE_ASYNC) {
+#ifndef MYSQL_WAIT_READ
+    std::cerr << "async engine needs a client library with the nonblocking "
+                 "API (mysql_*_start/_cont), use --engine=thread.\n";
+    res = false;
+#endif
+    if (test_mode == TestMode::REPLAY) {
+      std::cerr << "async engine does not support replay mode.\n";
+      res = false;
+    }
+    if (test_mode == TestMode::CONSISTENT &&
+        (ps_mode || sweep_mode != SWEEP_NONE)) {
+      std::cerr << "async engine does not support --ps-mode and --sweep.\n";
+      res = false;
+    }
+    if (test_mode == TestMode::REMAIN_QPS && conn_mode == CONN_POOL) {
+      std::cerr << "async engine does not support --conn-mode=pool.\n";
+      res = false;
+    }
+    if (result_mode == RESULT_USE) {
+      std::cerr << "async engine only supports --result-mode=store.\n";
+      res = false;
+    }
+    if (async_threads == 0) {
+      async_threads = 1;
+    }
+  }
+
   return res;
 }
 
@@ -300,6 +992,96 @@ void free_option() {
     test_mode_str = nullptr;
   }
 
+  if (prepare_method_str != nullptr) {
+    free(prepare_method_str);
+    prepare_method_str = nullptr;
+  }
+
+  if (rand_type_str != nullptr) {
+    free(rand_type_str);
+    rand_type_str = nullptr;
+  }
+
+  if (arrival_str != nullptr) {
+    free(arrival_str);
+    arrival_str = nullptr;
+  }
+
+  if (conn_mode_str != nullptr) {
+    free(conn_mode_str);
+    conn_mode_str = nullptr;
+  }
+
+  if (engine_str != nullptr) {
+    free(engine_str);
+    engine_str = nullptr;
+  }
+
+  if (ro_pick_str != nullptr) {
+    free(ro_pick_str);
+    ro_pick_str = nullptr;
+  }
+
+  if (ro_barrier_str != nullptr) {
+    free(ro_barrier_str);
+    ro_barrier_str = nullptr;
+  }
+
+  if (ro_barrier_sql != nullptr) {
+    free(ro_barrier_sql);
+    ro_barrier_sql = nullptr;
+  }
+
+  if (query_file != nullptr) {
+    free(query_file);
+    query_file = nullptr;
+  }
+
+  if (replay_file != nullptr) {
+    free(replay_file);
+    replay_file = nullptr;
+  }
+
+  if (replay_format_str != nullptr) {
+    free(replay_format_str);
+    replay_format_str = nullptr;
+  }
+
+  if (result_mode_str != nullptr) {
+    free(result_mode_str);
+    result_mode_str = nullptr;
+  }
+
+  if (output_format_str != nullptr) {
+    free(output_format_str);
+    output_format_str = nullptr;
+  }
+
+  if (output_file != nullptr) {
+    free(output_file);
+    output_file = nullptr;
+  }
+
+  if (cpu_affinity != nullptr) {
+    free(cpu_affinity);
+    cpu_affinity = nullptr;
+  }
+
+  if (sweep_mode_str != nullptr) {
+    free(sweep_mode_str);
+    sweep_mode_str = nullptr;
+  }
+
+  if (dist_listen != nullptr) {
+    free(dist_listen);
+    dist_listen = nullptr;
+  }
+
+  if (dist_connect != nullptr) {
+    free(dist_connect);
+    dist_connect = nullptr;
+  }
+
   if (host != nullptr) {
     free(host);
     host = nullptr;
@@ -3,6 +3,8 @@
 
 #include <atomic>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 void usage();
 bool parse_option(int argc, char *argv[]);
@@ -13,6 +15,99 @@ enum TestMode {
   CONSISTENT,
   SHORT_CONNECT,
   REMAIN_QPS,
+  REPLAY,
+};
+
+// log format of the replay mode.
+enum ReplayFormat {
+  REPLAY_GENERAL_LOG,
+  REPLAY_SLOW_LOG,
+};
+
+enum PrepareMethod {
+  PREPARE_INSERT,
+  PREPARE_LOAD_DATA,
+};
+
+// closed: the next query is paced after the previous one finished, open
+// (constant/poisson): queries are scheduled regardless of completions.
+enum ArrivalProcess {
+  ARRIVAL_CLOSED,
+  ARRIVAL_CONSTANT,
+  ARRIVAL_POISSON,
+};
+
+// connection lifecycle of the rqps mode.
+enum ConnLifecycle {
+  CONN_PER_QUERY,
+  CONN_PER_BATCH,
+  CONN_PERSISTENT,
+  CONN_POOL,
+};
+
+// store buffers every result in the client, use streams the rows.
+enum ResultMode {
+  RESULT_STORE,
+  RESULT_USE,
+};
+
+// machine readable report written next to the text output.
+enum OutputFormat {
+  OUTPUT_NONE,
+  OUTPUT_JSON,
+  OUTPUT_CSV,
+};
+
+// concurrency sweep of sct: geometric steps 1, 2, 4, ... up to
+// --concurrency, adaptive stops doubling at the knee and bisects it.
+enum SweepMode {
+  SWEEP_NONE,
+  SWEEP_GEOMETRIC,
+  SWEEP_ADAPTIVE,
+};
+
+// thread: one thread per --concurrency session, async: --async-threads
+// event loops drive all sessions.
+enum ClientEngine {
+  ENGINE_THREAD,
+  ENGINE_ASYNC,
+};
+
+// which RO endpoints each consistency check reads.
+enum ReplicaPick {
+  PICK_ALL,
+  PICK_ROUND_ROBIN,
+  PICK_RANDOM,
+};
+
+// what sct does on RO before the consistency read, to wait for the write.
+// gtid-wait: MySQL WAIT_FOR_EXECUTED_GTID_SET with the tracked GTID,
+// mariadb-gtid-wait: MariaDB MASTER_GTID_WAIT with the tracked last_gtid,
+// session: --ro-barrier-sql once per RO connection (session consistency
+// levels), sql: --ro-barrier-sql before every read.
+enum ReadBarrier {
+  BARRIER_NONE,
+  BARRIER_GTID_WAIT,
+  BARRIER_MARIADB_GTID_WAIT,
+  BARRIER_SESSION_SQL,
+  BARRIER_READ_SQL,
+};
+
+struct Endpoint {
+  std::string host;
+  unsigned int port;
+};
+
+// parse "host[:port],host[:port]...", port defaults to default_port.
+bool parse_endpoints(const char *list, unsigned int default_port,
+                     std::vector<Endpoint> &endpoints);
+
+enum KeyDistribution {
+  DIST_UNIFORM,
+  DIST_ZIPFIAN,
+  DIST_HOTSPOT,
+  DIST_SEQUENTIAL,
+  DIST_LATEST,
 };
 
 class Statistics {
@@ -41,6 +136,12 @@ public:
     m_cnt_failed.store(0);
   }
 
+  // this = this - base, base is an older copy of the same counters.
+  void subtract(Statistics &base) {
+    m_cnt.store(m_cnt.load() - base.get_cnt_total());
+    m_cnt_failed.store(m_cnt_failed.load() - base.get_cnt_failed());
+  }
+
 private:
   std::atomic<uint64_t> m_cnt{0};
   std::atomic<uint64_t> m_cnt_failed{0};
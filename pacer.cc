@@ -0,0 +1,73 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : pacer.cc
+ * @Description  : per thread rate limiter for the rqps mode.
+ */
+
+#include "pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+// sleep at most this long at once so stop requests are noticed quickly.
+static const uint64_t kMaxSleepNs = 100 * 1000 * 1000;
+// the bucket holds 10ms worth of tokens, at least one.
+static const uint64_t kBucketNs = 10 * 1000 * 1000;
+
+uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+Pacer::Pacer(double rate, uint64_t index, uint64_t count,
+             ArrivalProcess arrival)
+    : m_arrival_(arrival), m_rand_(thread_seed(index)) {
+  if (rate <= 0) {
+    return;
+  }
+  m_interval_ns_ = std::max<uint64_t>(1, (uint64_t)(1e9 / rate));
+  m_max_debt_ns_ = std::max(m_interval_ns_, kBucketNs);
+  m_next_ns_ =
+      monotonic_ns() + m_interval_ns_ * index / std::max<uint64_t>(count, 1);
+}
+
+uint64_t Pacer::wait(const std::atomic_bool &stop) {
+  uint64_t slot = next_slot();
+  uint64_t now = monotonic_ns();
+  while (now < slot && !stop) {
+    uint64_t wake = std::min(slot, now + kMaxSleepNs);
+    struct timespec ts;
+    ts.tv_sec = wake / 1000000000ULL;
+    ts.tv_nsec = wake % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    now = monotonic_ns();
+  }
+  return slot;
+}
+
+uint64_t Pacer::next_slot() {
+  uint64_t now = monotonic_ns();
+  if (m_interval_ns_ == 0) {
+    return now;
+  }
+
+  // closed loop drops what it could not send in time, open loop keeps the
+  // schedule and sends the backlog as fast as it can.
+  if (!open_loop() && now > m_next_ns_ + m_max_debt_ns_) {
+    m_next_ns_ = now;
+  }
+
+  uint64_t slot = m_next_ns_;
+  m_next_ns_ += next_interval();
+  return slot;
+}
+
+uint64_t Pacer::next_interval() {
+  if (m_arrival_ != ARRIVAL_POISSON) {
+    return m_interval_ns_;
+  }
+  // exponential inter-arrival times with the same mean.
+  return (uint64_t)(-log(1.0 - m_rand_.next_double()) * m_interval_ns_);
+}
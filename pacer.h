@@ -0,0 +1,50 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : pacer.h
+ * @Description  : per thread rate limiter for the rqps mode. Each thread
+ *                 owns a token bucket refilled at qps / concurrency and
+ *                 sleeps until its next send slot with an absolute timer.
+ *                 In open loop mode the send slots are a fixed schedule
+ *                 (constant or poisson arrivals) that never waits for
+ *                 slow queries, the slot is the intended send time.
+ */
+
+#ifndef PACER_H
+#define PACER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "options.h"
+#include "rand_gen.h"
+
+uint64_t monotonic_ns();
+
+class Pacer {
+public:
+  // rate: operations per second of this thread, 0 means unlimited. index and
+  // count spread the first slot of count pacers evenly over one interval.
+  Pacer(double rate, uint64_t index, uint64_t count, ArrivalProcess arrival);
+
+  bool open_loop() const { return m_arrival_ != ARRIVAL_CLOSED; }
+
+  // sleep until the next slot, returns its scheduled time (monotonic_ns), or
+  // early once stop is set.
+  uint64_t wait(const std::atomic_bool &stop);
+  // take the next slot without sleeping, for callers that wait on their
+  // own (the async engine).
+  uint64_t next_slot();
+
+private:
+  uint64_t next_interval();
+
+  ArrivalProcess m_arrival_;
+  FastRand m_rand_;
+  uint64_t m_interval_ns_{0};
+  uint64_t m_next_ns_{0};
+  // how far the schedule may fall behind before it is reset instead of
+  // caught up with a burst, i.e. the bucket depth.
+  uint64_t m_max_debt_ns_{0};
+};
+
+#endif // PACER_H
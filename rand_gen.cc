@@ -0,0 +1,117 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : rand_gen.cc
+ * @Description  : per thread pseudo random generators and key distributions.
+ */
+
+#include "rand_gen.h"
+
+#include <algorithm>
+#include <cmath>
+
+extern uint64_t concurrency;
+extern uint64_t rand_seed;
+extern KeyDistribution rand_type;
+extern double zipf_theta;
+extern uint64_t hotspot_ops;
+extern uint64_t hotspot_keys;
+
+static uint64_t splitmix64(uint64_t &x) {
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t thread_seed(uint64_t thread_id) {
+  uint64_t x = rand_seed ^ (thread_id * 0xd1b54a32d192ed03ULL);
+  return splitmix64(x);
+}
+
+FastRand::FastRand(uint64_t seed) {
+  for (int i = 0; i < 4; i++) {
+    m_s_[i] = splitmix64(seed);
+  }
+}
+
+/*
+  zeta(n, theta) = sum(1 / i^theta), i = 1..n. Summed exactly for the first
+  2^20 terms, the tail uses the Euler-Maclaurin approximation so large key
+  spaces do not cost seconds at startup.
+*/
+static double zeta(uint64_t n, double theta) {
+  const uint64_t exact = std::min<uint64_t>(n, 1 << 20);
+  double sum = 0;
+  for (uint64_t i = 1; i <= exact; i++) {
+    sum += 1.0 / pow((double)i, theta);
+  }
+  if (n > exact) {
+    double m = (double)exact;
+    double dn = (double)n;
+    sum += (pow(dn, 1 - theta) - pow(m, 1 - theta)) / (1 - theta);
+    sum += 0.5 * (pow(dn, -theta) - pow(m, -theta));
+  }
+  return sum;
+}
+
+ZipfianGenerator::ZipfianGenerator(uint64_t n, double theta) {
+  m_n_ = std::max<uint64_t>(n, 2);
+  m_theta_ = std::min(std::max(theta, 0.01), 0.999);
+  m_alpha_ = 1.0 / (1.0 - m_theta_);
+  m_zetan_ = zeta(m_n_, m_theta_);
+  double zeta2 = zeta(2, m_theta_);
+  m_eta_ = (1 - pow(2.0 / m_n_, 1 - m_theta_)) / (1 - zeta2 / m_zetan_);
+  m_half_pow_theta_ = 1 + pow(0.5, m_theta_);
+}
+
+uint64_t ZipfianGenerator::next(FastRand &rand) const {
+  double u = rand.next_double();
+  double uz = u * m_zetan_;
+  if (uz < 1.0) {
+    return 0;
+  }
+  if (uz < m_half_pow_theta_) {
+    return 1;
+  }
+  uint64_t rank = (uint64_t)(m_n_ * pow(m_eta_ * u - m_eta_ + 1, m_alpha_));
+  return std::min(rank, m_n_ - 1);
+}
+
+KeyGenerator::KeyGenerator(uint64_t key_count, uint64_t thread_id)
+    : m_key_count_(std::max<uint64_t>(key_count, 1)),
+      m_rand_(thread_seed(thread_id)) {
+  if (rand_type == DIST_ZIPFIAN || rand_type == DIST_LATEST) {
+    m_zipf_ = new ZipfianGenerator(m_key_count_, zipf_theta);
+  }
+  m_hot_keys_ = std::max<uint64_t>(1, m_key_count_ * hotspot_keys / 100);
+  // threads walk the key space from different offsets.
+  m_seq_ = m_key_count_ * thread_id / std::max<uint64_t>(concurrency, 1);
+  m_last_written_ = m_key_count_ - 1;
+}
+
+KeyGenerator::~KeyGenerator() { delete m_zipf_; }
+
+uint64_t KeyGenerator::next() {
+  switch (rand_type) {
+  case DIST_ZIPFIAN:
+    return m_zipf_->next(m_rand_);
+
+  case DIST_HOTSPOT:
+    if (m_hot_keys_ >= m_key_count_ || m_rand_.uniform(100) < hotspot_ops) {
+      return m_rand_.uniform(m_hot_keys_);
+    }
+    return m_hot_keys_ + m_rand_.uniform(m_key_count_ - m_hot_keys_);
+
+  case DIST_SEQUENTIAL:
+    return m_seq_++ % m_key_count_;
+
+  case DIST_LATEST: {
+    uint64_t back = m_zipf_->next(m_rand_);
+    return (m_last_written_ + m_key_count_ - back) % m_key_count_;
+  }
+
+  case DIST_UNIFORM:
+  default:
+    return m_rand_.uniform(m_key_count_);
+  }
+}
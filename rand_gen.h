@@ -0,0 +1,90 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : rand_gen.h
+ * @Description  : per thread pseudo random generators and key distributions.
+ *                 rand() takes a global lock in glibc, every worker owns its
+ *                 own generator here, seeded from --seed and its thread id.
+ */
+
+#ifndef RAND_GEN_H
+#define RAND_GEN_H
+
+#include <cstdint>
+
+#include "options.h"
+
+// xoshiro256**, seeded through splitmix64.
+class FastRand {
+public:
+  explicit FastRand(uint64_t seed);
+
+  uint64_t next() {
+    uint64_t result = rotl(m_s_[1] * 5, 7) * 9;
+    uint64_t t = m_s_[1] << 17;
+    m_s_[2] ^= m_s_[0];
+    m_s_[3] ^= m_s_[1];
+    m_s_[1] ^= m_s_[2];
+    m_s_[0] ^= m_s_[3];
+    m_s_[2] ^= t;
+    m_s_[3] = rotl(m_s_[3], 45);
+    return result;
+  }
+
+  // uniform in [0, n), multiply-shift instead of modulo.
+  uint64_t uniform(uint64_t n) {
+    return (uint64_t)(((unsigned __int128)next() * n) >> 64);
+  }
+
+  // uniform in [0, 1)
+  double next_double() { return (next() >> 11) * (1.0 / (1ULL << 53)); }
+
+private:
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  uint64_t m_s_[4];
+};
+
+// Zipfian ranks in [0, n), rank 0 is the most popular (Gray et al., as in
+// YCSB). theta must be in (0, 1).
+class ZipfianGenerator {
+public:
+  ZipfianGenerator(uint64_t n, double theta);
+
+  uint64_t next(FastRand &rand) const;
+
+private:
+  uint64_t m_n_;
+  double m_theta_;
+  double m_alpha_;
+  double m_zetan_;
+  double m_eta_;
+  double m_half_pow_theta_;
+};
+
+// Keys in [0, key_count) following --rand-type, one instance per thread.
+class KeyGenerator {
+public:
+  KeyGenerator(uint64_t key_count, uint64_t thread_id);
+  ~KeyGenerator();
+
+  uint64_t next();
+  // the latest distribution picks keys close to the last written one.
+  void written(uint64_t key) { m_last_written_ = key; }
+  FastRand &rand() { return m_rand_; }
+
+private:
+  KeyGenerator(const KeyGenerator &) = delete;
+  void operator=(const KeyGenerator &) = delete;
+
+  uint64_t m_key_count_;
+  FastRand m_rand_;
+  ZipfianGenerator *m_zipf_{nullptr};
+  uint64_t m_hot_keys_{0};
+  uint64_t m_seq_{0};
+  uint64_t m_last_written_{0};
+};
+
+// seed of the generator of a thread, derived from --seed.
+uint64_t thread_seed(uint64_t thread_id);
+
+#endif // RAND_GEN_H
@@ -1,104 +1,217 @@
 #include "remain_qps.h"
+#include "async_engine.h"
+#include "async_log.h"
+#include "conn_pool.h"
+#include "cpu_affinity.h"
+#include "histogram.h"
 #include "options.h"
+#include "report_writer.h"
+#include "result_reader.h"
+#include "stop_signal.h"
 #include <atomic>
 #include <cstdint>
+#include <functional>
 #include <iostream>
+#include <mysql/errmsg.h>
 #include <mysql/mysql.h>
 #include <thread>
 #include <unistd.h>
 
 extern uint detail_log;
+extern char *user;
+extern char *password;
+extern char *host;
+extern uint port;
 extern char *database;
 extern uint64_t report_interval;
 extern uint64_t test_time;
 extern uint64_t concurrency;
 extern uint64_t test_qps;
+extern ArrivalProcess arrival;
+extern ConnLifecycle conn_mode;
+extern uint64_t pool_size;
+extern ClientEngine engine;
+extern uint64_t async_threads;
 
 static Statistics qps_state;
-static Statistics qps_per_second;
+// service time: query sent to result read.
+static LatencyStats query_latency;
+// open loop only, response time: intended send time to result read, this
+// includes the time a query waited behind slow ones (coordinated omission).
+static LatencyStats response_latency;
+// connection churn, kept apart from the query throughput.
+// conn_state: total is connects, failed is failed connects.
+static Statistics conn_state;
+static Statistics disconn_state;
+static LatencyStats connect_latency;
+static ConnectionPool *conn_pool = nullptr;
+// per class of the workload.
+struct ClassStats {
+  Statistics state;
+  LatencyStats latency;
+};
+static std::vector<ClassStats *> class_stats;
+static const Workload *class_names = nullptr;
 static std::atomic<uint32_t> active_threads{0};
-static std::atomic<time_t> pre_time{0};
-
-static std::atomic_bool can_continue{true};
-static std::atomic_bool should_quit{false};
-
-void RemainQPSTest::run(const std::vector<std::string> &querys) {
-  while (!should_quit) {
-    if (can_continue) {
-      conns_prepare();
-      basic_query(querys);
-      conns_close();
-    } else {
-      usleep(1);
+
+static MYSQL *open_connection(uint64_t thread_id) {
+  uint64_t start_us = now_us();
+  MYSQL *conn = mysql_init(0);
+  if (conn == nullptr) {
+    AsyncLog(LOG_ERROR, LOG_SITE_CONNECT) << "Failed to init m_conn_ ";
+    conn_state.increase_cnt_failed();
+    return nullptr;
+  }
+
+  if (!mysql_real_connect(conn, host, user, password, database, port, nullptr,
+                          0)) {
+    AsyncLog(LOG_ERROR, LOG_SITE_CONNECT, mysql_errno(conn))
+        << "Failed to connect to MySql. errno: " << mysql_errno(conn)
+        << ",errmsg: " << mysql_error(conn);
+    mysql_close(conn);
+    conn_state.increase_cnt_failed();
+    return nullptr;
+  }
+
+  conn_state.increase_cnt_total();
+  connect_latency.record(thread_id, now_us() - start_us);
+  return conn;
+}
+
+static void close_connection(MYSQL *conn) {
+  mysql_close(conn);
+  disconn_state.increase_cnt_total();
+}
+
+// client side errors (CR_*) mean the connection itself is unusable.
+static bool connection_broken(MYSQL *conn) {
+  return mysql_errno(conn) >= CR_MIN_ERROR;
+}
+
+int RemainQPSTest::acquire() {
+  if (m_conn_ != nullptr) {
+    return 0;
+  }
+  m_conn_ = conn_mode == CONN_POOL
+                ? conn_pool->checkout(m_thread_id_, stop_requested)
+                : open_connection(m_thread_id_);
+  return m_conn_ != nullptr ? 0 : -1;
+}
+
+void RemainQPSTest::release(bool broken) {
+  if (m_conn_ == nullptr) {
+    return;
+  }
+  if (conn_mode == CONN_POOL) {
+    conn_pool->checkin(m_conn_, broken);
+  } else {
+    close_connection(m_conn_);
+  }
+  m_conn_ = nullptr;
+}
+
+void RemainQPSTest::run(const Workload &workload) {
+  WorkloadCursor cursor(workload, m_thread_id_, concurrency);
+  while (!stop_requested) {
+    basic_query(cursor);
+    if (conn_mode == CONN_PER_BATCH) {
+      release(false);
     }
   }
+  release(false);
 }
 
-int RemainQPSTest::basic_query(const std::vector<std::string> &querys) {
+int RemainQPSTest::basic_query(WorkloadCursor &cursor) {
   int res = 0;
-  MYSQL_RES *mysql_res = nullptr;
-  MYSQL_ROW row;
 
-  for (auto &query : querys) {
-    if (!can_continue) {
+  for (size_t i = 0; i < cursor.pass_size(); i++) {
+    uint64_t intended_ns = m_pacer_.wait(stop_requested);
+    if (stop_requested) {
       break;
     }
-    res = mysql_query(m_conn_, query.data());
+    if (acquire() != 0) {
+      qps_state.increase_cnt_failed();
+      return -1;
+    }
+
+    const std::string &query = cursor.next(i);
+    ClassStats *stats = class_stats[cursor.last_class()];
+    uint64_t start_ns = monotonic_ns();
+    res = mysql_real_query(m_conn_, query.data(), query.size());
+    if (res == 0) {
+      res = read_result(m_conn_);
+    }
     if (res != 0) {
       qps_state.increase_cnt_failed();
-      qps_per_second.increase_cnt_failed();
-      std::cout << "Failed to test consistency, sql: " << query
-                << ", errno: " << mysql_errno(m_conn_)
-                << ", errmsg: " << mysql_error(m_conn_);
+      stats->state.increase_cnt_failed();
+      AsyncLog(LOG_ERROR, LOG_SITE_QUERY, mysql_errno(m_conn_))
+          << "Failed to run rqps query, sql: " << query << ", errno: "
+          << mysql_errno(m_conn_) << ", errmsg: " << mysql_error(m_conn_);
+      bool broken = connection_broken(m_conn_);
+      if (broken || conn_mode == CONN_PER_QUERY || conn_mode == CONN_POOL) {
+        release(broken);
+      }
       return -1;
     }
+    // taken before the release, so the close or pool check-in of
+    // --conn-mode=query|pool is not part of the query latency.
+    uint64_t done_ns = monotonic_ns();
     qps_state.increase_cnt_total();
-    qps_per_second.increase_cnt_total();
+    query_latency.record(m_thread_id_, (done_ns - start_ns) / 1000);
+    stats->state.increase_cnt_total();
+    stats->latency.record(m_thread_id_, (done_ns - start_ns) / 1000);
+    if (m_pacer_.open_loop()) {
+      response_latency.record(m_thread_id_, (done_ns - intended_ns) / 1000);
+    }
 
-    mysql_res = mysql_store_result(m_conn_);
-    mysql_free_result(mysql_res);
+    if (conn_mode == CONN_PER_QUERY || conn_mode == CONN_POOL) {
+      release(false);
+    }
   }
 
   return res;
 }
 
-void start_detect_qps() {
-  while (!should_quit) {
-    time_t now_time = time(nullptr);
-    if (now_time == pre_time) {
-      if (qps_per_second.get_cnt_total() >= test_qps) {
-        can_continue.store(false);
-      }
-    } else {
-      qps_per_second.clear();
-      can_continue.store(true);
-      pre_time = now_time;
-    }
-    usleep(1);
-  }
-}
-
-void start_remain_qps_test(int thread_id,
-                           const std::vector<std::string> &querys) {
+void start_remain_qps_test(int thread_id, const Workload &workload) {
   if (detail_log) {
-    std::cout << "start thread: " << thread_id << std::endl;
+    AsyncLog(LOG_INFO, LOG_SITE_THREAD) << "start thread: " << thread_id;
   }
 
-  RemainQPSTest t(database, 0, test_qps);
-  t.run(querys);
+  pin_worker(thread_id);
+  RemainQPSTest t(database, test_qps, thread_id, concurrency, arrival);
+  {
+    WorkerCpuTime cpu_time(thread_id);
+    t.run(workload);
+  }
   t.cleanup();
   active_threads--;
 
   if (detail_log) {
-    std::cout << "stop thread: " << thread_id << std::endl;
+    AsyncLog(LOG_INFO, LOG_SITE_THREAD) << "stop thread: " << thread_id;
   }
   return;
 }
 
+// how far the achieved rate is off the target, in percent.
+static double qps_drift(double qps) {
+  return test_qps ? (qps - test_qps) * 100.0 / test_qps : 0;
+}
+
+static uint64_t run_start_us = 0;
+
 static void print_result_interval() {
 
   Statistics new_state, pre_state;
   pre_state = qps_state;
+  IntervalHistogram query_interval(query_latency);
+  IntervalHistogram response_interval(response_latency);
+  Statistics new_conn_state, pre_conn_state, new_disconn_state,
+      pre_disconn_state;
+  pre_conn_state = conn_state;
+  pre_disconn_state = disconn_state;
+  uint64_t pre_us = now_us();
+  uint64_t pre_rows = result_rows.load();
+  uint64_t pre_bytes = result_bytes.load();
 
   time_t start_time = time(NULL);
   time_t end_time;
@@ -106,19 +219,72 @@ static void print_result_interval() {
     while (active_threads.load() != 0) {
       sleep(report_interval);
       new_state = qps_state;
-      std::cout << "qps: "
-                << (new_state.get_cnt_total() - pre_state.get_cnt_total()) /
-                       report_interval;
-      std::cout << ", failed qps: "
-                << (new_state.get_cnt_failed() - pre_state.get_cnt_failed()) /
-                       report_interval;
+      uint64_t cur_us = now_us();
+      double qps = (new_state.get_cnt_total() - pre_state.get_cnt_total()) *
+                   1e6 / (cur_us - pre_us);
+      uint64_t failed_qps =
+          (new_state.get_cnt_failed() - pre_state.get_cnt_failed()) /
+          report_interval;
+      const Histogram &query_hist = query_interval.next();
+      ReportRecord *record =
+          report_enabled() ? new ReportRecord("interval") : nullptr;
+      std::cout << "qps: " << (uint64_t)qps;
+      std::cout << ", failed qps: " << failed_qps;
+      std::cout << ", target qps: " << test_qps << ", drift: " << std::showpos
+                << qps_drift(qps) << std::noshowpos << "%";
+      std::cout << ", lat(us): [" << query_hist.percentile_summary() << "]";
+      if (record) {
+        record->add("qps", qps).add("failed_qps", failed_qps);
+        record->add("target_qps", test_qps).add("drift_pct", qps_drift(qps));
+        record->add_latency("lat", query_hist);
+      }
+      if (arrival != ARRIVAL_CLOSED) {
+        const Histogram &response_hist = response_interval.next();
+        std::cout << ", resp lat(us): [" << response_hist.percentile_summary()
+                  << "]";
+        if (record) {
+          record->add_latency("resp_lat", response_hist);
+        }
+      }
+      uint64_t rows = result_rows.load();
+      uint64_t bytes = result_bytes.load();
+      uint64_t rows_ps = (rows - pre_rows) * 1e6 / (cur_us - pre_us);
+      uint64_t bytes_ps = (bytes - pre_bytes) * 1e6 / (cur_us - pre_us);
+      std::cout << ", rows/s: " << rows_ps << ", bytes/s: " << bytes_ps;
+      pre_rows = rows;
+      pre_bytes = bytes;
+      new_conn_state = conn_state;
+      new_disconn_state = disconn_state;
+      uint64_t conn_ps =
+          (new_conn_state.get_cnt_total() - pre_conn_state.get_cnt_total()) /
+          report_interval;
+      uint64_t failed_conn_ps =
+          (new_conn_state.get_cnt_failed() - pre_conn_state.get_cnt_failed()) /
+          report_interval;
+      uint64_t disconn_ps = (new_disconn_state.get_cnt_total() -
+                             pre_disconn_state.get_cnt_total()) /
+                            report_interval;
+      std::cout << ", conn/s: " << conn_ps
+                << ", failed conn/s: " << failed_conn_ps
+                << ", disconn/s: " << disconn_ps;
       std::cout << ", active threads : " << active_threads.load() << std::endl;
+      if (record) {
+        record->add("rows_ps", rows_ps).add("bytes_ps", bytes_ps);
+        record->add("conn_ps", conn_ps)
+            .add("failed_conn_ps", failed_conn_ps)
+            .add("disconn_ps", disconn_ps);
+        record->add("active_threads", (uint64_t)active_threads.load());
+        report_emit(record);
+      }
 
       pre_state = new_state;
+      pre_conn_state = new_conn_state;
+      pre_disconn_state = new_disconn_state;
+      pre_us = cur_us;
       end_time = time(NULL);
       uint64_t run_time = end_time - start_time;
       if (run_time >= test_time) {
-        should_quit.store(true);
+        stop_requested.store(true);
         break;
       }
     }
@@ -129,18 +295,184 @@ static void print_result_summarize() {
   std::cout << "mean qps in all time: " << qps_state.get_cnt_total() / test_time
             << ", failed cnt: " << qps_state.get_cnt_failed() / test_time
             << std::endl;
+
+  double qps = qps_state.get_cnt_total() * 1e6 / (now_us() - run_start_us);
+  std::cout << "target qps: " << test_qps << ", achieved qps: "
+            << (uint64_t)qps << ", drift: " << std::showpos << qps_drift(qps)
+            << std::noshowpos << "%" << std::endl;
+
+  ReportRecord *record =
+      report_enabled() ? new ReportRecord("summary") : nullptr;
+  if (record) {
+    record->add("total", qps_state.get_cnt_total())
+        .add("failed", qps_state.get_cnt_failed())
+        .add("qps", qps)
+        .add("target_qps", test_qps)
+        .add("drift_pct", qps_drift(qps));
+  }
+
+  Histogram total;
+  query_latency.snapshot(total);
+  std::cout << "Query latency(us): " << total.percentile_summary()
+            << ", avg: " << total.get_mean() << std::endl;
+  if (record) {
+    record->add_latency("lat", total);
+  }
+  std::cout << "connects: " << conn_state.get_cnt_total()
+            << ", failed connects: " << conn_state.get_cnt_failed()
+            << ", disconnects: " << disconn_state.get_cnt_total()
+            << ", queries per connect: "
+            << (conn_state.get_cnt_total()
+                    ? qps_state.get_cnt_total() / conn_state.get_cnt_total()
+                    : 0)
+            << std::endl;
+  connect_latency.snapshot(total);
+  std::cout << "Connect latency(us): " << total.percentile_summary()
+            << ", avg: " << total.get_mean() << std::endl;
+  std::cout << "rows received: " << result_rows.load()
+            << ", bytes received: " << result_bytes.load() << std::endl;
+  if (record) {
+    record->add_latency("connect_lat", total)
+        .add("connects", conn_state.get_cnt_total())
+        .add("failed_connects", conn_state.get_cnt_failed())
+        .add("rows", result_rows.load())
+        .add("bytes", result_bytes.load());
+  }
+  if (arrival != ARRIVAL_CLOSED) {
+    response_latency.snapshot(total);
+    std::cout << "Response latency from intended start(us): "
+              << total.percentile_summary() << ", avg: " << total.get_mean()
+              << std::endl;
+    if (record) {
+      record->add_latency("resp_lat", total);
+    }
+  }
+
+  for (size_t cls = 0; class_stats.size() > 1 && cls < class_stats.size();
+       cls++) {
+    ClassStats *stats = class_stats[cls];
+    stats->latency.snapshot(total);
+    std::cout << "Query " << class_names->class_name(cls)
+              << " cnt: " << stats->state.get_cnt_total()
+              << ", failed cnt: " << stats->state.get_cnt_failed()
+              << ", latency(us): " << total.percentile_summary() << std::endl;
+    if (record) {
+      const std::string &name = class_names->class_name(cls);
+      record->add(name + "_cnt", stats->state.get_cnt_total())
+          .add(name + "_failed", stats->state.get_cnt_failed())
+          .add_latency(name + "_lat", total);
+    }
+  }
+  worker_cpu_summary(record);
+  if (record) {
+    report_emit(record);
+  }
+}
+
+static void init_class_stats(const Workload &workload, size_t threads) {
+  class_names = &workload;
+  for (size_t cls = 0; cls < workload.class_count(); cls++) {
+    class_stats.push_back(new ClassStats());
+    class_stats.back()->latency.init(threads);
+  }
+}
+
+static void free_class_stats() {
+  for (auto stats : class_stats) {
+    delete stats;
+  }
+  class_stats.clear();
+  class_names = nullptr;
+}
+
+// the sessions pace their share of --qps from the event loops.
+static int main_remain_qps_async(const Workload &querys) {
+  AsyncWorkload workload;
+  workload.host = host;
+  workload.port = port;
+  workload.db = database;
+  workload.querys = &querys;
+  workload.lifecycle = conn_mode;
+  workload.rate = (double)test_qps / concurrency;
+  workload.arrival = arrival;
+  workload.on_connect = [](size_t loop, const ConnectTiming &timing,
+                           unsigned int err) {
+    if (err != 0) {
+      conn_state.increase_cnt_failed();
+      return;
+    }
+    conn_state.increase_cnt_total();
+    connect_latency.record(loop, timing.phase_us[0] + timing.phase_us[1] +
+                                     timing.phase_us[2]);
+  };
+  workload.on_query = [](size_t loop, size_t, size_t cls,
+                         uint64_t intended_ns, uint64_t start_ns,
+                         uint64_t done_ns, unsigned int err) {
+    if (err != 0) {
+      qps_state.increase_cnt_failed();
+      class_stats[cls]->state.increase_cnt_failed();
+      return;
+    }
+    qps_state.increase_cnt_total();
+    query_latency.record(loop, (done_ns - start_ns) / 1000);
+    class_stats[cls]->state.increase_cnt_total();
+    class_stats[cls]->latency.record(loop, (done_ns - start_ns) / 1000);
+    if (arrival != ARRIVAL_CLOSED) {
+      response_latency.record(loop, (done_ns - intended_ns) / 1000);
+    }
+  };
+  workload.on_close = [](size_t, uint64_t) {
+    disconn_state.increase_cnt_total();
+  };
+  workload.on_pass = [](size_t, bool) {};
+  workload.on_loop_exit = [](size_t) { active_threads--; };
+
+  AsyncEngine async_engine(concurrency, async_threads);
+  query_latency.init(async_engine.loops());
+  response_latency.init(async_engine.loops());
+  connect_latency.init(async_engine.loops());
+  init_class_stats(querys, async_engine.loops());
+  worker_cpu_init(async_engine.loops());
+  active_threads = async_engine.loops();
+  run_start_us = now_us();
+  if (async_engine.start(workload, stop_requested) != 0) {
+    free_class_stats();
+    return -1;
+  }
+
+  print_result_interval();
+  async_engine.join();
+  print_result_summarize();
+  free_class_stats();
+  return 0;
 }
 
 int main_remain_qps() {
+  Workload workload;
+  if (!get_workload_from_file(workload)) {
+    return -1;
+  }
+  if (engine == ENGINE_ASYNC) {
+    return main_remain_qps_async(workload);
+  }
+
   std::thread *ct_threads[concurrency];
-  std::vector<std::string> querys = get_querys_from_file();
-  pre_time = time(nullptr);
+  query_latency.init(concurrency);
+  response_latency.init(concurrency);
+  connect_latency.init(concurrency);
+  init_class_stats(workload, concurrency);
+  worker_cpu_init(concurrency);
 
-  std::thread *detect_qps_thread = new std::thread(start_detect_qps);
+  // pool connections are opened by the worker that checks out, their
+  // connect latency is recorded in its slot.
+  ConnectionPool pool(pool_size ? pool_size : concurrency,
+                      open_connection, close_connection);
+  conn_pool = &pool;
+  run_start_us = now_us();
 
   for (uint thread_id = 0; thread_id < concurrency; thread_id++) {
     ct_threads[thread_id] =
-        new std::thread(start_remain_qps_test, thread_id, querys);
+        new std::thread(start_remain_qps_test, thread_id, std::cref(workload));
     active_threads++;
   }
 
@@ -151,10 +483,8 @@ int main_remain_qps() {
     delete ct_threads[thread_id];
   }
 
-  detect_qps_thread->join();
-  delete detect_qps_thread;
-
   print_result_summarize();
+  free_class_stats();
 
   return 0;
 }
@@ -1,17 +1,29 @@
 #ifndef REMAIN_QPS_H
 #define REMAIN_QPS_H
 
+#include "pacer.h"
 #include "short_connection.h"
 
 class RemainQPSTest : public ShortConnnectionTest {
  public:
-   RemainQPSTest(const char *db_name, int64_t times, int64_t qps)
-       : ShortConnnectionTest(db_name, times) {
+   // qps is the target of all threads together, each of the threads
+   // paces its own share.
+   RemainQPSTest(const char *db_name, int64_t qps, uint64_t thread_id,
+                 uint64_t threads, ArrivalProcess arrival)
+       : ShortConnnectionTest(db_name, thread_id),
+         m_pacer_((double)qps / threads, thread_id, threads, arrival) {
      test_qps = qps;
    }
-   virtual void run(const std::vector<std::string> &querys);
-   virtual int basic_query(const std::vector<std::string> &querys);
+   virtual void run(const Workload &workload);
+   virtual int basic_query(WorkloadCursor &cursor);
    int test_qps;
+
+ private:
+   // take a connection per --conn-mode, and give it back.
+   int acquire();
+   void release(bool broken);
+
+   Pacer m_pacer_;
 };
 
 int main_remain_qps();
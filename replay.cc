@@ -0,0 +1,735 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : replay.cc
+ * @Description  : replay of a captured general log or slow log.
+ */
+
+#include "replay.h"
+#include "async_log.h"
+#include "cpu_affinity.h"
+#include "histogram.h"
+#include "pacer.h"
+#include "report_writer.h"
+#include "result_reader.h"
+#include "stop_signal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <mysql/errmsg.h>
+#include <mysql/mysql.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+extern char *user;
+extern char *password;
+extern char *database;
+extern char *host;
+extern uint port;
+extern uint detail_log;
+extern uint64_t concurrency;
+extern uint64_t report_interval;
+extern char *replay_file;
+extern ReplayFormat replay_format;
+extern double replay_speed;
+
+static bool starts_with(const char *line, const char *end, const char *prefix) {
+  size_t len = strlen(prefix);
+  return (size_t)(end - line) >= len && memcmp(line, prefix, len) == 0;
+}
+
+static bool read_digits(const char *&p, const char *end, int count,
+                        int &value) {
+  value = 0;
+  for (int i = 0; i < count; i++, p++) {
+    if (p >= end || *p < '0' || *p > '9') {
+      return false;
+    }
+    value = value * 10 + (*p - '0');
+  }
+  return true;
+}
+
+static uint64_t read_uint(const char *&p, const char *end) {
+  uint64_t value = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    value = value * 10 + (*p - '0');
+  }
+  return value;
+}
+
+// days since 1970-01-01 of a civil date.
+static int64_t days_from_civil(int y, int m, int d) {
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/*
+  "2023-03-29T15:21:00.123456Z" (5.7+, the zone is ignored, only the
+  differences matter) or "230329 15:21:00" with the hour space padded
+  (5.6). Returns 0 if it is neither.
+*/
+static uint64_t parse_time_us(const char *p, const char *end) {
+  int y, mo, d, h, mi, s;
+  int64_t frac_us = 0;
+  if (end - p >= 19 && p[4] == '-' && p[10] == 'T') {
+    if (!read_digits(p, end, 4, y) || *p++ != '-' ||
+        !read_digits(p, end, 2, mo) || *p++ != '-' ||
+        !read_digits(p, end, 2, d) || *p++ != 'T' ||
+        !read_digits(p, end, 2, h) || *p++ != ':' ||
+        !read_digits(p, end, 2, mi) || *p++ != ':' ||
+        !read_digits(p, end, 2, s)) {
+      return 0;
+    }
+    if (p < end && *p == '.') {
+      p++;
+      int digits = 0;
+      for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        if (digits < 6) {
+          frac_us = frac_us * 10 + (*p - '0');
+        }
+      }
+      for (; digits < 6; digits++) {
+        frac_us *= 10;
+      }
+    }
+  } else {
+    if (!read_digits(p, end, 2, y) || !read_digits(p, end, 2, mo) ||
+        !read_digits(p, end, 2, d) || p >= end || *p++ != ' ') {
+      return 0;
+    }
+    y += 2000;
+    while (p < end && *p == ' ') {
+      p++;
+    }
+    h = (int)read_uint(p, end);
+    if (p >= end || *p++ != ':' || !read_digits(p, end, 2, mi) ||
+        p >= end || *p++ != ':' || !read_digits(p, end, 2, s)) {
+      return 0;
+    }
+  }
+
+  int64_t secs = days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+  return secs * 1000000 + frac_us;
+}
+
+// the lines the server writes when it (re)opens the log.
+static bool is_log_header(const char *line, const char *end) {
+  static const char started[] = "started with:";
+  size_t len = end - line;
+  return starts_with(line, end, "Tcp port:") ||
+         starts_with(line, end, "Time ") ||
+         (len >= sizeof(started) - 1 &&
+          memcmp(end - (sizeof(started) - 1), started, sizeof(started) - 1) ==
+              0);
+}
+
+static const char *trim_right(const char *begin, const char *end) {
+  while (end > begin && (end[-1] == ' ' || end[-1] == '\t' ||
+                         end[-1] == '\r' || end[-1] == '\n')) {
+    end--;
+  }
+  return end;
+}
+
+/*
+  A general log entry: "<time>\t<id> <command>\t<argument>", 5.6 starts
+  with "\t\t" instead of the time when it did not change.
+*/
+struct GeneralEntry {
+  uint64_t conn_id;
+  const char *command;
+  size_t command_len;
+  const char *argument;
+};
+
+static bool parse_general_entry(const char *line, const char *end,
+                                uint64_t &ts_us, GeneralEntry &entry) {
+  const char *p = line;
+  if (p < end && *p == '\t') {
+    while (p < end && *p == '\t') {
+      p++;
+    }
+  } else {
+    const char *tab = (const char *)memchr(line, '\t', end - line);
+    if (tab == nullptr) {
+      return false;
+    }
+    uint64_t ts = parse_time_us(line, tab);
+    if (ts == 0) {
+      return false;
+    }
+    ts_us = ts;
+    p = tab + 1;
+  }
+
+  while (p < end && *p == ' ') {
+    p++;
+  }
+  const char *id_begin = p;
+  entry.conn_id = read_uint(p, end);
+  if (p == id_begin || p >= end || *p++ != ' ') {
+    return false;
+  }
+
+  entry.command = p;
+  const char *tab = (const char *)memchr(p, '\t', end - p);
+  entry.command_len = (tab ? tab : end) - p;
+  entry.argument = tab ? tab + 1 : end;
+  return entry.command_len > 0;
+}
+
+const char *LogParser::line_end() const {
+  const char *eol = (const char *)memchr(m_pos_, '\n', m_end_ - m_pos_);
+  return eol ? eol : m_end_;
+}
+
+bool LogParser::next(ReplayEvent &event) {
+  return m_format_ == REPLAY_SLOW_LOG ? next_slow(event) : next_general(event);
+}
+
+// points the sql of a Connect event at its schema.
+static bool connect_db(ReplayEvent &event) {
+  const char *end = event.sql + event.len;
+  const char *on = event.sql;
+  while (on + 4 <= end && memcmp(on, " on ", 4) != 0) {
+    on++;
+  }
+  if (on + 4 > end) {
+    return false;
+  }
+  const char *db = on + 4;
+  const char *db_end = (const char *)memchr(db, ' ', end - db);
+  event.sql = db;
+  event.len = (db_end ? db_end : end) - db;
+  return true;
+}
+
+bool LogParser::next_general(ReplayEvent &event) {
+  while (m_pos_ < m_end_) {
+    const char *line = m_pos_;
+    const char *eol = line_end();
+    m_pos_ = eol < m_end_ ? eol + 1 : m_end_;
+
+    GeneralEntry entry;
+    uint64_t ts_us = m_ts_us_;
+    if (!parse_general_entry(line, eol, ts_us, entry)) {
+      continue;
+    }
+    m_ts_us_ = ts_us;
+
+    // multi-line statements continue until the next entry.
+    const char *arg_end = eol;
+    while (m_pos_ < m_end_) {
+      const char *next_eol = line_end();
+      GeneralEntry next_entry;
+      uint64_t next_ts = m_ts_us_;
+      if (parse_general_entry(m_pos_, next_eol, next_ts, next_entry) ||
+          is_log_header(m_pos_, next_eol)) {
+        break;
+      }
+      arg_end = next_eol;
+      m_pos_ = next_eol < m_end_ ? next_eol + 1 : m_end_;
+    }
+
+    const char *command_end = entry.command + entry.command_len;
+    if (starts_with(entry.command, command_end, "Query") ||
+        starts_with(entry.command, command_end, "Execute")) {
+      event.type = EVENT_QUERY;
+    } else if (starts_with(entry.command, command_end, "Init DB")) {
+      event.type = EVENT_INIT_DB;
+    } else if (starts_with(entry.command, command_end, "Quit")) {
+      event.type = EVENT_QUIT;
+    } else if (starts_with(entry.command, command_end, "Connect")) {
+      event.type = EVENT_CONNECT;
+    } else {
+      continue;
+    }
+
+    event.sql = entry.argument;
+    event.len = trim_right(entry.argument, arg_end) - entry.argument;
+    event.ts_us = m_ts_us_;
+    event.conn_id = entry.conn_id;
+    if (event.type == EVENT_CONNECT) {
+      // "user@host on db using TCP/IP", 5.6 leaves out the "using" part. A
+      // failed login has no " on ", it did not open a connection.
+      if (!connect_db(event)) {
+        continue;
+      }
+    } else if (event.type != EVENT_QUIT && event.len == 0) {
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+/*
+  A slow log entry: "# Time:", "# User@Host: ... Id: <id>" and other "#"
+  lines, then "use db;", "SET timestamp=<s>;" and the statement, each
+  ending with ';'.
+*/
+bool LogParser::next_slow(ReplayEvent &event) {
+  while (m_pos_ < m_end_) {
+    const char *line = m_pos_;
+    const char *eol = line_end();
+    m_pos_ = eol < m_end_ ? eol + 1 : m_end_;
+
+    if (starts_with(line, eol, "# Time:")) {
+      const char *p = line + 7;
+      while (p < eol && *p == ' ') {
+        p++;
+      }
+      uint64_t ts = parse_time_us(p, eol);
+      if (ts != 0) {
+        m_ts_us_ = ts;
+      }
+      continue;
+    }
+    if (starts_with(line, eol, "# User@Host:")) {
+      const char *id = nullptr;
+      for (const char *p = line; p + 3 <= eol; p++) {
+        if (memcmp(p, "Id:", 3) == 0) {
+          id = p + 3;
+          break;
+        }
+      }
+      if (id != nullptr) {
+        while (id < eol && *id == ' ') {
+          id++;
+        }
+        m_conn_id_ = read_uint(id, eol);
+      }
+      continue;
+    }
+    if (starts_with(line, eol, "# administrator command: Quit")) {
+      event.type = EVENT_QUIT;
+      event.sql = line;
+      event.len = 0;
+      event.ts_us = m_ts_us_;
+      event.conn_id = m_conn_id_;
+      return true;
+    }
+    if (line == trim_right(line, eol) || *line == '#' ||
+        is_log_header(line, eol)) {
+      continue;
+    }
+    if (starts_with(line, eol, "SET timestamp=")) {
+      // only whole seconds, "# Time:" is more precise when it is there.
+      const char *p = line + 14;
+      uint64_t secs = read_uint(p, eol);
+      if (secs != m_ts_us_ / 1000000) {
+        m_ts_us_ = secs * 1000000;
+      }
+      continue;
+    }
+
+    const char *stmt_end = trim_right(line, eol);
+    while (stmt_end[-1] != ';' && m_pos_ < m_end_ && *m_pos_ != '#') {
+      const char *next_eol = line_end();
+      if (trim_right(m_pos_, next_eol) > m_pos_) {
+        stmt_end = trim_right(m_pos_, next_eol);
+      }
+      m_pos_ = next_eol < m_end_ ? next_eol + 1 : m_end_;
+    }
+    if (stmt_end[-1] == ';') {
+      stmt_end--;
+    }
+
+    event.type = EVENT_QUERY;
+    event.sql = line;
+    event.len = stmt_end - line;
+    event.ts_us = m_ts_us_;
+    event.conn_id = m_conn_id_;
+    return true;
+  }
+  return false;
+}
+
+// events per batch handed from the reader to a worker.
+static const size_t kBatchEvents = 256;
+// batches a worker queue holds before the reader waits.
+static const size_t kMaxBatches = 64;
+
+// the events of one worker, in log order.
+class EventQueue {
+public:
+  // waits while the queue is full, unless force.
+  void push(std::vector<ReplayEvent> &batch, bool force) {
+    std::unique_lock<std::mutex> lock(m_mutex_);
+    if (!force) {
+      m_not_full_.wait(lock, [this] { return m_batches_.size() < kMaxBatches; });
+    }
+    m_batches_.push_back(std::move(batch));
+    batch = std::vector<ReplayEvent>();
+    batch.reserve(kBatchEvents);
+    m_not_empty_.notify_one();
+  }
+
+  bool full() {
+    std::lock_guard<std::mutex> lock(m_mutex_);
+    return m_batches_.size() >= kMaxBatches;
+  }
+
+  // false once the queue is closed and empty.
+  bool pop(std::vector<ReplayEvent> &batch) {
+    std::unique_lock<std::mutex> lock(m_mutex_);
+    m_not_empty_.wait(lock,
+                      [this] { return !m_batches_.empty() || m_closed_; });
+    if (m_batches_.empty()) {
+      return false;
+    }
+    batch = std::move(m_batches_.front());
+    m_batches_.pop_front();
+    m_not_full_.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(m_mutex_);
+    m_closed_ = true;
+    m_not_empty_.notify_all();
+  }
+
+private:
+  std::mutex m_mutex_;
+  std::condition_variable m_not_empty_;
+  std::condition_variable m_not_full_;
+  std::deque<std::vector<ReplayEvent>> m_batches_;
+  bool m_closed_{false};
+};
+
+static std::atomic<uint32_t> active_threads{0};
+static Statistics replay_state;
+static LatencyStats query_latency;
+// how late each statement was sent compared to the scaled original time.
+static LatencyStats behind_latency;
+static std::atomic<uint64_t> log_offset{0};
+static std::atomic<uint64_t> last_ts_us{0};
+static uint64_t first_ts_us = 0;
+static uint64_t replay_start_ns = 0;
+
+// the stop signal cannot wake the sleep, so an idle gap of the log is slept
+// in slices of at most this, to notice it.
+static const uint64_t kSleepSliceNs = 100000000;
+
+// false when stopped before wake_ns.
+static bool sleep_until_ns(uint64_t wake_ns) {
+  uint64_t now = monotonic_ns();
+  while (now < wake_ns && !stop_requested) {
+    uint64_t slice_ns = std::min(wake_ns, now + kSleepSliceNs);
+    struct timespec ts;
+    ts.tv_sec = slice_ns / 1000000000ULL;
+    ts.tv_nsec = slice_ns % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    now = monotonic_ns();
+  }
+  return !stop_requested;
+}
+
+// hands the events to the workers by original connection id.
+static void read_log(LogParser *parser, ReplayEvent event,
+                     std::vector<EventQueue *> *queues) {
+  size_t workers = queues->size();
+  std::vector<std::vector<ReplayEvent>> batches(workers);
+  bool more = true;
+  while (more && !stop_requested) {
+    size_t worker = event.conn_id % workers;
+    batches[worker].push_back(event);
+    if (batches[worker].size() >= kBatchEvents) {
+      if ((*queues)[worker]->full()) {
+        // about to wait for this worker, the others get what is pending so
+        // a quiet connection is not held back by a busy one.
+        for (size_t i = 0; i < workers; i++) {
+          if (i != worker && !batches[i].empty()) {
+            (*queues)[i]->push(batches[i], true);
+          }
+        }
+      }
+      (*queues)[worker]->push(batches[worker], false);
+    }
+    last_ts_us = event.ts_us;
+    more = parser->next(event);
+    log_offset = parser->offset();
+  }
+
+  for (size_t i = 0; i < workers; i++) {
+    if (!batches[i].empty()) {
+      (*queues)[i]->push(batches[i], true);
+    }
+    (*queues)[i]->close();
+  }
+}
+
+// db is the schema of the original connection, nullptr for none.
+static MYSQL *replay_connect(const char *db) {
+  MYSQL *conn = mysql_init(0);
+  if (conn == nullptr) {
+    AsyncLog(LOG_ERROR, LOG_SITE_CONNECT) << "Failed to init replay connection";
+    return nullptr;
+  }
+  if (!mysql_real_connect(conn, host, user, password, db, port, nullptr, 0)) {
+    AsyncLog(LOG_ERROR, LOG_SITE_CONNECT, mysql_errno(conn))
+        << "Failed to connect to MySql. errno: " << mysql_errno(conn)
+        << ",errmsg: " << mysql_error(conn);
+    mysql_close(conn);
+    return nullptr;
+  }
+  return conn;
+}
+
+// every original connection is replayed on a connection of its own.
+static void replay_worker(size_t worker, EventQueue *queue) {
+  pin_worker(worker);
+  WorkerCpuTime cpu_time(worker);
+  std::unordered_map<uint64_t, MYSQL *> conns;
+  std::vector<ReplayEvent> batch;
+  std::string db;
+
+  while (queue->pop(batch)) {
+    for (auto &event : batch) {
+      if (stop_requested) {
+        break;
+      }
+      if (replay_speed > 0) {
+        uint64_t offset_us =
+            event.ts_us > first_ts_us ? event.ts_us - first_ts_us : 0;
+        uint64_t due_ns =
+            replay_start_ns + (uint64_t)(offset_us * 1000 / replay_speed);
+        uint64_t now = monotonic_ns();
+        if (now < due_ns) {
+          if (!sleep_until_ns(due_ns)) {
+            break;
+          }
+          now = monotonic_ns();
+        }
+        behind_latency.record(worker, (now - due_ns) / 1000);
+      }
+
+      auto it = conns.find(event.conn_id);
+      if (event.type == EVENT_QUIT || event.type == EVENT_CONNECT) {
+        // a Connect of a known id means the server reused it.
+        if (it != conns.end()) {
+          mysql_close(it->second);
+          conns.erase(it);
+        }
+        if (event.type == EVENT_QUIT) {
+          continue;
+        }
+        // the connection opens with the schema of the original handshake.
+        db.assign(event.sql, event.len);
+        MYSQL *conn = replay_connect(db.empty() ? nullptr : db.c_str());
+        if (conn == nullptr) {
+          replay_state.increase_cnt_failed();
+        } else {
+          conns.insert(std::make_pair(event.conn_id, conn));
+        }
+        continue;
+      }
+      if (it == conns.end()) {
+        // its Connect is not in the log, --database stands in for it.
+        MYSQL *conn = replay_connect(database);
+        if (conn == nullptr) {
+          replay_state.increase_cnt_failed();
+          continue;
+        }
+        it = conns.insert(std::make_pair(event.conn_id, conn)).first;
+      }
+
+      MYSQL *conn = it->second;
+      uint64_t start_us = now_us();
+      int res;
+      if (event.type == EVENT_INIT_DB) {
+        db.assign(event.sql, event.len);
+        res = mysql_select_db(conn, db.c_str());
+      } else {
+        res = mysql_real_query(conn, event.sql, event.len);
+        if (res == 0) {
+          res = read_result(conn);
+        }
+      }
+      if (res != 0) {
+        replay_state.increase_cnt_failed();
+        if (detail_log) {
+          AsyncLog(LOG_ERROR, LOG_SITE_REPLAY, mysql_errno(conn))
+              << "Failed to replay, sql: " << std::string(event.sql, event.len)
+              << ", errno: " << mysql_errno(conn) << ", errmsg: "
+              << mysql_error(conn);
+        }
+        if (mysql_errno(conn) >= CR_MIN_ERROR) {
+          mysql_close(conn);
+          conns.erase(it);
+        }
+        continue;
+      }
+      replay_state.increase_cnt_total();
+      query_latency.record(worker, now_us() - start_us);
+    }
+  }
+
+  for (auto &conn : conns) {
+    mysql_close(conn.second);
+  }
+  mysql_thread_end();
+  active_threads--;
+}
+
+static void print_result_interval(size_t log_size) {
+  Statistics new_state, pre_state;
+  pre_state = replay_state;
+  IntervalHistogram query_interval(query_latency);
+  IntervalHistogram behind_interval(behind_latency);
+
+  if (report_interval != 0) {
+    while (active_threads.load() != 0) {
+      sleep(report_interval);
+      new_state = replay_state;
+      uint64_t qps = (new_state.get_cnt_total() - pre_state.get_cnt_total()) /
+                     report_interval;
+      uint64_t failed_qps =
+          (new_state.get_cnt_failed() - pre_state.get_cnt_failed()) /
+          report_interval;
+      uint64_t read_pct = log_offset.load() * 100 / log_size;
+      const Histogram &query_hist = query_interval.next();
+      ReportRecord *record =
+          report_enabled() ? new ReportRecord("interval") : nullptr;
+      std::cout << "replay qps: " << qps << ", failed qps: " << failed_qps
+                << ", lat(us): [" << query_hist.percentile_summary() << "]";
+      if (record) {
+        record->add("qps", qps).add("failed_qps", failed_qps);
+        record->add_latency("lat", query_hist);
+      }
+      if (replay_speed > 0) {
+        const Histogram &behind_hist = behind_interval.next();
+        std::cout << ", behind(us): [" << behind_hist.percentile_summary()
+                  << "]";
+        if (record) {
+          record->add_latency("behind", behind_hist);
+        }
+      }
+      std::cout << ", log read: " << read_pct << "%" << std::endl;
+      if (record) {
+        record->add("log_read_pct", read_pct);
+        record->add("active_threads", (uint64_t)active_threads.load());
+        report_emit(record);
+      }
+      pre_state = new_state;
+    }
+  }
+}
+
+static void print_result_summarize() {
+  std::cout << "Replayed cnt: " << replay_state.get_cnt_total()
+            << ", failed cnt: " << replay_state.get_cnt_failed() << std::endl;
+
+  ReportRecord *record =
+      report_enabled() ? new ReportRecord("summary") : nullptr;
+  if (record) {
+    record->add("total", replay_state.get_cnt_total())
+        .add("failed", replay_state.get_cnt_failed());
+  }
+
+  Histogram total;
+  query_latency.snapshot(total);
+  std::cout << "Query latency(us): " << total.percentile_summary()
+            << ", avg: " << total.get_mean() << std::endl;
+  if (record) {
+    record->add_latency("lat", total);
+  }
+  if (replay_speed > 0) {
+    behind_latency.snapshot(total);
+    std::cout << "Behind schedule(us): " << total.percentile_summary()
+              << ", avg: " << total.get_mean() << std::endl;
+    if (record) {
+      record->add_latency("behind", total);
+    }
+  }
+  double original_s = (last_ts_us.load() - first_ts_us) / 1e6;
+  double replay_s = (monotonic_ns() - replay_start_ns) / 1e9;
+  std::cout << "Original duration(s): " << original_s
+            << ", replay duration(s): " << replay_s << std::endl;
+  if (record) {
+    record->add("original_s", original_s).add("replay_s", replay_s);
+  }
+  worker_cpu_summary(record);
+  if (record) {
+    report_emit(record);
+  }
+}
+
+int main_replay() {
+  int fd = open(replay_file, O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open replay file: " << replay_file
+              << ", errno: " << errno << ", errmsg: " << strerror(errno)
+              << std::endl;
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    std::cerr << "Failed to stat replay file or it is empty: " << replay_file
+              << std::endl;
+    close(fd);
+    return -1;
+  }
+  size_t size = st.st_size;
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << "Failed to mmap replay file, errno: " << errno
+              << ", errmsg: " << strerror(errno) << std::endl;
+    return -1;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  const char *begin = (const char *)map;
+  LogParser parser(begin, begin + size, replay_format);
+  ReplayEvent first;
+  if (!parser.next(first)) {
+    std::cerr << "No statement found in " << replay_file << std::endl;
+    munmap(map, size);
+    return -1;
+  }
+  first_ts_us = first.ts_us;
+
+  query_latency.init(concurrency);
+  behind_latency.init(concurrency);
+  worker_cpu_init(concurrency);
+  std::vector<EventQueue *> queues;
+  std::vector<std::thread *> workers;
+  replay_start_ns = monotonic_ns();
+  for (size_t i = 0; i < concurrency; i++) {
+    queues.push_back(new EventQueue());
+    workers.push_back(new std::thread(replay_worker, i, queues[i]));
+    active_threads++;
+  }
+  std::thread reader(read_log, &parser, first, &queues);
+
+  print_result_interval(size);
+
+  reader.join();
+  for (size_t i = 0; i < concurrency; i++) {
+    workers[i]->join();
+    delete workers[i];
+    delete queues[i];
+  }
+  print_result_summarize();
+
+  munmap(map, size);
+  return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : replay.h
+ * @Description  : replay of a captured general log or slow log. The log is
+ *                 memory mapped and split into statements in place, a
+ *                 reader thread hands them to the workers by original
+ *                 connection id, the workers replay them as fast as
+ *                 possible or at the original timing scaled by
+ *                 --replay-speed.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "options.h"
+
+enum ReplayEventType {
+  EVENT_QUERY,
+  EVENT_INIT_DB,
+  EVENT_QUIT,
+  // sql is the schema of the handshake, empty without one.
+  EVENT_CONNECT,
+};
+
+// one statement of the log, sql points into the mapped file.
+struct ReplayEvent {
+  ReplayEventType type;
+  const char *sql;
+  size_t len;
+  uint64_t ts_us;
+  uint64_t conn_id;
+};
+
+// iterates the statements of a log in [begin, end).
+class LogParser {
+public:
+  LogParser(const char *begin, const char *end, ReplayFormat format)
+      : m_begin_(begin), m_pos_(begin), m_end_(end), m_format_(format) {}
+
+  // false at the end of the log.
+  bool next(ReplayEvent &event);
+  // bytes parsed so far.
+  size_t offset() const { return m_pos_ - m_begin_; }
+
+private:
+  bool next_general(ReplayEvent &event);
+  bool next_slow(ReplayEvent &event);
+  // the line at m_pos_, without the newline.
+  const char *line_end() const;
+
+  const char *m_begin_;
+  const char *m_pos_;
+  const char *m_end_;
+  ReplayFormat m_format_;
+  // the general log of 5.6 leaves the time out when it did not change, the
+  // slow log only writes the connection id in the entry header.
+  uint64_t m_ts_us_{0};
+  uint64_t m_conn_id_{0};
+};
+
+int main_replay();
+
+#endif // REPLAY_H
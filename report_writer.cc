@@ -0,0 +1,316 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : report_writer.cc
+ * @Description  : machine readable report of --output-format=json|csv.
+ */
+
+#include "report_writer.h"
+#include "options.h"
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <unistd.h>
+
+extern OutputFormat output_format;
+extern char *output_file;
+extern TestMode test_mode;
+extern uint64_t concurrency;
+
+static const char *test_mode_names[] = {"sct", "shortct", "rqps", "replay"};
+// records queued before the writer gets to them.
+static const size_t kReportQueueSize = 1024;
+
+static SpscQueue<ReportRecord *> *report_queue = nullptr;
+static std::thread *writer_thread = nullptr;
+static std::atomic_bool writer_stop{false};
+static FILE *output = nullptr;
+static uint64_t open_us = 0;
+static uint64_t dropped_records = 0;
+
+// csv: the file of a record type, nullptr if it could not be opened, and its
+// columns.
+struct CsvFile {
+  std::string path;
+  FILE *file;
+  std::vector<std::string> columns;
+  std::string buf;
+};
+static std::map<std::string, CsvFile> csv_files;
+
+ReportRecord::ReportRecord(const char *type) {
+  uint64_t ts_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  add("type", std::string(type));
+  add("ts_ms", ts_ms);
+  add("elapsed_s", (now_us() - open_us) / 1e6);
+  add("mode", std::string(test_mode_names[test_mode]));
+  add("concurrency", concurrency);
+}
+
+ReportRecord &ReportRecord::add(const std::string &key, uint64_t value) {
+  m_fields_.push_back(Field{key, std::to_string(value), false});
+  return *this;
+}
+
+ReportRecord &ReportRecord::add(const std::string &key, double value) {
+  char buf[32] = "";
+  if (std::isfinite(value)) {
+    snprintf(buf, sizeof(buf), "%.3f", value);
+  }
+  m_fields_.push_back(Field{key, buf, false});
+  return *this;
+}
+
+ReportRecord &ReportRecord::add(const std::string &key,
+                                const std::string &value) {
+  m_fields_.push_back(Field{key, value, true});
+  return *this;
+}
+
+ReportRecord &ReportRecord::add_latency(const std::string &prefix,
+                                        const Histogram &hist) {
+  add(prefix + "_p50", hist.percentile(50));
+  add(prefix + "_p90", hist.percentile(90));
+  add(prefix + "_p99", hist.percentile(99));
+  add(prefix + "_p999", hist.percentile(99.9));
+  add(prefix + "_max", hist.get_max());
+  add(prefix + "_avg", hist.get_mean());
+  return *this;
+}
+
+static void append_json_string(std::string &out, const std::string &value) {
+  out += '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((unsigned char)c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+static void append_csv_value(std::string &out, const std::string &value) {
+  if (value.find_first_of(",\"\n") == std::string::npos) {
+    out += value;
+    return;
+  }
+  out += '"';
+  for (char c : value) {
+    if (c == '"') {
+      out += '"';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+void ReportRecord::to_json(std::string &out) const {
+  out += '{';
+  for (size_t i = 0; i < m_fields_.size(); i++) {
+    if (i != 0) {
+      out += ',';
+    }
+    append_json_string(out, m_fields_[i].key);
+    out += ':';
+    if (m_fields_[i].quoted) {
+      append_json_string(out, m_fields_[i].value);
+    } else if (m_fields_[i].value.empty()) {
+      out += "null";
+    } else {
+      out += m_fields_[i].value;
+    }
+  }
+  out += "}\n";
+}
+
+void ReportRecord::keys(std::vector<std::string> &keys) const {
+  keys.clear();
+  for (auto &field : m_fields_) {
+    keys.push_back(field.key);
+  }
+}
+
+void ReportRecord::to_csv(const std::vector<std::string> &columns,
+                          std::string &out) const {
+  for (size_t i = 0; i < columns.size(); i++) {
+    if (i != 0) {
+      out += ',';
+    }
+    // the fields of a type come in the same order, look there first.
+    if (i < m_fields_.size() && m_fields_[i].key == columns[i]) {
+      append_csv_value(out, m_fields_[i].value);
+      continue;
+    }
+    for (auto &field : m_fields_) {
+      if (field.key == columns[i]) {
+        append_csv_value(out, field.value);
+        break;
+      }
+    }
+  }
+  out += '\n';
+}
+
+// --output-file with the type before its extension, run.csv is
+// run.interval.csv for the interval records.
+static std::string csv_path(const std::string &type) {
+  std::string path = output_file;
+  size_t slash = path.rfind('/');
+  size_t dot = path.rfind('.');
+  if (dot == std::string::npos || dot == 0 ||
+      (slash != std::string::npos && dot <= slash + 1)) {
+    return path + "." + type;
+  }
+  return path.insert(dot, "." + type);
+}
+
+static void add_csv_record(const ReportRecord &record) {
+  auto it = csv_files.find(record.type());
+  if (it == csv_files.end()) {
+    CsvFile csv;
+    csv.path = csv_path(record.type());
+    csv.file = fopen(csv.path.c_str(), "w");
+    if (csv.file == nullptr) {
+      std::cerr << "Failed to open output file: " << csv.path
+                << ", errno: " << errno << ", errmsg: " << strerror(errno)
+                << std::endl;
+    }
+    record.keys(csv.columns);
+    for (size_t i = 0; i < csv.columns.size(); i++) {
+      if (i != 0) {
+        csv.buf += ',';
+      }
+      append_csv_value(csv.buf, csv.columns[i]);
+    }
+    csv.buf += '\n';
+    it = csv_files.emplace(record.type(), csv).first;
+  }
+  if (it->second.file != nullptr) {
+    record.to_csv(it->second.columns, it->second.buf);
+  }
+}
+
+static void flush_output(FILE *file, std::string &buf,
+                         const std::string &path) {
+  if (buf.empty() || file == nullptr) {
+    buf.clear();
+    return;
+  }
+  if (fwrite(buf.data(), 1, buf.size(), file) != buf.size() ||
+      fflush(file) != 0) {
+    std::cerr << "Failed to write output file: " << path
+              << ", errno: " << errno << ", errmsg: " << strerror(errno)
+              << std::endl;
+  }
+  buf.clear();
+}
+
+static void write_records() {
+  std::string buf;
+  while (true) {
+    // read stop first, so nothing queued before it is left behind.
+    bool stop = writer_stop.load();
+    ReportRecord *record;
+    while (report_queue->pop(record)) {
+      if (output_format == OUTPUT_JSON) {
+        record->to_json(buf);
+      } else {
+        add_csv_record(*record);
+      }
+      delete record;
+    }
+    flush_output(output, buf, output_file);
+    for (auto &csv : csv_files) {
+      flush_output(csv.second.file, csv.second.buf, csv.second.path);
+    }
+    if (stop) {
+      break;
+    }
+    usleep(10000);
+  }
+}
+
+bool report_open() {
+  open_us = now_us();
+  if (output_format == OUTPUT_NONE) {
+    return true;
+  }
+  if (output_format == OUTPUT_CSV) {
+    // the files are opened per record type once it shows up, check now
+    // that they can be.
+    std::string dir = output_file;
+    size_t slash = dir.rfind('/');
+    dir = slash == std::string::npos ? "." : dir.substr(0, slash + 1);
+    if (access(dir.c_str(), W_OK) != 0) {
+      std::cerr << "Failed to open output file: " << output_file
+                << ", errno: " << errno << ", errmsg: " << strerror(errno)
+                << std::endl;
+      return false;
+    }
+  } else {
+    output = fopen(output_file, "w");
+    if (output == nullptr) {
+      std::cerr << "Failed to open output file: " << output_file
+                << ", errno: " << errno << ", errmsg: " << strerror(errno)
+                << std::endl;
+      return false;
+    }
+  }
+  report_queue = new SpscQueue<ReportRecord *>(kReportQueueSize);
+  writer_thread = new std::thread(write_records);
+  return true;
+}
+
+void report_close() {
+  if (writer_thread == nullptr) {
+    return;
+  }
+  writer_stop = true;
+  writer_thread->join();
+  delete writer_thread;
+  writer_thread = nullptr;
+  delete report_queue;
+  report_queue = nullptr;
+  if (output != nullptr) {
+    fclose(output);
+    output = nullptr;
+  }
+  for (auto &csv : csv_files) {
+    if (csv.second.file != nullptr) {
+      fclose(csv.second.file);
+    }
+  }
+  csv_files.clear();
+  if (dropped_records != 0) {
+    std::cerr << "output queue was full, dropped records: " << dropped_records
+              << std::endl;
+  }
+}
+
+bool report_enabled() { return report_queue != nullptr; }
+
+void report_emit(ReportRecord *record) {
+  if (report_queue == nullptr) {
+    delete record;
+    return;
+  }
+  if (!report_queue->push(record)) {
+    dropped_records++;
+    delete record;
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : report_writer.h
+ * @Description  : machine readable report of --output-format=json|csv. The
+ *                 reporter queues one record per interval and a summary at
+ *                 the end, a writer thread drains the queue to
+ *                 --output-file, so a slow disk or pipe never stalls the
+ *                 reporter. Records that do not fit into the queue are
+ *                 dropped and counted.
+ *
+ *                 json writes one object per line. csv writes each record
+ *                 type to its own file, whose columns are the fields of
+ *                 the first record of the type.
+ */
+
+#ifndef REPORT_WRITER_H
+#define REPORT_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "histogram.h"
+
+// one row of the time series, fields keep the order they were added in.
+class ReportRecord {
+public:
+  // adds type, ts_ms(wall clock), elapsed_s, mode and concurrency.
+  explicit ReportRecord(const char *type);
+
+  ReportRecord &add(const std::string &key, uint64_t value);
+  // nan and inf are written as json null and as an empty csv value.
+  ReportRecord &add(const std::string &key, double value);
+  ReportRecord &add(const std::string &key, const std::string &value);
+  // <prefix>_p50, _p90, _p99, _p999, _max and _avg in us.
+  ReportRecord &add_latency(const std::string &prefix, const Histogram &hist);
+
+  const std::string &type() const { return m_fields_[0].value; }
+  void to_json(std::string &out) const;
+  // the field names, the csv columns of its type.
+  void keys(std::vector<std::string> &keys) const;
+  // a csv line of the values of columns, empty for fields it does not have.
+  void to_csv(const std::vector<std::string> &columns, std::string &out) const;
+
+private:
+  struct Field {
+    std::string key;
+    // empty and not quoted for a non finite double.
+    std::string value;
+    bool quoted;
+  };
+
+  std::vector<Field> m_fields_;
+};
+
+// starts the writer when --output-format is set, false if the output file
+// can not be opened.
+bool report_open();
+// writes what is still queued and stops the writer.
+void report_close();
+bool report_enabled();
+// called by the reporter thread only, the writer deletes the record.
+void report_emit(ReportRecord *record);
+
+#endif // REPORT_WRITER_H
@@ -0,0 +1,49 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : result_reader.cc
+ * @Description  : reads query results with --result-mode.
+ */
+
+#include "result_reader.h"
+#include "options.h"
+
+extern ResultMode result_mode;
+
+std::atomic<uint64_t> result_rows{0};
+std::atomic<uint64_t> result_bytes{0};
+
+// walks the rows of res, with use_result every fetch reads from the socket.
+static void drain_rows(MYSQL_RES *res) {
+  uint64_t rows = 0;
+  uint64_t bytes = 0;
+  unsigned int fields = mysql_num_fields(res);
+  while (mysql_fetch_row(res) != nullptr) {
+    unsigned long *lengths = mysql_fetch_lengths(res);
+    for (unsigned int i = 0; i < fields; i++) {
+      bytes += lengths[i];
+    }
+    rows++;
+  }
+  if (rows != 0) {
+    result_rows += rows;
+    result_bytes += bytes;
+  }
+}
+
+int read_result(MYSQL *conn) {
+  MYSQL_RES *res = result_mode == RESULT_USE ? mysql_use_result(conn)
+                                             : mysql_store_result(conn);
+  if (res == nullptr) {
+    // no result set (e.g. insert) or the store failed.
+    return mysql_field_count(conn) == 0 ? 0 : mysql_errno(conn);
+  }
+  drain_rows(res);
+  mysql_free_result(res);
+  return result_mode == RESULT_USE ? mysql_errno(conn) : 0;
+}
+
+void count_result(MYSQL_RES *res) {
+  if (res != nullptr) {
+    drain_rows(res);
+  }
+}
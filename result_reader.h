@@ -0,0 +1,27 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : result_reader.h
+ * @Description  : reads query results with --result-mode and counts the rows
+ *                 and bytes received. store buffers the whole result in the
+ *                 client like before, use streams it row by row so large
+ *                 results do not cost client memory and copies.
+ */
+
+#ifndef RESULT_READER_H
+#define RESULT_READER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mysql/mysql.h>
+
+// rows and payload bytes received by all threads.
+extern std::atomic<uint64_t> result_rows;
+extern std::atomic<uint64_t> result_bytes;
+
+// reads and frees the result of the last query on conn, returns 0 or the
+// errno of a failed fetch.
+int read_result(MYSQL *conn);
+// counts the rows and bytes of a stored result.
+void count_result(MYSQL_RES *res);
+
+#endif // RESULT_READER_H
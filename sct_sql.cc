@@ -0,0 +1,54 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : sct_sql.cc
+ * @Description  : the per operation sql of the sct mode.
+ */
+
+#include "sct_sql.h"
+
+static void append_uint(std::string &sql, uint64_t value) {
+  char digits[20];
+  int len = 0;
+  do {
+    digits[len++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (len > 0) {
+    sql += digits[--len];
+  }
+}
+
+std::string sct_insert_sql(const std::string &table, uint64_t pk) {
+  std::string sql;
+  sql.reserve(table.size() + 48);
+  sql.append("insert into ").append(table).append(" values(");
+  append_uint(sql, pk);
+  sql.append(",0)");
+  return sql;
+}
+
+std::string sct_select_sql(const std::string &table, uint64_t pk) {
+  std::string sql;
+  sql.reserve(table.size() + 48);
+  sql.append("select c1 from ").append(table).append(" where id = ");
+  append_uint(sql, pk);
+  return sql;
+}
+
+std::string sct_update_sql(const std::string &table, uint64_t pk,
+                           uint64_t value, bool greatest) {
+  std::string sql;
+  sql.reserve(table.size() + 96);
+  sql.append("update ").append(table);
+  if (greatest) {
+    sql.append(" set c1 = greatest(c1, ");
+    append_uint(sql, value);
+    sql.append(")");
+  } else {
+    sql.append(" set c1 = ");
+    append_uint(sql, value);
+  }
+  sql.append(" where id = ");
+  append_uint(sql, pk);
+  return sql;
+}
@@ -0,0 +1,20 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : sct_sql.h
+ * @Description  : the per operation sql of the sct mode, built into one
+ *                 allocation. Shared with mysqlsct_bench, which measures it.
+ */
+
+#ifndef SCT_SQL_H
+#define SCT_SQL_H
+
+#include <cstdint>
+#include <string>
+
+std::string sct_insert_sql(const std::string &table, uint64_t pk);
+std::string sct_select_sql(const std::string &table, uint64_t pk);
+// greatest: set c1 = greatest(c1, value), the update of the shared tables.
+std::string sct_update_sql(const std::string &table, uint64_t pk,
+                           uint64_t value, bool greatest);
+
+#endif // SCT_SQL_H
@@ -5,11 +5,26 @@
  * @Description  :
  */
 
+#include "async_engine.h"
+#include "async_log.h"
+#include "cpu_affinity.h"
+#include "histogram.h"
 #include "options.h"
+#include "pacer.h"
+#include "report_writer.h"
+#include "result_reader.h"
 #include "short_connection.h"
+#include "stop_signal.h"
+#include "work_budget.h"
+#include <algorithm>
 #include <atomic>
-#include <fstream>
+#include <cerrno>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <mysql/errmsg.h>
+#include <poll.h>
 #include <thread>
 #include <unistd.h>
 #include <vector>
@@ -28,35 +43,160 @@ extern uint table_cnt;
 extern uint64_t concurrency;
 extern uint64_t table_size;
 extern uint64_t iterations;
+extern uint64_t test_time;
 extern uint64_t report_interval; // s
 extern uint detail_log;
 extern uint64_t sleep_after_sct_failed; // s
 extern uint select_after_insert;
 extern uint short_connection;
 extern std::string table_name_prefix;
+extern ClientEngine engine;
+extern char *query_file;
+extern uint64_t async_threads;
 
 static std::atomic<uint32_t> active_threads{0};
 static Statistics state;
+static LatencyStats connect_latency;
+
+/*
+  Phases of one short connection, each with its own histogram and failure
+  counts by errno:
+    init        mysql_init
+    tcp         tcp connect, until the client waits for the server greeting
+    greeting    server accept and connection thread setup, until the
+                greeting arrives
+    auth        auth plugin exchange and the rest of the handshake
+    first query the first query of the connection, with its result
+    close       mysql_close
+  tcp and greeting can only be told apart with the nonblocking client API
+  (MariaDB Connector/C), without it the whole handshake is timed as auth.
+*/
+enum ConnectPhase {
+  PHASE_INIT,
+  PHASE_TCP,
+  PHASE_GREETING,
+  PHASE_AUTH,
+  PHASE_FIRST_QUERY,
+  PHASE_CLOSE,
+  PHASE_COUNT,
+};
+
+static const char *phase_names[] = {"init", "tcp",         "greeting",
+                                    "auth", "first query", "close"};
+
+struct PhaseStats {
+  LatencyStats latency;
+  std::mutex mutex;
+  std::map<unsigned int, uint64_t> errors; // errno -> count
+};
+
+static PhaseStats phase_stats[PHASE_COUNT];
+
+// record the phase that started at start_us, returns the end of it.
+static uint64_t phase_done(ConnectPhase phase, uint64_t thread_id,
+                           uint64_t start_us) {
+  uint64_t cur_us = now_us();
+  phase_stats[phase].latency.record(thread_id, cur_us - start_us);
+  return cur_us;
+}
+
+static void phase_failed(ConnectPhase phase, unsigned int err) {
+  std::lock_guard<std::mutex> lock(phase_stats[phase].mutex);
+  phase_stats[phase].errors[err]++;
+}
+
+#ifdef MYSQL_WAIT_READ
+// wait for what the nonblocking client asked for, returns the ready events.
+static int wait_for_mysql(MYSQL *conn, int status) {
+  struct pollfd pfd;
+  pfd.fd = mysql_get_socket(conn);
+  pfd.events = 0;
+  pfd.revents = 0;
+  if (status & MYSQL_WAIT_READ) {
+    pfd.events |= POLLIN;
+  }
+  if (status & MYSQL_WAIT_WRITE) {
+    pfd.events |= POLLOUT;
+  }
+  if (status & MYSQL_WAIT_EXCEPT) {
+    pfd.events |= POLLPRI;
+  }
+  int timeout_ms =
+      status & MYSQL_WAIT_TIMEOUT ? mysql_get_timeout_value_ms(conn) : -1;
+
+  int res;
+  do {
+    res = poll(&pfd, 1, timeout_ms);
+  } while (res < 0 && errno == EINTR);
+  if (res <= 0) {
+    return MYSQL_WAIT_TIMEOUT;
+  }
+
+  int ready = 0;
+  if (pfd.revents & (POLLIN | POLLERR | POLLHUP)) {
+    ready |= MYSQL_WAIT_READ;
+  }
+  if (pfd.revents & POLLOUT) {
+    ready |= MYSQL_WAIT_WRITE;
+  }
+  if (pfd.revents & POLLPRI) {
+    ready |= MYSQL_WAIT_EXCEPT;
+  }
+  return ready;
+}
+#endif
 
 int ShortConnnectionTest::conns_prepare() {
   int res = 0;
+  uint64_t start_us = now_us();
+  ConnectPhase phase = PHASE_INIT;
   do {
     // Connect to mysql
     m_conn_ = mysql_init(0);
     if (m_conn_ == nullptr) {
-      std::cerr << "Failed to init m_conn_ " << std::endl;
+      AsyncLog(LOG_ERROR, LOG_SITE_CONNECT) << "Failed to init m_conn_ ";
+      phase_failed(PHASE_INIT, CR_OUT_OF_MEMORY);
       res = -1;
       break;
     }
+    start_us = phase_done(PHASE_INIT, m_thread_id_, start_us);
 
-    if (!mysql_real_connect(m_conn_, host, user, password, m_db_name_, port,
-                            nullptr, 0)) {
-      std::cerr << "Failed to connect to MySql."
-                << " errno: " << mysql_errno(m_conn_)
-                << ",errmsg: " << mysql_error(m_conn_) << std::endl;
+    MYSQL *conn = nullptr;
+#ifdef MYSQL_WAIT_READ
+    // the client waits for write while the tcp connect is in progress, the
+    // first wait for read is the server greeting.
+    mysql_options(m_conn_, MYSQL_OPT_NONBLOCK, 0);
+    phase = PHASE_TCP;
+    int status = mysql_real_connect_start(&conn, m_conn_, host, user,
+                                          password, m_db_name_, port,
+                                          nullptr, 0);
+    while (status != 0) {
+      if (phase == PHASE_TCP && !(status & MYSQL_WAIT_WRITE)) {
+        start_us = phase_done(PHASE_TCP, m_thread_id_, start_us);
+        phase = PHASE_GREETING;
+      }
+      status = mysql_real_connect_cont(&conn, m_conn_,
+                                       wait_for_mysql(m_conn_, status));
+      if (phase == PHASE_GREETING) {
+        start_us = phase_done(PHASE_GREETING, m_thread_id_, start_us);
+        phase = PHASE_AUTH;
+      }
+    }
+#else
+    phase = PHASE_AUTH;
+    conn = mysql_real_connect(m_conn_, host, user, password, m_db_name_, port,
+                              nullptr, 0);
+#endif
+    if (conn == nullptr) {
+      AsyncLog(LOG_ERROR, LOG_SITE_CONNECT, mysql_errno(m_conn_))
+          << "Failed to connect to MySql." << " errno: "
+          << mysql_errno(m_conn_) << ",errmsg: " << mysql_error(m_conn_)
+          << ", phase: " << phase_names[phase];
+      phase_failed(phase, mysql_errno(m_conn_));
       res = -1;
       break;
     }
+    phase_done(PHASE_AUTH, m_thread_id_, start_us);
   } while (0);
 
   return res;
@@ -69,34 +209,58 @@ void ShortConnnectionTest::conns_close() {
   }
 }
 
-void ShortConnnectionTest::run(const std::vector<std::string> &querys) {
-  while (m_times_++ < iterations) {
-    conns_prepare();
-    if (basic_query(querys) == 0) {
-      state.increase_cnt_total();
+// --iterations connections over all threads, until --test-time is over.
+static WorkBudget *shortct_budget = nullptr;
+static uint64_t deadline_us = 0;
+
+void ShortConnnectionTest::run(const Workload &workload) {
+  WorkloadCursor cursor(workload, m_thread_id_, concurrency);
+  WorkClaim claim(*shortct_budget);
+  while (!stop_requested && claim.next()) {
+    if (deadline_us != 0 && now_us() >= deadline_us) {
+      break;
+    }
+    uint64_t start_us = now_us();
+    if (conns_prepare() == 0) {
+      connect_latency.record(m_thread_id_, now_us() - start_us);
+      if (basic_query(cursor) == 0) {
+        state.increase_cnt_total();
+      } else {
+        state.increase_cnt_failed();
+      }
     } else {
       state.increase_cnt_failed();
     }
+    start_us = now_us();
     conns_close();
+    phase_done(PHASE_CLOSE, m_thread_id_, start_us);
   }
 }
 
-int ShortConnnectionTest::basic_query(const std::vector<std::string> &querys) {
+int ShortConnnectionTest::basic_query(WorkloadCursor &cursor) {
   int res = 0;
-  MYSQL_RES *mysql_res = nullptr;
-  MYSQL_ROW row;
+  bool first = true;
 
-  for (auto &query : querys) {
-    res = mysql_query(m_conn_, query.data());
+  for (size_t i = 0; i < cursor.pass_size(); i++) {
+    const std::string &query = cursor.next(i);
+    uint64_t start_us = now_us();
+    res = mysql_real_query(m_conn_, query.data(), query.size());
+    if (res == 0) {
+      res = read_result(m_conn_);
+    }
     if (res != 0) {
-      std::cout << "Failed to test consistency, sql: " << query
-                << ", errno: " << mysql_errno(m_conn_)
-                << ", errmsg: " << mysql_error(m_conn_);
+      AsyncLog(LOG_ERROR, LOG_SITE_QUERY, mysql_errno(m_conn_))
+          << "Failed to run shortct query, sql: " << query << ", errno: "
+          << mysql_errno(m_conn_) << ", errmsg: " << mysql_error(m_conn_);
+      if (first) {
+        phase_failed(PHASE_FIRST_QUERY, mysql_errno(m_conn_));
+      }
       return -1;
     }
-
-    mysql_res = mysql_store_result(m_conn_);
-    mysql_free_result(mysql_res);
+    if (first) {
+      phase_done(PHASE_FIRST_QUERY, m_thread_id_, start_us);
+      first = false;
+    }
   }
 
   return res;
@@ -112,77 +276,251 @@ int ShortConnnectionTest::cleanup() {
   return 0;
 }
 
-void start_short_connection_test(int thread_id,
-                                 const std::vector<std::string> &querys) {
+void start_short_connection_test(int thread_id, const Workload &workload) {
   if (detail_log) {
-    std::cout << "start thread: " << thread_id << std::endl;
+    AsyncLog(LOG_INFO, LOG_SITE_THREAD) << "start thread: " << thread_id;
+  }
+  pin_worker(thread_id);
+  ShortConnnectionTest t(database, thread_id);
+  {
+    WorkerCpuTime cpu_time(thread_id);
+    t.run(workload);
   }
-  ShortConnnectionTest t(database, 0);
-  t.run(querys);
   t.cleanup();
   active_threads--;
 
   if (detail_log) {
-    std::cout << "stop thread: " << thread_id << std::endl;
+    AsyncLog(LOG_INFO, LOG_SITE_THREAD) << "stop thread: " << thread_id;
   }
   return;
 }
 
-void show_querys(const std::vector<std::string> &querys) {
-  std::cout << "------------ querys -------------" << std::endl;
-  for (auto &query : querys) {
-    std::cout << query << std::endl;
+bool get_workload_from_file(Workload &workload) {
+  if (!workload.load(query_file ? query_file : "short_connection_querys.txt")) {
+    return false;
   }
-  std::cout << "---------------------------------\n" << std::endl;
-}
 
-std::vector<std::string> get_querys_from_file() {
-  std::vector<std::string> lines;
-  std::ifstream ifs;
-  ifs.open("short_connection_querys.txt");
-  if (ifs.is_open()) {
-    std::string line;
-    while (std::getline(ifs, line)) {
-      lines.push_back(line);
-    }
-    ifs.close();
-  }
+  workload.show();
+  return true;
+}
 
-  show_querys(lines);
-  return lines;
+// field name of a phase in the machine readable report.
+static std::string phase_key(int phase) {
+  std::string key = std::string("phase_") + phase_names[phase];
+  std::replace(key.begin(), key.end(), ' ', '_');
+  return key;
 }
 
 static void print_result_interval() {
   Statistics new_state, pre_state;
   pre_state = state;
+  IntervalHistogram connect_interval(connect_latency);
+  IntervalHistogram disconnect_interval(phase_stats[PHASE_CLOSE].latency);
+  std::vector<IntervalHistogram *> phase_intervals;
+  for (int i = 0; i < PHASE_CLOSE; i++) {
+    phase_intervals.push_back(new IntervalHistogram(phase_stats[i].latency));
+  }
+  uint64_t pre_rows = result_rows.load();
+  uint64_t pre_bytes = result_bytes.load();
 
   if (report_interval != 0) {
     while (active_threads.load() != 0) {
       sleep(report_interval);
       new_state = state;
-      std::cout << "cd(connect/disconnect)ps: "
-                << (new_state.get_cnt_total() - pre_state.get_cnt_total()) /
-                       report_interval;
-      std::cout << ", failed cdps: "
-                << (new_state.get_cnt_failed() - pre_state.get_cnt_failed()) /
-                       report_interval;
+      uint64_t cdps =
+          (new_state.get_cnt_total() - pre_state.get_cnt_total()) /
+          report_interval;
+      uint64_t failed_cdps =
+          (new_state.get_cnt_failed() - pre_state.get_cnt_failed()) /
+          report_interval;
+      const Histogram &connect_hist = connect_interval.next();
+      const Histogram &disconnect_hist = disconnect_interval.next();
+      ReportRecord *record =
+          report_enabled() ? new ReportRecord("interval") : nullptr;
+      std::cout << "cd(connect/disconnect)ps: " << cdps;
+      std::cout << ", failed cdps: " << failed_cdps;
+      std::cout << ", connect lat(us): [" << connect_hist.percentile_summary()
+                << "], disconnect lat(us): ["
+                << disconnect_hist.percentile_summary() << "]";
+      if (record) {
+        record->add("cdps", cdps).add("failed_cdps", failed_cdps);
+        record->add_latency("connect_lat", connect_hist)
+            .add_latency("disconnect_lat", disconnect_hist);
+      }
+      std::cout << ", phase p99(us): [";
+      for (int i = 0; i < PHASE_CLOSE; i++) {
+        uint64_t p99 = phase_intervals[i]->next().percentile(99);
+        std::cout << (i ? ", " : "") << phase_names[i] << ": " << p99;
+        if (record) {
+          record->add(phase_key(i) + "_p99", p99);
+        }
+      }
+      std::cout << "]";
+      uint64_t rows = result_rows.load();
+      uint64_t bytes = result_bytes.load();
+      uint64_t rows_ps = (rows - pre_rows) / report_interval;
+      uint64_t bytes_ps = (bytes - pre_bytes) / report_interval;
+      std::cout << ", rows/s: " << rows_ps << ", bytes/s: " << bytes_ps;
+      pre_rows = rows;
+      pre_bytes = bytes;
       std::cout << ", active threads : " << active_threads.load() << std::endl;
+      if (record) {
+        record->add("rows_ps", rows_ps).add("bytes_ps", bytes_ps);
+        record->add("active_threads", (uint64_t)active_threads.load());
+        report_emit(record);
+      }
       pre_state = new_state;
     }
   }
+
+  for (auto interval : phase_intervals) {
+    delete interval;
+  }
 }
 
 static void print_result_summarize() {
   std::cout << "Test connection/disconnect cnt: " << state.get_cnt_total()
             << ", failed cnt: " << state.get_cnt_failed() << std::endl;
+  ReportRecord *record =
+      report_enabled() ? new ReportRecord("summary") : nullptr;
+
+  Histogram total;
+  connect_latency.snapshot(total);
+  std::cout << "Connect latency(us): " << total.percentile_summary()
+            << ", avg: " << total.get_mean() << std::endl;
+  if (record) {
+    record->add("total", state.get_cnt_total())
+        .add("failed", state.get_cnt_failed())
+        .add_latency("connect_lat", total);
+  }
+  phase_stats[PHASE_CLOSE].latency.snapshot(total);
+  std::cout << "Disconnect latency(us): " << total.percentile_summary()
+            << ", avg: " << total.get_mean() << std::endl;
+  std::cout << "rows received: " << result_rows.load()
+            << ", bytes received: " << result_bytes.load() << std::endl;
+  if (record) {
+    record->add_latency("disconnect_lat", total)
+        .add("rows", result_rows.load())
+        .add("bytes", result_bytes.load());
+  }
+
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    phase_stats[i].latency.snapshot(total);
+    std::cout << "Phase " << phase_names[i]
+              << " latency(us): " << total.percentile_summary()
+              << ", avg: " << total.get_mean();
+    if (record) {
+      record->add_latency(phase_key(i), total);
+    }
+    std::lock_guard<std::mutex> lock(phase_stats[i].mutex);
+    if (!phase_stats[i].errors.empty()) {
+      std::cout << ", failed by errno: [";
+      bool first = true;
+      for (auto &err : phase_stats[i].errors) {
+        std::cout << (first ? "" : ", ") << err.first << ": " << err.second;
+        first = false;
+      }
+      std::cout << "]";
+    }
+    std::cout << std::endl;
+  }
+  worker_cpu_summary(record);
+  if (record) {
+    report_emit(record);
+  }
+}
+
+// the sessions connect, run the querys and disconnect, iterations times in
+// total, driven by the event loops.
+static int main_shortct_async(const Workload &querys) {
+  AsyncWorkload workload;
+  workload.host = host;
+  workload.port = port;
+  workload.db = database;
+  workload.querys = &querys;
+  WorkBudget budget(iterations, concurrency);
+  workload.budget = &budget;
+  if (test_time != 0) {
+    workload.deadline_ns = monotonic_ns() + test_time * 1000000000ULL;
+  }
+  workload.lifecycle = CONN_PER_BATCH;
+  workload.on_connect = [](size_t loop, const ConnectTiming &timing,
+                           unsigned int err) {
+    uint64_t total_us = 0;
+    for (int i = 0; i < timing.done_phases; i++) {
+      phase_stats[PHASE_TCP + i].latency.record(loop, timing.phase_us[i]);
+      total_us += timing.phase_us[i];
+    }
+    if (err != 0) {
+      phase_failed((ConnectPhase)(PHASE_TCP + timing.done_phases), err);
+    } else {
+      connect_latency.record(loop, total_us);
+    }
+  };
+  workload.on_query = [](size_t loop, size_t index, size_t, uint64_t,
+                         uint64_t start_ns, uint64_t done_ns,
+                         unsigned int err) {
+    if (index != 0) {
+      return;
+    }
+    if (err != 0) {
+      phase_failed(PHASE_FIRST_QUERY, err);
+    } else {
+      phase_stats[PHASE_FIRST_QUERY].latency.record(
+          loop, (done_ns - start_ns) / 1000);
+    }
+  };
+  workload.on_close = [](size_t loop, uint64_t us) {
+    phase_stats[PHASE_CLOSE].latency.record(loop, us);
+  };
+  workload.on_pass = [](size_t, bool ok) {
+    if (ok) {
+      state.increase_cnt_total();
+    } else {
+      state.increase_cnt_failed();
+    }
+  };
+  workload.on_loop_exit = [](size_t) { active_threads--; };
+
+  AsyncEngine async_engine(concurrency, async_threads);
+  connect_latency.init(async_engine.loops());
+  for (auto &phase : phase_stats) {
+    phase.latency.init(async_engine.loops());
+  }
+  worker_cpu_init(async_engine.loops());
+  active_threads = async_engine.loops();
+  if (async_engine.start(workload, stop_requested) != 0) {
+    return -1;
+  }
+
+  print_result_interval();
+  async_engine.join();
+  print_result_summarize();
+  return 0;
 }
 
 int main_shortct() {
+  Workload workload;
+  if (!get_workload_from_file(workload)) {
+    return -1;
+  }
+  if (engine == ENGINE_ASYNC) {
+    return main_shortct_async(workload);
+  }
+
   std::thread *ct_threads[concurrency];
-  std::vector<std::string> querys = get_querys_from_file();
+  WorkBudget budget(iterations, concurrency);
+  shortct_budget = &budget;
+  deadline_us = test_time != 0 ? now_us() + test_time * 1000000 : 0;
+  connect_latency.init(concurrency);
+  for (auto &phase : phase_stats) {
+    phase.latency.init(concurrency);
+  }
+  worker_cpu_init(concurrency);
   for (uint thread_id = 0; thread_id < concurrency; thread_id++) {
     ct_threads[thread_id] =
-        new std::thread(start_short_connection_test, thread_id, querys);
+        new std::thread(start_short_connection_test, thread_id,
+                        std::cref(workload));
     active_threads++;
   }
 
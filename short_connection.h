@@ -12,16 +12,19 @@
 #include <string>
 #include <vector>
 
+#include "workload.h"
+
 class ShortConnnectionTest {
 public:
-  ShortConnnectionTest(const char *db_name, int64_t times) {
+  ShortConnnectionTest(const char *db_name, uint64_t thread_id) {
     m_db_name_ = db_name;
-    m_times_ = times;
+    m_thread_id_ = thread_id;
   }
 
-  virtual void run(const std::vector<std::string> &querys);
+  virtual void run(const Workload &workload);
   int cleanup();
-  virtual int basic_query(const std::vector<std::string> &querys);
+  // one pass over the workload on m_conn_.
+  virtual int basic_query(WorkloadCursor &cursor);
 
 protected:
   int conns_prepare();
@@ -29,14 +32,13 @@ protected:
 
   MYSQL *m_conn_{nullptr};
   const char *m_db_name_;
-  uint64_t m_times_;
+  uint64_t m_thread_id_;
 };
 
-// get querys from shot_connection_querys.txt
-std::vector<std::string> get_querys_from_file();
+// load --query-file, short_connection_querys.txt by default.
+bool get_workload_from_file(Workload &workload);
 
-void start_short_connection_test(int thread_id,
-                                 const std::vector<std::string> &querys);
+void start_short_connection_test(int thread_id, const Workload &workload);
 
 int main_shortct();
 
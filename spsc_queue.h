@@ -0,0 +1,64 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : spsc_queue.h
+ * @Description  : bounded lock-free queue of one producer and one consumer
+ *                 thread. Neither side ever waits, push fails when the queue
+ *                 is full and pop when it is empty.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T> class SpscQueue {
+public:
+  // capacity is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    m_items_.resize(size);
+    m_mask_ = size - 1;
+  }
+
+  // producer only.
+  bool push(const T &item) {
+    size_t tail = m_tail_.load(std::memory_order_relaxed);
+    if (tail - m_head_.load(std::memory_order_acquire) > m_mask_) {
+      return false;
+    }
+    m_items_[tail & m_mask_] = item;
+    m_tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only.
+  bool pop(T &item) {
+    size_t head = m_head_.load(std::memory_order_relaxed);
+    if (head == m_tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = m_items_[head & m_mask_];
+    m_head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  SpscQueue(const SpscQueue &) = delete;
+  void operator=(const SpscQueue &) = delete;
+
+  std::vector<T> m_items_;
+  size_t m_mask_;
+  // head and tail on their own cache lines, each is written by one side.
+  char m_pad0_[64];
+  std::atomic<size_t> m_head_{0};
+  char m_pad1_[64];
+  std::atomic<size_t> m_tail_{0};
+  char m_pad2_[64];
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,32 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : stop_signal.cc
+ * @Description  : graceful stop on SIGINT/SIGTERM.
+ */
+
+#include "stop_signal.h"
+
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+
+std::atomic_bool stop_requested{false};
+
+static void on_stop_signal(int) {
+  static const char msg[] = "Stopping, waiting for the workers to finish. "
+                            "Signal again to kill.\n";
+  stop_requested.store(true);
+  ssize_t ignored = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+  (void)ignored;
+}
+
+void install_stop_signals() {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_stop_signal;
+  sigemptyset(&sa.sa_mask);
+  // the second signal gets the default action.
+  sa.sa_flags = SA_RESETHAND | SA_RESTART;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+}
@@ -0,0 +1,18 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : stop_signal.h
+ * @Description  : graceful stop on SIGINT/SIGTERM. The first signal sets
+ *                 stop_requested, every mode stops its workers and still
+ *                 prints its summary. A second signal kills the process.
+ */
+
+#ifndef STOP_SIGNAL_H
+#define STOP_SIGNAL_H
+
+#include <atomic>
+
+extern std::atomic_bool stop_requested;
+
+void install_stop_signals();
+
+#endif // STOP_SIGNAL_H
@@ -0,0 +1,139 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : sweep.cc
+ * @Description  : concurrency sweep of the sct mode.
+ */
+
+#include "sweep.h"
+
+#include "report_writer.h"
+#include "stop_signal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+extern double sweep_knee_p99;
+extern double sweep_knee_failed;
+
+void SweepGate::open(uint64_t active) {
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  m_active_.store(active);
+  m_cv_.notify_all();
+}
+
+void SweepGate::finish() {
+  std::lock_guard<std::mutex> lock(m_mutex_);
+  m_done_.store(true);
+  m_cv_.notify_all();
+}
+
+bool SweepGate::wait(uint64_t worker) {
+  if (worker < m_active_.load(std::memory_order_acquire)) {
+    return !m_done_.load(std::memory_order_relaxed);
+  }
+  std::unique_lock<std::mutex> lock(m_mutex_);
+  // the stop signal cannot notify, poll it.
+  while (!m_done_ && !stop_requested && worker >= m_active_) {
+    m_cv_.wait_for(lock, std::chrono::milliseconds(100));
+  }
+  return !m_done_ && !stop_requested;
+}
+
+uint64_t SweepSchedule::next(const std::vector<SweepPoint> &points) {
+  if (points.empty()) {
+    return 1;
+  }
+  const SweepPoint &last = points.back();
+  std::string reason;
+  if (m_bisect_) {
+    if (sweep_jumped(points.front(), last, reason)) {
+      m_bad_ = last.concurrency;
+    } else {
+      m_good_ = last.concurrency;
+    }
+  } else if (m_mode_ == SWEEP_ADAPTIVE && points.size() > 1 &&
+             sweep_jumped(points.front(), last, reason)) {
+    m_bisect_ = true;
+    m_good_ = points[points.size() - 2].concurrency;
+    m_bad_ = last.concurrency;
+  }
+
+  if (!m_bisect_) {
+    return last.concurrency >= m_max_ ? 0
+                                      : std::min(last.concurrency * 2, m_max_);
+  }
+  // a knee within an eighth of the concurrency is close enough.
+  if (m_bad_ - m_good_ <= std::max<uint64_t>(1, m_good_ / 8)) {
+    return 0;
+  }
+  return (m_good_ + m_bad_) / 2;
+}
+
+bool sweep_jumped(const SweepPoint &base, const SweepPoint &point,
+                  std::string &reason) {
+  std::ostringstream ss;
+  const std::pair<const char *, std::pair<uint64_t, uint64_t>> p99s[] = {
+      {"rw", {base.rw_p99, point.rw_p99}},
+      {"ro", {base.ro_p99, point.ro_p99}},
+      {"lag", {base.lag_p99, point.lag_p99}},
+  };
+  for (auto &p99 : p99s) {
+    uint64_t from = p99.second.first;
+    uint64_t to = p99.second.second;
+    if (sweep_knee_p99 > 0 && from != 0 && to >= from * sweep_knee_p99) {
+      ss << p99.first << " p99 " << from << "us -> " << to << "us";
+      reason = ss.str();
+      return true;
+    }
+  }
+  if (sweep_knee_failed > 0 &&
+      point.failed_pct - base.failed_pct >= sweep_knee_failed) {
+    ss << "failed rate " << base.failed_pct << "% -> " << point.failed_pct
+       << "%";
+    reason = ss.str();
+    return true;
+  }
+  return false;
+}
+
+void print_sweep_curve(std::vector<SweepPoint> points) {
+  std::sort(points.begin(), points.end(),
+            [](const SweepPoint &a, const SweepPoint &b) {
+              return a.concurrency < b.concurrency;
+            });
+  std::cout << "Sweep curve (concurrency, tps, failed %, rw p99(us), "
+               "ro p99(us), lag p99(us)):"
+            << std::endl;
+  int knee = -1;
+  std::string reason;
+  for (size_t i = 0; i < points.size(); i++) {
+    const SweepPoint &p = points[i];
+    std::cout << "  " << p.concurrency << ", " << p.tps << ", "
+              << p.failed_pct << ", " << p.rw_p99 << ", " << p.ro_p99 << ", "
+              << p.lag_p99 << std::endl;
+    if (knee < 0 && i > 0 && sweep_jumped(points[0], p, reason)) {
+      knee = i;
+    }
+  }
+
+  if (knee < 0) {
+    std::cout << "Sweep found no knee up to concurrency "
+              << (points.empty() ? 0 : points.back().concurrency) << "."
+              << std::endl;
+    return;
+  }
+  std::cout << "Sweep knee at concurrency " << points[knee].concurrency
+            << ": " << reason << ", last good concurrency "
+            << points[knee - 1].concurrency << " at " << points[knee - 1].tps
+            << " tps." << std::endl;
+  if (report_enabled()) {
+    ReportRecord *record = new ReportRecord("sweep_knee");
+    record->add("concurrency", points[knee].concurrency)
+        .add("good_concurrency", points[knee - 1].concurrency)
+        .add("good_tps", points[knee - 1].tps)
+        .add("reason", reason);
+    report_emit(record);
+  }
+}
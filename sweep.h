@@ -0,0 +1,74 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : sweep.h
+ * @Description  : concurrency sweep of the sct mode. All --concurrency
+ *                 workers prepare the data and connect once, then the sweep
+ *                 lets 1, 2, 4, ... of them run for --sweep-step-time each
+ *                 and measures every step on its own. The knee is the first
+ *                 step where the p99 or the failure rate jumped against the
+ *                 first step, one worker. The adaptive schedule bisects
+ *                 between the last good step and the knee to narrow it.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "options.h"
+
+// lets the first n workers run, the others wait with their connections.
+class SweepGate {
+public:
+  void open(uint64_t active);
+  // releases the waiting workers, wait() returns false from now on.
+  void finish();
+  // blocks while worker is not active, false once the sweep is over.
+  bool wait(uint64_t worker);
+
+private:
+  std::mutex m_mutex_;
+  std::condition_variable m_cv_;
+  std::atomic<uint64_t> m_active_{0};
+  std::atomic_bool m_done_{false};
+};
+
+struct SweepPoint {
+  uint64_t concurrency;
+  double tps;
+  double failed_pct;
+  uint64_t rw_p99;
+  uint64_t ro_p99;
+  uint64_t lag_p99; // 0 without --lag-mode
+};
+
+// picks the concurrency of the next step from the steps measured so far.
+class SweepSchedule {
+public:
+  SweepSchedule(SweepMode mode, uint64_t max_concurrency)
+      : m_mode_(mode), m_max_(max_concurrency) {}
+
+  // 0 when the sweep is done.
+  uint64_t next(const std::vector<SweepPoint> &points);
+
+private:
+  SweepMode m_mode_;
+  uint64_t m_max_;
+  bool m_bisect_{false};
+  // last concurrency without a jump and the lowest one with a jump.
+  uint64_t m_good_{0};
+  uint64_t m_bad_{0};
+};
+
+// whether point jumped against base, the first step, with the reason.
+bool sweep_jumped(const SweepPoint &base, const SweepPoint &point,
+                  std::string &reason);
+// prints the steps by concurrency and where the knee is.
+void print_sweep_curve(std::vector<SweepPoint> points);
+
+#endif // SWEEP_H
@@ -0,0 +1,58 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : work_budget.h
+ * @Description  : --iterations shared by all threads. Threads claim them in
+ *                 chunks, so the shared counter is touched once per chunk
+ *                 instead of once per operation.
+ */
+
+#ifndef WORK_BUDGET_H
+#define WORK_BUDGET_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+class WorkBudget {
+public:
+  WorkBudget(uint64_t total, uint64_t threads) : m_total_(total) {
+    // small enough that the last chunks still spread over all threads.
+    uint64_t chunk = total / (std::max<uint64_t>(threads, 1) * 16);
+    m_chunk_ = std::min<uint64_t>(1024, std::max<uint64_t>(1, chunk));
+  }
+
+  // claims the next chunk, returns its size, 0 once the budget is spent.
+  uint64_t claim() {
+    uint64_t begin = m_next_.fetch_add(m_chunk_, std::memory_order_relaxed);
+    if (begin >= m_total_) {
+      return 0;
+    }
+    return std::min(m_chunk_, m_total_ - begin);
+  }
+
+private:
+  const uint64_t m_total_;
+  uint64_t m_chunk_;
+  std::atomic<uint64_t> m_next_{0};
+};
+
+// the ops of one thread, claimed from a WorkBudget chunk by chunk.
+class WorkClaim {
+public:
+  explicit WorkClaim(WorkBudget &budget) : m_budget_(budget) {}
+
+  // false once the budget is spent.
+  bool next() {
+    if (m_left_ == 0 && (m_left_ = m_budget_.claim()) == 0) {
+      return false;
+    }
+    m_left_--;
+    return true;
+  }
+
+private:
+  WorkBudget &m_budget_;
+  uint64_t m_left_{0};
+};
+
+#endif // WORK_BUDGET_H
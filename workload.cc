@@ -0,0 +1,237 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : workload.cc
+ * @Description  : query workload of the shortct and rqps modes.
+ */
+
+#include "workload.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+extern double zipf_theta;
+
+Workload::~Workload() {
+  for (auto zipf : m_zipfs_) {
+    delete zipf;
+  }
+}
+
+bool Workload::load(const std::string &path) {
+  std::ifstream ifs(path);
+  if (!ifs.is_open()) {
+    std::cerr << "Failed to open query file: " << path << std::endl;
+    return false;
+  }
+
+  std::string line;
+  uint64_t lineno = 0;
+  uint64_t total_weight = 0;
+  while (std::getline(ifs, line)) {
+    lineno++;
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    QueryClass cls;
+    cls.weight = 1;
+    cls.sql = line;
+    if (line[0] == '@') {
+      // @name weight query
+      size_t name_end = line.find(' ');
+      size_t weight_end =
+          name_end == std::string::npos ? name_end : line.find(' ', name_end + 1);
+      if (weight_end == std::string::npos) {
+        std::cerr << path << ":" << lineno
+                  << ": expected \"@name weight query\"" << std::endl;
+        return false;
+      }
+      cls.name = line.substr(1, name_end - 1);
+      const char *weight = line.c_str() + name_end + 1;
+      char *end = nullptr;
+      cls.weight = strtoull(weight, &end, 10);
+      if (!isdigit((unsigned char)*weight) ||
+          end != line.c_str() + weight_end) {
+        std::cerr << path << ":" << lineno << ": weight is not a number in: "
+                  << line << std::endl;
+        return false;
+      }
+      cls.sql = line.substr(weight_end + 1);
+      m_weighted_ = true;
+    } else {
+      cls.name = "line" + std::to_string(lineno);
+    }
+
+    if (!parse_template(cls.sql, cls.segments)) {
+      std::cerr << path << ":" << lineno << ": wrong placeholder in: "
+                << cls.sql << std::endl;
+      return false;
+    }
+    total_weight += cls.weight;
+    m_cum_weights_.push_back(total_weight);
+    m_classes_.push_back(cls);
+  }
+
+  // every caller runs passes over the queries, an empty pass would spin.
+  if (m_classes_.empty()) {
+    std::cerr << path << ": no query" << std::endl;
+    return false;
+  }
+  if (m_weighted_ && total_weight == 0) {
+    std::cerr << path << ": all weights are 0" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool Workload::parse_template(const std::string &sql,
+                              std::vector<Segment> &segments) {
+  Segment text{SEGMENT_TEXT, "", 0, 0, nullptr};
+  size_t pos = 0;
+  while (pos < sql.size()) {
+    if (sql[pos] != '{') {
+      text.text += sql[pos++];
+      continue;
+    }
+    if (pos + 1 < sql.size() && sql[pos + 1] == '{') {
+      text.text += '{';
+      pos += 2;
+      continue;
+    }
+
+    size_t end = sql.find('}', pos);
+    if (end == std::string::npos) {
+      return false;
+    }
+    Segment placeholder{SEGMENT_TEXT, "", 0, 0, nullptr};
+    if (!parse_placeholder(sql.substr(pos + 1, end - pos - 1), placeholder)) {
+      return false;
+    }
+    if (!text.text.empty()) {
+      segments.push_back(text);
+      text.text.clear();
+    }
+    segments.push_back(placeholder);
+    pos = end + 1;
+  }
+
+  if (!text.text.empty()) {
+    segments.push_back(text);
+  }
+  return true;
+}
+
+bool Workload::parse_placeholder(const std::string &spec, Segment &segment) {
+  std::vector<std::string> args;
+  size_t begin = 0;
+  while (true) {
+    size_t end = spec.find(':', begin);
+    args.push_back(spec.substr(begin, end - begin));
+    if (end == std::string::npos) {
+      break;
+    }
+    begin = end + 1;
+  }
+
+  const std::string &type = args[0];
+  if (type == "seq" && args.size() == 1) {
+    segment.type = SEGMENT_SEQ;
+  } else if (type == "rand_int" && args.size() == 3) {
+    segment.type = SEGMENT_RAND_INT;
+    segment.low = strtoull(args[1].c_str(), nullptr, 10);
+    segment.high = strtoull(args[2].c_str(), nullptr, 10);
+    if (segment.high < segment.low) {
+      return false;
+    }
+  } else if (type == "zipf" && (args.size() == 2 || args.size() == 3)) {
+    segment.type = SEGMENT_ZIPF;
+    segment.high = strtoull(args[1].c_str(), nullptr, 10);
+    double theta = args.size() == 3 ? atof(args[2].c_str()) : zipf_theta;
+    if (segment.high == 0 || theta <= 0 || theta >= 1) {
+      return false;
+    }
+    // the zeta sum is expensive, built once and shared by all threads.
+    ZipfianGenerator *zipf = new ZipfianGenerator(segment.high, theta);
+    m_zipfs_.push_back(zipf);
+    segment.zipf = zipf;
+  } else if (type == "rand_str" && args.size() == 2) {
+    segment.type = SEGMENT_RAND_STR;
+    segment.high = strtoull(args[1].c_str(), nullptr, 10);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void Workload::show() const {
+  std::cout << "------------ querys -------------" << std::endl;
+  for (auto &cls : m_classes_) {
+    if (m_weighted_) {
+      std::cout << "@" << cls.name << " " << cls.weight << " ";
+    }
+    std::cout << cls.sql << std::endl;
+  }
+  std::cout << "---------------------------------\n" << std::endl;
+}
+
+WorkloadCursor::WorkloadCursor(const Workload &workload, uint64_t thread_id,
+                               uint64_t threads)
+    : m_workload_(workload), m_rand_(thread_seed(thread_id)),
+      m_seq_(thread_id + 1), m_seq_step_(std::max<uint64_t>(threads, 1)) {}
+
+void WorkloadCursor::append_uint(uint64_t value) {
+  char digits[20];
+  int len = 0;
+  do {
+    digits[len++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (len > 0) {
+    m_buf_ += digits[--len];
+  }
+}
+
+const std::string &WorkloadCursor::next(size_t index) {
+  static const char alnum[] =
+      "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  const std::vector<uint64_t> &cum = m_workload_.m_cum_weights_;
+  if (m_workload_.m_weighted_) {
+    uint64_t pick = m_rand_.uniform(cum.back());
+    m_class_ = std::upper_bound(cum.begin(), cum.end(), pick) - cum.begin();
+  } else {
+    m_class_ = index;
+  }
+
+  // clear() keeps the capacity, after the first queries nothing allocates.
+  m_buf_.clear();
+  for (auto &segment : m_workload_.m_classes_[m_class_].segments) {
+    switch (segment.type) {
+    case Workload::SEGMENT_TEXT:
+      m_buf_ += segment.text;
+      break;
+    case Workload::SEGMENT_RAND_INT:
+      append_uint(segment.low +
+                  m_rand_.uniform(segment.high - segment.low + 1));
+      break;
+    case Workload::SEGMENT_SEQ:
+      append_uint(m_seq_);
+      m_seq_ += m_seq_step_;
+      break;
+    case Workload::SEGMENT_ZIPF:
+      append_uint(segment.zipf->next(m_rand_) + 1);
+      break;
+    case Workload::SEGMENT_RAND_STR:
+      for (uint64_t i = 0; i < segment.high; i++) {
+        m_buf_ += alnum[m_rand_.uniform(sizeof(alnum) - 1)];
+      }
+      break;
+    }
+  }
+  return m_buf_;
+}
@@ -0,0 +1,114 @@
+/*
+ * @Date         : 2026-10-17
+ * @FilePath     : workload.h
+ * @Description  : query workload of the shortct and rqps modes. The query
+ *                 file is parsed once into templates of literal and
+ *                 placeholder segments, every thread renders them into its
+ *                 own reused buffer.
+ *
+ *                 File format, one query per line:
+ *                   # comment, empty lines are skipped too
+ *                   select * from user limit 1
+ *                   @point 80 select c from t where id = {zipf:1000000}
+ *                 Plain lines run in file order. "@name weight query"
+ *                 declares a weighted class, once the file has one every
+ *                 query of a pass is picked by weight (plain lines weigh 1).
+ *                 Placeholders:
+ *                   {rand_int:lo:hi}  uniform integer in [lo, hi]
+ *                   {seq}             sequence unique over all threads
+ *                   {zipf:n[:theta]}  zipfian integer in [1, n], rank 1 is
+ *                                     the hottest, theta is --zipf-theta
+ *                   {rand_str:len}    random alphanumeric string
+ *                 "{{" is a literal "{".
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rand_gen.h"
+
+class Workload {
+public:
+  Workload() {}
+  ~Workload();
+
+  // parse the file, prints what is wrong and returns false on errors and
+  // on a file without queries.
+  bool load(const std::string &path);
+  void show() const;
+
+  // queries of one pass, a pass is what shortct runs per connection.
+  size_t pass_size() const { return m_classes_.size(); }
+  size_t class_count() const { return m_classes_.size(); }
+  const std::string &class_name(size_t cls) const {
+    return m_classes_[cls].name;
+  }
+
+private:
+  friend class WorkloadCursor;
+
+  enum SegmentType {
+    SEGMENT_TEXT,
+    SEGMENT_RAND_INT,
+    SEGMENT_SEQ,
+    SEGMENT_ZIPF,
+    SEGMENT_RAND_STR,
+  };
+
+  struct Segment {
+    SegmentType type;
+    std::string text;
+    uint64_t low;
+    uint64_t high;
+    const ZipfianGenerator *zipf;
+  };
+
+  struct QueryClass {
+    std::string name;
+    uint64_t weight;
+    std::string sql;
+    std::vector<Segment> segments;
+  };
+
+  Workload(const Workload &) = delete;
+  void operator=(const Workload &) = delete;
+
+  bool parse_template(const std::string &sql, std::vector<Segment> &segments);
+  bool parse_placeholder(const std::string &spec, Segment &segment);
+
+  std::vector<QueryClass> m_classes_;
+  // running sum of the class weights, for picking by weight.
+  std::vector<uint64_t> m_cum_weights_;
+  bool m_weighted_{false};
+  std::vector<ZipfianGenerator *> m_zipfs_;
+};
+
+// renders the queries of a workload for one thread (or async session).
+class WorkloadCursor {
+public:
+  WorkloadCursor(const Workload &workload, uint64_t thread_id,
+                 uint64_t threads);
+
+  // the query at index of the current pass, valid until the next call.
+  const std::string &next(size_t index);
+  // the last query and its class.
+  const std::string &last_query() const { return m_buf_; }
+  size_t last_class() const { return m_class_; }
+  size_t pass_size() const { return m_workload_.pass_size(); }
+
+private:
+  void append_uint(uint64_t value);
+
+  const Workload &m_workload_;
+  FastRand m_rand_;
+  uint64_t m_seq_;
+  uint64_t m_seq_step_;
+  size_t m_class_{0};
+  std::string m_buf_;
+};
+
+#endif // WORKLOAD_H